@@ -5,12 +5,14 @@
 
 #ifndef BARINFO_HEADER
 #define BARINFO_HEADER
+#include <memory>
 
 namespace otf {
 
 /**
  * @class bar_info
- * @brief A0, A2, Sbar, Sbuckle, bar ellipticity (to be implemented)
+ * @brief A0, A2, Sbar, Sbuckle, pattern speed, bar length, Tremaine-Weinberg integrals, bar
+ * ellipticity (to be implemented)
  *
  */
 class bar_info
@@ -26,6 +28,18 @@ public:
     static auto bar_angle( unsigned partNum, const double* masses, const double* phis ) -> double;
     static auto Sbuckle( unsigned partNum, const double* masses, const double* phis,
                          const double* zeds ) -> double;
+    static auto unwrap_bar_angle( double previous, double current ) -> double;
+    static auto pattern_speed( unsigned num, const double* times, const double* phases ) -> double;
+    static auto bar_length_a2( unsigned binNum, const double* radii, const double* A2Re,
+                               const double* A2Im, double fraction ) -> double;
+    static auto bar_length_phase( unsigned binNum, const double* radii, const double* A2Re,
+                                  const double* A2Im, double deltaPhi ) -> double;
+    // number of the quantities of each slit in the Tremaine-Weinberg integrals
+    static constexpr unsigned twQuantityNum = 3;
+    static auto tw_integrals( unsigned partNum, const double* masses, const double* coordinates,
+                              const double* velocities, double inclination, unsigned angleNum,
+                              const double* angles, unsigned slitNum, double slitWidth,
+                              double halfLength ) -> std::unique_ptr< double[] >;
 };
 
 }  // namespace otf
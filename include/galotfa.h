@@ -22,4 +22,16 @@ extern "C" void OnTheFly_Analysis_Nbody( const double currentTime, const unsigne
                                          const double* masses, const double* potentials,
                                          const double* coordinates, const double* velocities );
 
+/**
+ * @brief Similar to OnTheFly_Analysis_Nbody, with a hint whether the local particles were
+ * reordered since the last call.
+ *
+ * @param reordered non-zero if the local particles are known to be reordered (e.g. by a domain
+ * decomposition) since the last call.
+ */
+extern "C" void OnTheFly_Analysis_Nbody_Reordered(
+    const double currentTime, const unsigned particleNumber, const int* particleIDs,
+    const int* particleTypes, const double* masses, const double* potentials,
+    const double* coordinates, const double* velocities, const int reordered );
+
 #endif
@@ -7,6 +7,7 @@
 #define MY_H5_OUTPUT_HEADER
 #include "H5Ipublic.h"
 #include "H5public.h"
+#include <chrono>
 #include <memory>
 #include <string>
 #include <unordered_map>
@@ -16,6 +17,8 @@
 #else
 #define CHUCK_SIZE 1024
 #endif
+// maximal bytes of a chunk, beyond which the chunk holds less steps than CHUCK_SIZE
+#define MAX_CHUCK_BYTES ( 1UL << 22 )
 /**
  * @class dataset_handle
  * @brief The class that handles the basic operations of a dataset, including memory space, chuck
@@ -26,9 +29,12 @@ class dataset_handle
 {
 public:
     dataset_handle( hid_t& parent, const std::string& datasetName,
-                    const std::vector< unsigned >& sizeInEachDim, hid_t& dataType );
+                    const std::vector< unsigned >& sizeInEachDim, hid_t& dataType,
+                    unsigned bufferRows = 1, double bufferSeconds = 0,
+                    bool flushOnSignal = false );
     ~dataset_handle();
     auto flush_single_block( const void* dataBuffer ) -> int;
+    auto flush_buffer() -> int;  // write all the buffered blocks to the file
 
 #ifdef DEBUG
 
@@ -46,6 +52,17 @@ private:
     std::unique_ptr< hsize_t[] > offset;
     // NOTE: curIndex always points to the current to be logged index
     unsigned long long curIndex = 0;
+    // number of steps in a chunk, less than CHUCK_SIZE for the large blocks (e.g. 3D grids)
+    unsigned long long chunkRows = CHUCK_SIZE;
+    // NOTE: the buffer of blocks in memory, which are not written to the file yet
+    unsigned            bufferRows    = 1;      // write the buffer when it has so many blocks
+    double              bufferSeconds = 0;      // or at the next block after so many seconds
+    bool                flushOnSignal = false;  // whether write the buffer at SIGINT or SIGTERM
+    unsigned            bufferedNum   = 0;      // number of the blocks in the buffer
+    std::size_t         blockBytes    = 0;      // size of a single block in bytes
+    std::vector< char > buffer;
+    std::chrono::steady_clock::time_point lastFlushTime;
+    auto buffer_single_block( const void* dataBuffer ) -> int;
 };
 
 /**
@@ -56,13 +73,15 @@ private:
 class h5_out
 {
 public:
-    h5_out( const std::string& dir, const std::string& filename );
+    h5_out( const std::string& dir, const std::string& filename, unsigned bufferRows = 1,
+            double bufferSeconds = 0, bool flushOnSignal = false );
     ~h5_out();
     auto create_dataset_in_group( const std::string& datasetName, const std::string& groupName,
-                                  const std::vector< unsigned >& sizeInEachDim,
-                                  hid_t                          dataType ) -> int;
+                                  const std::vector< unsigned >& sizeInEachDim, hid_t dataType,
+                                  bool buffered = false ) -> int;
     auto flush_single_block( const std::string& groupName, const std::string& datasetName,
                              const void* dataBuffer ) -> int;
+    auto flush_all() -> int;  // write the buffers of all datasets and flush the file
 
 #ifdef DEBUG
 public:
@@ -81,6 +100,9 @@ private:
     auto        ensure_dataset_empty( const std::string& groupName,
                                       const std::string& datasetName ) -> int;
     std::string filename;
+    unsigned    bufferRows    = 1;  // buffer policy of the buffered datasets
+    double      bufferSeconds = 0;
+    bool        flushOnSignal = false;
 };
 
 void Backup_Old_Logs_If_Necessary( const std::string& dir, const std::string& filename );
@@ -0,0 +1,87 @@
+/**
+ * @file idset.hpp
+ * @brief Membership test of particle IDs, used to find the particles of the orbital log.
+ */
+
+#ifndef IDSET_HEADER
+#define IDSET_HEADER
+#include <climits>
+#include <cstdint>
+#include <vector>
+
+namespace otf {
+
+/**
+ * @class id_set
+ * @brief A static set of particle IDs built once, with an O(1) membership test. If the IDs are
+ * compact (the range of IDs is not much larger than their number), it's a dense bitmap over the
+ * range of IDs, otherwise an open-addressing hash set with linear probing and a load factor of at
+ * most 1/2.
+ *
+ */
+class id_set
+{
+public:
+    id_set() = default;
+    explicit id_set( const std::vector< int >& ids );
+    auto size() const -> unsigned long
+    {
+        return count;
+    }
+    auto is_dense() const -> bool
+    {
+        return dense;
+    }
+    // whether the id is in the set
+    auto contains( const int id ) const -> bool
+    {
+        if ( dense )
+        {
+            const auto offset = ( std::uint64_t )( ( std::int64_t )id - minId );
+            return offset < range and ( ( bitmap[ offset >> 6 ] >> ( offset & 63 ) ) & 1 ) != 0;
+        }
+        if ( id == emptyKey )
+        {
+            return hasEmptyKey;
+        }
+        for ( auto slot = hash( id );; slot = ( slot + 1 ) & mask )
+        {
+            if ( table[ slot ] == id )
+            {
+                return true;
+            }
+            if ( table[ slot ] == emptyKey )
+            {
+                return false;
+            }
+        }
+    }
+
+#ifdef DEBUG
+
+#else
+private:
+#endif
+    // the bitmap is used if it costs no more than so many bits per id
+    static inline std::uint64_t maxBitsPerId = 64;
+    static constexpr int        emptyKey     = INT_MIN;  // the empty slot of the hash table
+    unsigned long               count        = 0;        // number of unique ids
+    bool                        dense        = true;     // whether the bitmap is used
+    // the bitmap: the i-th bit is set for the id minId + i
+    std::int64_t                 minId = 0;
+    std::uint64_t                range = 0;  // maxId - minId + 1
+    std::vector< std::uint64_t > bitmap;
+    // the hash table: at least 2 slots, a power of 2
+    std::vector< int > table;
+    std::uint64_t      mask        = 0;      // number of slots - 1
+    unsigned           shift       = 63;     // 64 - log2 of the number of slots
+    bool               hasEmptyKey = false;  // whether emptyKey itself is in the set
+    // Fibonacci hashing: the high bits of the product with 2^64 / golden ratio
+    auto hash( const int id ) const -> std::uint64_t
+    {
+        return ( ( std::uint64_t )( std::uint32_t )id * 0x9E3779B97F4A7C15ULL ) >> shift;
+    }
+};
+
+}  // namespace otf
+#endif
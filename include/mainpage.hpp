@@ -23,6 +23,7 @@
  * -# include/barinfo.hpp Calculate the A2, Sbuckle and other bar informations.
  * -# include/statistic.hpp Calculate the 1D or 2D binning statistics.
  * -# include/eigen.hpp Calculate the eigenvalues and eigenvectors of a given matrix.
+ * -# include/radixsort.hpp Sort the particles by their radii.
  *
  * <hr>
  * @todo Bar length calculation.
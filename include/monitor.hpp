@@ -7,9 +7,15 @@
 #define MONITOR_HEADER
 #include "../include/h5out.hpp"
 #include "../include/para.hpp"
+#include "../include/sketch.hpp"
+#include <cstdint>
+#include <deque>
 #include <memory>
+#include <mpi.h>
 #include <string>
 #include <string_view>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
 namespace otf {
@@ -27,7 +33,8 @@ public:
     ~monitor();
     void main_analysis_api( double time, unsigned particleNumber, const int* id,
                             const int* partTypes, const double* masses, const double* potentials,
-                            const double* coordinates, const double* velocities );
+                            const double* coordinates, const double* velocities,
+                            bool reordered = false );
 
 #ifdef DEBUG
 
@@ -40,13 +47,27 @@ private:
     unsigned     stepCounter;             // counter of the synchronized time step
     bool         mpiInitialzedByMonitor;  // whether the MPI_init is called by the monitor object
     runtime_para para;                    // ptr to the runtime paramter
-    std::vector< std::string > orbitDatasetNames;
-    static constexpr unsigned  orbitPointDim = 7;
-    using orbitPoint                         = struct
+    std::vector< int >        orbitIDs;  // sorted ids of the particles in the orbit dataset
+    static constexpr unsigned orbitPointDim = 6;  // coordinates and velocities
+    using orbitPoint                        = struct
     {
         int    particleID;
         double data[ orbitPointDim ];
     };
+    // the derived datatype of an orbitPoint record, committed at the first orbital log
+    MPI_Datatype orbitPointType = MPI_DATATYPE_NULL;
+    // the buffers of the orbital log, reused in all log steps
+    std::vector< orbitPoint >           orbitLocalRecords;  // records of the local rank
+    std::vector< orbitPoint >           orbitRecords;       // gathered records, root rank only
+    std::vector< int >                  orbitCounts;        // number of records of each rank
+    std::vector< int >                  orbitOffsets;       // offsets of the records of each rank
+    std::unordered_map< int, unsigned > orbitSlots;         // id -> column of the orbit dataset
+    std::vector< double >               orbitBlock;         // a single step of the orbit dataset
+    std::vector< float >                orbitFloatBlock;    // the block of the float orbits
+    std::vector< std::int32_t >         orbitQuantBlock;    // the block of the quantized orbits
+    std::vector< std::int32_t >         orbitLastQuant;     // last quantized values, for the delta
+    // the sentinel of the particles not found in a step, in the quantized orbits
+    static constexpr std::int32_t orbitMissing = INT32_MIN;
 
     // the container of data for a single component
     using compDataContainer = struct compDataStruct
@@ -56,31 +77,101 @@ private:
         std::unique_ptr< double[] > potentials  = nullptr;  // potentials of particles
         std::unique_ptr< double[] > coordinates = nullptr;  // coordinates of particles
         std::unique_ptr< double[] > velocities  = nullptr;  // velocities of particles
+        // NOTE: the following caches are available only when the particles are sorted by radii
+        bool                        sortedByRadius = false;  // whether sorted by cylindrical radii
+        std::unique_ptr< double[] > radii = nullptr;  // cylindrical radii, in ascending order
+        std::unique_ptr< double[] > phis  = nullptr;  // azimuthal angles of particles
     };
 
     // the container of analysis results for a single component
     using compResContainer = struct compResStruct
     {
-        double                      center[ 3 ] = { 0, 0, 0 };  // center of the component
-        double                      sBar        = 0;            // bar strength parameter
-        double                      barAngle    = 0;            // bar angle
-        double                      sBuckle     = 0;            // buckling strength
-        unsigned                    imageBinNum = 0;            // image matrix rank
-        std::unique_ptr< double[] > imageXY     = nullptr;      // image matrix x-y
-        std::unique_ptr< double[] > imageXZ     = nullptr;      // image matrix x-z
-        std::unique_ptr< double[] > imageYZ     = nullptr;      // image matrix y-z
+        double                      center[ 3 ]  = { 0, 0, 0 };  // center of the component
+        double                      sBar         = 0;            // bar strength parameter
+        double                      barAngle     = 0;            // bar angle
+        double                      sBuckle      = 0;            // buckling strength
+        double                      patternSpeed = 0;            // bar pattern speed
+        double                      barLengthA2  = 0;            // bar length from A2 amplitude
+        double                      barLengthPhi = 0;            // bar length from A2 phase
+        unsigned                    imageBinNum  = 0;            // image matrix rank
+        std::unique_ptr< double[] > imageXY      = nullptr;      // image matrix x-y
+        std::unique_ptr< double[] > imageXZ      = nullptr;      // image matrix x-z
+        std::unique_ptr< double[] > imageYZ      = nullptr;      // image matrix y-z
         // For radial A2 profile
         std::unique_ptr< double[] > A2Re = nullptr;  // real parts of the radial A2 profile
         std::unique_ptr< double[] > A2Im = nullptr;  // imaginary parts of the radial A2 profile
+        // radial profile: (bin, quantity)
+        std::unique_ptr< double[] > profile = nullptr;
+        // velocity percentiles of the radial profile: (bin, percentile, v_R/v_phi/v_z)
+        std::unique_ptr< double[] > percentiles = nullptr;
+        // Lagrangian radii: the spherical radii enclosing the given mass fractions
+        std::unique_ptr< double[] > lagrangianRadii = nullptr;
+        // face-on kinematic maps: (x bin, y bin, quantity)
+        std::unique_ptr< double[] > kinematics = nullptr;
+        // 3D voxel grids: (x bin, y bin, z bin), only in the gridded steps
+        std::unique_ptr< double[] > gridDensity         = nullptr;
+        std::unique_ptr< double[] > gridVelocities[ 3 ] = { nullptr, nullptr, nullptr };
+        // Tremaine-Weinberg integrals: (angle, slit, quantity)
+        std::unique_ptr< double[] > TWintegrals = nullptr;
+        // rotation matrix of the alignment, row-major: aligned = rotation x recentered
+        double rotation[ 9 ] = { 1, 0, 0, 0, 1, 0, 0, 0, 1 };
     };
 
+    // the frame of a recentered coordinate system: the center, then the optional rotation
+    using frameContainer = struct frameStruct
+    {
+        long   step          = -1;     // the step of the frame, -1 for never
+        double center[ 3 ]   = { 0, 0, 0 };
+        bool   aligned       = false;  // whether rotated after recentered
+        double rotation[ 9 ] = { 1, 0, 0, 0, 1, 0, 0, 0, 1 };  // row-major
+    };
+    // frames of the recentered components in their last analysis steps, same in all ranks
+    std::unordered_map< std::string, frameContainer > compFrames;
+    frameContainer orbitFrame;  // frame of the orbits in the current log step
+    // whether the local particles are known to be reordered since the last orbital log
+    bool reorderedSinceLog = false;
+
+    // quantities in each bin of the radial profile: count, mass, surface density, mean and
+    // dispersion of v_R, v_phi, v_z, and <z^2>
+    static constexpr unsigned profileQuantityNum = 10;
+    // quantities accumulated in the radial profile: v_R, v_phi, v_z and z
+    static constexpr unsigned profileMomentNum = 4;
+    // accumulators of the radial profiles, constructed once and reused in each step
+    std::unordered_map< std::string, std::unique_ptr< binned_accumulator > > profileAccumulators;
+    // quantities in each pixel of the kinematic maps: count, surface density, mean and dispersion
+    // of v_R, v_phi, v_z
+    static constexpr unsigned kinematicQuantityNum = 8;
+    // quantities accumulated in the kinematic maps: v_R, v_phi and v_z
+    static constexpr unsigned kinematicMomentNum = 3;
+    // accumulators of the kinematic maps, constructed once and reused in each step
+    std::unordered_map< std::string, std::unique_ptr< binned_accumulator > > kinematicAccumulators;
+
+    // quantile sketches of the velocities in the radial bins followed by the one of the spherical
+    // radii, so that all of them are merged by a single reduction
+    std::unordered_map< std::string, std::unique_ptr< quantile_sketch > > quantileSketches;
+
+    // the states of a single component kept between the analysis steps, only used in root rank
+    using compStateContainer = struct compStateStruct
+    {
+        std::deque< double > barTimes;   // times of the recent bar angles
+        std::deque< double > barPhases;  // unwrapped recent bar angles
+    };
+    std::unordered_map< std::string, compStateContainer > compStates;  // states of components
+
     // extract the data used for orbital log
-    auto id_data_process( double time, unsigned particleNumber, const int* particleIDs,
+    auto id_data_process( unsigned particleNumber, const int* particleIDs,
                           const int* particleTypes, const double* masses, const double* coordinates,
-                          const double* velocities ) const -> std::vector< monitor::orbitPoint >;
+                          const double* velocities,
+                          bool reordered ) -> const std::vector< monitor::orbitPoint >&;
+    // quantize the orbit block, return the number of values clamped into the box
+    auto quantize_orbits() -> unsigned long;
     // NOTE: API of orbital log
     void orbital_log( double time, unsigned particleNumber, const int* ids, const int* partTypes,
-                      const double* masses, const double* coordinates, const double* velocities );
+                      const double* masses, const double* potentials, const double* coordinates,
+                      const double* velocities );
+    // the frame of the orbits in the current log step
+    void orbit_frame( unsigned particleNumber, const int* partTypes, const double* masses,
+                      const double* potentials, const double* coordinates );
     // extract the data of a single component
     static auto
     component_data_extract( unsigned particleNumber, const int* partTypes, const double* masses,
@@ -95,23 +186,58 @@ private:
     void component_analysis( double time, unsigned particleNumber, const int* partTypes,
                              const double* masses, const double* potentials,
                              const double* coordinates, const double* velocities,
-                             std::unique_ptr< otf::component >& comp ) const;
+                             std::unique_ptr< otf::component >& comp );
 
     // NOTE: APIs used in component analysis
 
+    // the center of a system by iterations with shrinking enclosed radii
+    static auto iterative_center( const recenter_para& recenter, unsigned partNum,
+                                  const double* masses, const double* potentials,
+                                  const double* coordinates ) -> std::unique_ptr< double[] >;
     // recenter the coordinates
     static void recenter_coordinate( monitor::compDataContainer&        dataContainer,
                                      std::unique_ptr< otf::component >& comp,
                                      compResContainer&                  res );
+    // sort the particles by their cylindrical radii
+    static void sort_by_radius( monitor::compDataContainer& dataContainer );
+    // get the index range [first, last) of the particles in a radial range, require sorted data
+    static auto radial_slice( const monitor::compDataContainer& dataContainer, double rmin,
+                              double rmax, bool closedUpper = false )
+        -> std::pair< unsigned, unsigned >;
+    // the rotation to the principal axes of the inertia tensor within a radius, same in all ranks
+    static void alignment_rotation( unsigned partNum, const double* masses,
+                                    const double* coordinates, double radius, double* rotation );
     // align the coordinates to the eigenvalues of the
     static void align_coordinate( monitor::compDataContainer&        dataContainer,
-                                  std::unique_ptr< otf::component >& comp );
+                                  std::unique_ptr< otf::component >& comp, compResContainer& res );
     // bar info calculation
     static void bar_info( monitor::compDataContainer&        dataContainer,
                           std::unique_ptr< otf::component >& comp, compResContainer& res );
+    static void bar_info_sorted( monitor::compDataContainer&        dataContainer,
+                                 std::unique_ptr< otf::component >& comp, compResContainer& res );
+    // bar pattern speed from the history of bar angles
+    void pattern_speed( double time, std::unique_ptr< otf::component >& comp,
+                        compResContainer& res );
     // radial A2 profile calculation
     void a2_profile( monitor::compDataContainer&        dataContainer,
                      std::unique_ptr< otf::component >& comp, compResContainer& res ) const;
+    // multi-quantity radial profile calculation
+    void radial_profile( monitor::compDataContainer&        dataContainer,
+                         std::unique_ptr< otf::component >& comp, compResContainer& res ) const;
+    // velocity percentiles in the radial bins and Lagrangian radii calculation
+    void quantile_profiles( monitor::compDataContainer&        dataContainer,
+                            std::unique_ptr< otf::component >& comp, compResContainer& res ) const;
+    // face-on kinematic maps calculation
+    void kinematic_maps( monitor::compDataContainer&        dataContainer,
+                         std::unique_ptr< otf::component >& comp, compResContainer& res ) const;
+    // 3D voxel grids calculation
+    void voxel_grid( monitor::compDataContainer&        dataContainer,
+                     std::unique_ptr< otf::component >& comp, compResContainer& res ) const;
+    // bar length estimation from the radial A2 profile, only in the root rank
+    static void bar_length( std::unique_ptr< otf::component >& comp, compResContainer& res );
+    // Tremaine-Weinberg integrals calculation
+    static void tw_integrals( monitor::compDataContainer&        dataContainer,
+                              std::unique_ptr< otf::component >& comp, compResContainer& res );
     // image calculation
     void image( monitor::compDataContainer& dataContainer, std::unique_ptr< otf::component >& comp,
                 compResContainer& res ) const;
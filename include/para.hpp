@@ -7,6 +7,7 @@
 #define PARA_HEADER
 #include "../include/toml.hpp"
 #include "recenter.hpp"
+#include "statistic.hpp"
 #include <cstdint>
 #include <memory>
 #include <string_view>
@@ -41,16 +42,53 @@ struct align_para
     double radius;  // enclosing radius of the inertia tensor calculation
 };
 
+/**
+ * @class radial_sort_para
+ * @brief The parameters used for sorting the particles by their cylindrical radii.
+ *
+ */
+struct radial_sort_para
+{
+    bool enable;
+};
+
 /**
  * @class image_para
  * @brief The parameters used for image calculation.
  *
  */
 struct image_para
+{
+    bool         enable;
+    double       halfLength;  // half length of the box size to be plotted
+    unsigned     binNum;      // binnum of the image
+    image_kernel kernel;      // deposition kernel of the particles
+};
+
+/**
+ * @class kinematic_map_para
+ * @brief The parameters used for the face-on kinematic maps.
+ *
+ */
+struct kinematic_map_para
 {
     bool     enable;
-    double   halfLength;  // half length of the box size to be plotted
-    unsigned binNum;      // binnum of the image
+    double   halfLength;  // half length of the box size to be mapped
+    unsigned binNum;      // binnum in each direction
+};
+
+/**
+ * @class grid_para
+ * @brief The parameters used for the 3D voxel grids.
+ *
+ */
+struct grid_para
+{
+    bool     enable;
+    double   halfLength;  // half length of the cube to be gridded
+    unsigned binNum;      // binnum in each direction
+    unsigned period;      // grid period, in unit of the analysis period of the component
+    bool     velocity;    // whether grid the mean velocities
 };
 
 /**
@@ -65,6 +103,32 @@ struct basic_bar_para
     double rmax;
 };
 
+/**
+ * @class pattern_speed_para
+ * @brief The parameters used for bar pattern speed calculation.
+ *
+ */
+struct pattern_speed_para
+{
+    bool     enable;
+    unsigned window;  // number of the analysis steps in the sliding window of the linear fit
+};
+
+/**
+ * @class tw_para
+ * @brief The parameters used for the Tremaine-Weinberg integrals.
+ *
+ */
+struct tw_para
+{
+    bool                  enable;
+    double                inclination;  // inclination of the disk, in degree
+    std::vector< double > angles;       // angles between the x-axis and line of nodes, in degree
+    unsigned              slitNum;      // number of slits parallel to the line of nodes
+    double                slitWidth;    // width of each slit
+    double                halfLength;   // half length of each slit
+};
+
 /**
  * @class a2_profile_para
  * @brief The parameters used for A2 radial profile calculation.
@@ -72,10 +136,50 @@ struct basic_bar_para
  */
 struct a2_profile_para
 {
-    bool     enable;
-    double   rmin;
-    double   rmax;
-    unsigned binNum;
+    bool                        enable;
+    double                      rmin;
+    double                      rmax;
+    unsigned                    binNum;
+    std::unique_ptr< bin_axis > axis;  // radial bins, linear, logarithmic or with given edges
+};
+
+/**
+ * @class radial_profile_para
+ * @brief The parameters used for the multi-quantity radial profile calculation.
+ *
+ */
+struct radial_profile_para
+{
+    bool                        enable;
+    double                      rmin;
+    double                      rmax;
+    unsigned                    binNum;
+    std::unique_ptr< bin_axis > axis;  // radial bins, linear, logarithmic or with given edges
+    // percentiles of the velocities in each bin, may be empty
+    std::vector< double > percentiles;
+};
+
+/**
+ * @class lagrangian_para
+ * @brief The parameters used for the Lagrangian radii calculation.
+ *
+ */
+struct lagrangian_para
+{
+    bool                  enable;
+    std::vector< double > fractions;  // the enclosed mass fractions, in (0, 1]
+};
+
+/**
+ * @class bar_length_para
+ * @brief The parameters used for bar length estimation from the A2 radial profile.
+ *
+ */
+struct bar_length_para
+{
+    bool   enable;
+    double fraction;  // bar ends where A2 drops to this fraction of its maximum
+    double deltaPhi;  // bar ends where the m=2 phase deviates by this angle, in degree
 };
 
 /**
@@ -87,6 +191,28 @@ struct orbit_recenter_para : recenter_para
 {
     // the anchor type of particles used for recenter
     std::vector< unsigned > anchorIds;
+    // whether rotate the orbits to the principal axes of the anchors
+    bool align = false;
+    // the enclosed radius of the anchors used for the alignment
+    double alignRadius = 0;
+};
+
+/**
+ * @class orbit_storage_para
+ * @brief The parameters of the storage of orbits: the type of the coordinates and velocities in
+ * the log file, and the fixed-point quantization of them.
+ *
+ */
+struct orbit_storage_para
+{
+    // DOUBLE and FLOAT for the 64-bit and 32-bit floating-point numbers, and QUANTIZED for the
+    // 32-bit integers of the values in units of box / (2^(bits-1) - 1)
+    enum class storage_mode : std::uint8_t { DOUBLE = 0, FLOAT, QUANTIZED };
+    storage_mode mode   = storage_mode::DOUBLE;
+    double       posBox = 0;     // the coordinates are quantized in [-posBox, posBox]
+    double       velBox = 0;     // the velocities are quantized in [-velBox, velBox]
+    unsigned     bits   = 24;    // number of bits of the quantized values, in [2, 31]
+    bool         delta  = true;  // whether store the difference from the previous log step
 };
 
 enum class coordinate_frame : std::uint8_t { CYLINDRICAL = 0, SPHERICAL, CARTESIAN };
@@ -99,17 +225,25 @@ enum class coordinate_frame : std::uint8_t { CYLINDRICAL = 0, SPHERICAL, CARTESI
 struct component
 {
     component( std::string_view& compName, toml::table& compNodeTable );
-    std::string             compName;   // name of the component
-    std::vector< unsigned > types;      // particle types in this component
-    int                     period;     // analysis period
-    recenter_para           recenter;   // parameter of coordinate recenter
-    coordinate_frame        frame;      // coordinate frame type
-    align_para              align;      // whether align coordinates with the inertia tensor
-    image_para              image;      // parameter of the spatial image part
-    basic_bar_para          sBar;       // bar strength parameter
-    basic_bar_para          barAngle;   // bar angle parameter
-    basic_bar_para          sBuckle;    // buckling strength parameter
-    a2_profile_para         A2profile;  // A2(R) profile parameter
+    std::string             compName;      // name of the component
+    std::vector< unsigned > types;         // particle types in this component
+    int                     period;        // analysis period
+    recenter_para           recenter;      // parameter of coordinate recenter
+    coordinate_frame        frame;         // coordinate frame type
+    align_para              align;         // whether align coordinates with the inertia tensor
+    radial_sort_para        radSort;       // whether sort the particles by cylindrical radii
+    image_para              image;         // parameter of the spatial image part
+    kinematic_map_para      kinematics;    // parameter of the face-on kinematic maps
+    grid_para               grid;          // parameter of the 3D voxel grids
+    basic_bar_para          sBar;          // bar strength parameter
+    basic_bar_para          barAngle;      // bar angle parameter
+    basic_bar_para          sBuckle;       // buckling strength parameter
+    pattern_speed_para      patternSpeed;  // bar pattern speed parameter
+    tw_para                 TW;            // Tremaine-Weinberg integrals parameter
+    a2_profile_para         A2profile;     // A2(R) profile parameter
+    bar_length_para         barLength;     // bar length parameter
+    radial_profile_para     profile;       // radial profile parameter
+    lagrangian_para         lagrangian;    // Lagrangian radii parameter
 };
 
 /**
@@ -124,14 +258,22 @@ public:
     // method for id log: TXTFILE to use a text file of id list, and RANDOM for random selection
     // according to specified parameters.
     enum class id_selection_method : std::uint8_t { TXTFILE = 0, RANDOM };
+    // format of the id list file: one id per line in a text file, a raw binary file of native
+    // 32-bit or 64-bit integers, or a dataset in an HDF5 file
+    enum class id_file_format : std::uint8_t { TEXT = 0, INT32, INT64, HDF5 };
 
     bool                enable;                 // enable orbital log
     int                 period;                 // log period
     id_selection_method method;                 // id determination method
     std::string         idfile   = "not used";  // if method is txt file, give the file name
     double              fraction = -1;          // if method is random sample, give the fraction
+    std::uint64_t       seed     = 0;           // if method is random sample, the hash seed
     std::vector< int >  sampleTypes;            // particle types to be sampled
     orbit_recenter_para recenter;               // whether recenter the coordinate of orbits
+    orbit_storage_para  storage;                // storage of the orbits in the log file
+    // if method is txt file, the format of the file, and the dataset of ids in an HDF5 file
+    id_file_format idformat  = id_file_format::TEXT;
+    std::string    iddataset = "ParticleIDs";
 };
 
 /**
@@ -143,11 +285,14 @@ class runtime_para
 {
 public:
     runtime_para( const std::string_view& tomlParaFile );
-    bool        enableOtf;  // whether enable on-the-fly analysis
-    std::string outputDir;  // output directory of the logs
-    std::string fileName;   // prefix of the log file
-    unsigned    maxIter;    // specify the maximal iteration times
-    double      epsilon;    // specify the equal threshold of floating-point numbers
+    bool        enableOtf;    // whether enable on-the-fly analysis
+    std::string outputDir;    // output directory of the logs
+    std::string fileName;     // prefix of the log file
+    unsigned    maxIter;      // specify the maximal iteration times
+    double      epsilon;      // specify the equal threshold of floating-point numbers
+    unsigned    bufferRows;     // write the buffered scalar logs every so many steps
+    double      bufferTime;     // or at the next step after so many seconds since the last write
+    bool        flushOnSignal;  // whether write the buffered logs at SIGINT or SIGTERM
 
     // hash map of parameter for each component
     std::unordered_map< std::string, std::unique_ptr< otf::component > > comps;
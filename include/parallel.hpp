@@ -0,0 +1,226 @@
+/**
+ * @file parallel.hpp
+ * @brief Thread-parallel deposition of data points into bins, used by the binning statistics and
+ * the Fourier kernels. Without OpenMP, all of them fall back to a serial loop.
+ */
+
+#ifndef PARALLEL_HEADER
+#define PARALLEL_HEADER
+#include <cstddef>
+#include <type_traits>
+#include <vector>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace otf {
+
+/**
+ * @class parallel_bins
+ * @brief Wrapper class of the thread-parallel binning APIs. Each thread deposits a contiguous chunk
+ * of the data into its private bins, and the private bins are merged by a pairwise tree in a fixed
+ * order. If the private bins of all threads are too large (e.g. large images), each thread owns a
+ * block of the elements instead and deposits the data points in their original order. So the
+ * results only depend on the size of the thread team actually given by OpenMP, never on the
+ * scheduling.
+ *
+ */
+class parallel_bins
+{
+public:
+    // number of threads to be used for the given number of data points
+    static auto thread_num( unsigned long dataNum ) -> int
+    {
+#ifdef _OPENMP
+        const unsigned long maxNum = dataNum / minChunk;
+        const int           num    = omp_get_max_threads();
+        return maxNum < ( unsigned long )num ? ( maxNum > 0 ? ( int )maxNum : 1 ) : num;
+#else
+        ( void )dataNum;
+        return 1;
+#endif
+    }
+
+    // the default merge of bins: element-wise summation
+    template < typename T >
+    static void add( T* bins, const T* other, const unsigned long size )
+    {
+        for ( auto i = 0UL; i < size; ++i )
+        {
+            bins[ i ] += other[ i ];
+        }
+    }
+
+    /**
+     * @brief Deposit the data points into bins, the bins are accumulated rather than overwritten.
+     *
+     * @param dataNum number of data points
+     * @param binNum number of bins
+     * @param binLength number of elements in each bin
+     * @param bins pointing to the binNum * binLength elements
+     * @param index index( i ) gives the bin of the i-th data point, or a negative value to skip it
+     * @param accumulate accumulate( bin, i ) adds the i-th data point to the elements of its bin,
+     * or accumulate( bin, i, lower, upper ) only adds it to the elements [lower, upper) of the bin
+     * @param merge merge( bins, other, size ) merges the elements of other into bins
+     *
+     * Under the blocked ownership, an accumulate without the element range can only be split by
+     * whole bins, so a few large bins (e.g. the images deposited by sum) should take the range.
+     */
+    template < typename T, typename Index, typename Deposit, typename Merge >
+    static void deposit( const unsigned long dataNum, const unsigned long binNum,
+                         const unsigned long binLength, T* bins, const Index& index,
+                         const Deposit& accumulate, const Merge& merge )
+    {
+        const int           threads = thread_num( dataNum );
+        const unsigned long size    = binNum * binLength;
+        if ( threads == 1 )
+        {
+            for ( auto i = 0UL; i < dataNum; ++i )
+            {
+                const long bin = index( i );
+                if ( bin >= 0 )
+                {
+                    apply( accumulate, bins + bin * binLength, i, 0, binLength );
+                }
+            }
+            return;
+        }
+
+        if ( threads * size * sizeof( T ) <= privateBytes )
+        {
+            // private bins of each thread, the first thread works on the output directly
+            std::vector< std::vector< T > > privateBins( threads - 1, std::vector< T >( size ) );
+#pragma omp parallel num_threads( threads )
+            {
+                // the team may be smaller than requested (dynamic adjustment, thread limit or a
+                // nested region), so the work is split by the actual team size
+                const int  team   = team_size();
+                const int  thread = thread_id();
+                T*         local  = thread == 0 ? bins : privateBins[ thread - 1 ].data();
+                const auto end    = dataNum * ( thread + 1 ) / team;
+                for ( auto i = dataNum * thread / team; i < end; ++i )
+                {
+                    const long bin = index( i );
+                    if ( bin >= 0 )
+                    {
+                        apply( accumulate, local + bin * binLength, i, 0, binLength );
+                    }
+                }
+                // pairwise tree merge in a fixed order
+                for ( int stride = 1; stride < team; stride *= 2 )
+                {
+#pragma omp barrier
+                    if ( thread % ( 2 * stride ) == 0 and thread + stride < team )
+                    {
+                        merge( local, privateBins[ thread + stride - 1 ].data(), size );
+                    }
+                }
+            }
+            return;
+        }
+
+        // blocked ownership: the bin indexes are calculated once in parallel, then each thread
+        // deposits the data points into its own block of the elements, which is rounded to whole
+        // bins if the accumulate can not be limited to a range
+        std::vector< long > indexes( dataNum );
+#pragma omp parallel for num_threads( threads ) schedule( static )
+        for ( auto i = 0UL; i < dataNum; ++i )
+        {
+            indexes[ i ] = index( i );
+        }
+#pragma omp parallel num_threads( threads )
+        {
+            const int     team   = team_size();
+            const int     thread = thread_id();
+            unsigned long lower  = size * thread / team;
+            unsigned long upper  = size * ( thread + 1 ) / team;
+            if constexpr ( not ranged< T, Deposit > )
+            {
+                lower = ( lower + binLength - 1 ) / binLength * binLength;
+                upper = ( upper + binLength - 1 ) / binLength * binLength;
+            }
+            for ( auto i = 0UL; i < dataNum and lower < upper; ++i )
+            {
+                if ( indexes[ i ] < 0 )
+                {
+                    continue;
+                }
+                const unsigned long begin = indexes[ i ] * binLength;
+                if ( begin < upper and begin + binLength > lower )
+                {
+                    apply( accumulate, bins + begin, i, lower > begin ? lower - begin : 0,
+                           upper - begin < binLength ? upper - begin : binLength );
+                }
+            }
+        }
+    }
+
+    // deposit with the default merge (summation)
+    template < typename T, typename Index, typename Deposit >
+    static void deposit( const unsigned long dataNum, const unsigned long binNum,
+                         const unsigned long binLength, T* bins, const Index& index,
+                         const Deposit& accumulate )
+    {
+        parallel_bins::deposit( dataNum, binNum, binLength, bins, index, accumulate, add< T > );
+    }
+
+    // accumulate width sums over the data points, where kernel( sums, i ) adds the i-th point, or
+    // kernel( sums, i, lower, upper ) only adds it to the sums [lower, upper) for large widths
+    template < typename T, typename Kernel >
+    static void sum( const unsigned long dataNum, const unsigned long width, T* sums,
+                     const Kernel& kernel )
+    {
+        parallel_bins::deposit(
+            dataNum, 1, width, sums, []( unsigned long ) -> long { return 0; }, kernel );
+    }
+
+#ifdef DEBUG
+
+#else
+private:
+#endif
+    // minimal number of data points for each thread
+    static inline unsigned long minChunk = 4096;
+    // maximal total memory of the private bins, beyond which the blocked ownership is used
+    static inline std::size_t privateBytes = 1UL << 26;
+    // whether the accumulate takes the element range of the bin
+    template < typename T, typename Deposit >
+    static constexpr bool ranged =
+        std::is_invocable_v< const Deposit&, T*, unsigned long, unsigned long, unsigned long >;
+    // call the accumulate with the element range if it takes one
+    template < typename T, typename Deposit >
+    static void apply( const Deposit& accumulate, T* bin, const unsigned long i,
+                       const unsigned long lower, const unsigned long upper )
+    {
+        if constexpr ( ranged< T, Deposit > )
+        {
+            accumulate( bin, i, lower, upper );
+        }
+        else
+        {
+            ( void )lower;
+            ( void )upper;
+            accumulate( bin, i );
+        }
+    }
+    static auto thread_id() -> int
+    {
+#ifdef _OPENMP
+        return omp_get_thread_num();
+#else
+        return 0;
+#endif
+    }
+    // number of threads in the current team
+    static auto team_size() -> int
+    {
+#ifdef _OPENMP
+        return omp_get_num_threads();
+#else
+        return 1;
+#endif
+    }
+};
+
+}  // namespace otf
+#endif
@@ -0,0 +1,36 @@
+/**
+ * @file radixsort.hpp
+ * @brief LSD radix sort of floating-point keys, used to order the particles by their radii.
+ */
+
+#ifndef RADIXSORT_HEADER
+#define RADIXSORT_HEADER
+#include <cstdint>
+#include <memory>
+
+namespace otf {
+
+/**
+ * @class radix_sort
+ * @brief Wrapper class of the radix sort APIs.
+ *
+ */
+class radix_sort
+{
+public:
+    // get the permutation that sorts the keys in ascending order (stable)
+    static auto argsort( const double* keys, unsigned num ) -> std::unique_ptr< unsigned[] >;
+
+#ifdef DEBUG
+
+#else
+private:
+#endif
+    static constexpr unsigned digitBits = 11;  // bits of a single radix digit
+    static constexpr unsigned radix     = 1U << digitBits;
+    // map a double to an unsigned integer with the same order
+    static auto ordered_bits( double key ) -> std::uint64_t;
+};
+
+}  // namespace otf
+#endif
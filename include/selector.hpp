@@ -5,7 +5,9 @@
 
 #ifndef SELECTOR_HEADER
 #define SELECTOR_HEADER
+#include "../include/idset.hpp"
 #include "../include/para.hpp"
+#include <cstdint>
 #include <memory>
 #include <string>
 #include <vector>
@@ -36,9 +38,10 @@ class orbit_selector
 {
 public:
     orbit_selector( const runtime_para& para );
+    // reordered: whether the caller knows the local particles were reordered since the last call
     auto select( unsigned particleNumber, const int* particleID, const int* partType,
-                 const double* mass, const double* coordinate,
-                 const double* velocity ) const -> std::unique_ptr< dataContainer >;
+                 const double* mass, const double* coordinate, const double* velocity,
+                 bool reordered = false ) const -> std::unique_ptr< dataContainer >;
 
 #ifdef DEBUG
 
@@ -46,12 +49,22 @@ public:
 private:
 #endif
     const runtime_para& para;
-    static auto         id_sample( const std::vector< int >& rawIds, const int* types,
-                                   const std::vector< int >& sampleTypes,
-                                   double                    fraction ) -> std::vector< int >;
-    static auto         id_read( const std::string& idFilename ) -> std::vector< int >;
-    auto                extract_target_ids( unsigned particleNumber, const int* particleID,
-                                            const int* partType ) const -> std::vector< int >;
+    // the target ids of the id list file, built at the first call of select
+    mutable std::unique_ptr< id_set > targetIDs = nullptr;
+    // the local indexes, ids and types of the particles found in the last call, in ascending
+    // order of the indexes, which are verified first in the next call
+    mutable std::vector< unsigned > hintIndexes;
+    mutable std::vector< int >      hintIDs;
+    mutable std::vector< int >      hintTypes;
+    mutable long                    lastFoundNum = -1;  // number of found particles in all ranks
+    mutable unsigned                fullScanNum  = 0;   // number of the full membership scans
+    // the local indexes of the target particles
+    auto find_targets( unsigned particleNumber, const int* particleID, const int* partType,
+                       bool reordered ) const -> const std::vector< unsigned >&;
+    // whether the particle is a target of the orbital log
+    auto        is_target( int particleID, int partType ) const -> bool;
+    static auto id_sampled( int particleID, std::uint64_t seed, double fraction ) -> bool;
+    static auto id_read( const orbit& orbitPara ) -> std::vector< int >;
 };
 
 }  // namespace otf
@@ -0,0 +1,64 @@
+/**
+ * @file sketch.hpp
+ * @brief Mergeable quantile sketches (t-digests) in bins, used for the percentile profiles and the
+ * Lagrangian radii without gathering the particles.
+ */
+
+#ifndef SKETCH_HEADER
+#define SKETCH_HEADER
+#include "statistic.hpp"
+#include <mpi.h>
+#include <utility>
+#include <vector>
+
+/**
+ * @class quantile_sketch
+ * @brief A merging t-digest in each bin. The digest of a bin is a fixed-size record of at most
+ * capacity centroids, so the digests of all bins are merged over the processes by a single
+ * reduction with a user-defined MPI operation. The values are buffered and merged into the
+ * centroids in batches, the size of a centroid is limited by the arcsine scale function, so the
+ * quantiles near 0 and 1 are much more accurate than the ones in the middle.
+ *
+ */
+class quantile_sketch
+{
+public:
+    quantile_sketch( unsigned long binNum = 1, double compression = 100 );
+    // add a weighted value to a bin
+    void add( unsigned long bin, double value, double weight = 1 );
+    // add the weighted values to the bins of their coordinates, weights may be nullptr
+    void add( unsigned long dataNum, const double* coord, const bin_axis& axis,
+              const double* values, const double* weights );
+    void reduce( int mpiRank );  // merge the digests of all ranks into the root rank
+    void reset();                // clear all digests, to be reused in the next step
+    auto bin_num() const -> unsigned long
+    {
+        return binNum;
+    }
+    auto weight( unsigned long bin ) -> double;  // total weight in a bin
+    // the value below which the fraction q of the weight in a bin lies, nan for an empty bin
+    auto quantile( unsigned long bin, double q ) -> double;
+
+#ifdef DEBUG
+
+#else
+private:
+#endif
+    // the record of a digest: centroid number, total weight, min, max, compression, then the
+    // (mean, weight) pairs of the centroids
+    static constexpr unsigned long headLength = 5;
+    double                         compression;  // the delta parameter of the t-digest
+    unsigned long                  binNum;
+    unsigned long                  capacity;      // maximal number of centroids in a record
+    unsigned long                  recordLength;  // headLength + 2 * capacity
+    std::vector< double >          records;       // binNum * recordLength values
+    // the values not merged into the centroids yet: (value, weight)
+    std::vector< std::vector< std::pair< double, double > > > pending;
+    void flush( unsigned long bin );  // merge the pending values of a bin into its record
+    void flush_all();
+    // merge the centroids into a record, which are compressed by the scale function
+    static void compress( double* record, std::vector< std::pair< double, double > >& centroids );
+    // the user-defined reduction of records
+    static void merge_records( void* in, void* inout, int* len, MPI_Datatype* datatype );
+};
+#endif
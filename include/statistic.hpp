@@ -1,14 +1,152 @@
 /**
  * @file statistic.hpp
  * @brief This file includes a class as a wrapper for statistic functions. At now, mainly the 1D/2D
- * evenly binning statistics for limited methods.
+ * binning statistics for limited methods, with linear, logarithmic or arbitrary bins.
  */
 
 #ifndef STATISTIC_HEADER
 #define STATISTIC_HEADER
+#include <cmath>
 #include <cstdint>
 #include <memory>
+#include <vector>
 enum class statistic_method : std::uint8_t { COUNT = 0, MEAN, STD, SUM };
+enum class bin_scale : std::uint8_t { LINEAR = 0, LOG, CUSTOM };
+// deposition kernels of the images: nearest grid point, cloud-in-cell, triangular-shaped-cloud
+enum class image_kernel : std::uint8_t { NGP = 0, CIC, TSC };
+
+/**
+ * @class bin_axis
+ * @brief The bins along a single coordinate: evenly distributed in linear or logarithmic scale, or
+ * given by arbitrary increasing edges. The bin of a value is located in O(1) for all of them.
+ *
+ */
+class bin_axis
+{
+public:
+    bin_axis( double lowerBound, double upperBound, unsigned long binNum,
+              bin_scale scale = bin_scale::LINEAR );
+    explicit bin_axis( const std::vector< double >& edges );
+    auto bin_num() const -> unsigned long { return binNum; }
+    auto lower_bound() const -> double { return lowerBound; }
+    auto upper_bound() const -> double { return upperBound; }
+    auto get_scale() const -> bin_scale { return scale; }
+    auto edge( unsigned long index ) const -> double;    // the index-th edge, 0 <= index <= binNum
+    auto center( unsigned long index ) const -> double;  // geometric center for the log scale
+    // whether the value is in [lowerBound, upperBound)
+    auto contains( const double value ) const -> bool
+    {
+        return value >= lowerBound and value < upperBound;
+    }
+    // the bin a value inside the range should be located, there is no boundary check!
+    auto find_index( const double value ) const -> unsigned long
+    {
+        switch ( scale )
+        {
+        case bin_scale::LINEAR: {
+            return ( value - lowerBound ) / ( upperBound - lowerBound ) * binNum;
+        }
+        case bin_scale::LOG: {
+            unsigned long index = ( std::log( value ) - logLowerBound ) * factor;
+            index               = index < binNum ? index : binNum - 1;
+            // correct the round-off error near the edges
+            if ( value < edges[ index ] )
+            {
+                --index;
+            }
+            else if ( value >= edges[ index + 1 ] )
+            {
+                ++index;
+            }
+            return index;
+        }
+        default: {
+            unsigned long cell = ( value - lowerBound ) * factor;
+            cell               = cell < lookup.size() ? cell : lookup.size() - 1;
+            // start from the bin of the cell's lower edge, usually at most one step away
+            unsigned long index = lookup[ cell ];
+            while ( index > 0 and value < edges[ index ] )
+            {
+                --index;
+            }
+            while ( value >= edges[ index + 1 ] )
+            {
+                ++index;
+            }
+            return index;
+        }
+        }
+    }
+
+#ifdef DEBUG
+
+#else
+private:
+#endif
+    // the maximal number of cells in the lookup table of arbitrary edges
+    static constexpr unsigned long maxLookupCells = 1UL << 20;
+    bin_scale                      scale;
+    double                         lowerBound;
+    double                         upperBound;
+    unsigned long                  binNum;
+    double                         logLowerBound = 0;  // log of the lower bound, for log scale
+    double                         factor        = 0;  // inverse width of a bin or a lookup cell
+    std::vector< double >          edges;              // binNum + 1 edges, for log and custom bins
+    std::vector< unsigned long >   lookup;  // bin of the lower edge of each cell, for custom bins
+};
+
+/**
+ * @class binned_accumulator
+ * @brief Weighted moments of several quantities in 1D or 2D bins. It is constructed once and its
+ * buffer is reused between the analysis steps: the data can be added in several calls (e.g. chunks
+ * of particles or several components) before a single reduction to the root rank. The moments are
+ * centered (Welford), so the dispersions stay accurate for quantities with a large offset.
+ *
+ */
+class binned_accumulator
+{
+public:
+    binned_accumulator( const bin_axis& axis, unsigned long quantityNum,
+                        bool secondMoments = true );
+    binned_accumulator( const bin_axis& xAxis, const bin_axis& yAxis, unsigned long quantityNum,
+                        bool secondMoments = true );
+    // add data points to 1D bins, with unit weights if weights is nullptr
+    void add( unsigned long dataNum, const double* coord, const double* weights,
+              const double* const* quantities );
+    // add data points to 2D bins, with unit weights if weights is nullptr
+    void add( unsigned long dataNum, const double* xData, const double* yData,
+              const double* weights, const double* const* quantities );
+    void reduce( int mpiRank );  // sum up the bins of all ranks in the root rank
+    void reset();                // clear the bins for the next step
+    auto bin_num() const -> unsigned long { return binNum; }
+    // [count, sum of weights, (weighted mean of q, weighted sum of squared deviations) for each q]
+    auto bin_length() const -> unsigned long { return binLength; }
+    auto data() const -> const double* { return bins.data(); }
+    // the following results are complete in the root rank after the reduction
+    auto count( unsigned long bin ) const -> double;
+    auto weight( unsigned long bin ) const -> double;
+    // weighted mean, nan for empty bins
+    auto mean( unsigned long bin, unsigned long quantity ) const -> double;
+    // weighted mean of the square, nan for empty bins, require second moments
+    auto mean_square( unsigned long bin, unsigned long quantity ) const -> double;
+    // weighted standard deviation, nan for empty bins, require second moments
+    auto dispersion( unsigned long bin, unsigned long quantity ) const -> double;
+
+#ifdef DEBUG
+
+#else
+private:
+#endif
+    std::vector< bin_axis > axes;           // 1 or 2 axes
+    unsigned long           quantityNum;    // number of quantities
+    bool                    secondMoments;  // whether accumulate the weighted sum of q^2
+    unsigned long           binNum;         // total number of bins
+    unsigned long           binLength;      // number of values in each bin
+    std::vector< double >   bins;           // binNum * binLength values
+    // accumulate the i-th data point in a bin
+    void accumulate( double* bin, unsigned long i, const double* weights,
+                     const double* const* quantities );
+};
 
 /**
  * @class statistic
@@ -23,45 +161,68 @@ public:
                        double yUpperBound, unsigned long yBinNum, statistic_method method,
                        unsigned long dataNum,
                        const double* data = nullptr ) -> std::unique_ptr< double[] >;
+    static auto bin2d( int mpiRank, const double* xData, const bin_axis& xAxis,
+                       const double* yData, const bin_axis& yAxis, statistic_method method,
+                       unsigned long dataNum,
+                       const double* data = nullptr ) -> std::unique_ptr< double[] >;
     static auto bin1d( int mpiRank, const double* coord, double lowerBound, double upperBound,
                        unsigned long binNum, statistic_method method, unsigned long dataNum,
                        const double* data = nullptr ) -> std::unique_ptr< double[] >;
+    static auto bin1d( int mpiRank, const double* coord, const bin_axis& axis,
+                       statistic_method method, unsigned long dataNum,
+                       const double* data = nullptr ) -> std::unique_ptr< double[] >;
+    // weighted x-y, x-z and y-z projections of 3D points, with a single reduction
+    static auto projections( int mpiRank, const double* coordinates, const bin_axis& axis,
+                             unsigned long dataNum, const double* weights = nullptr,
+                             image_kernel kernel = image_kernel::NGP )
+        -> std::unique_ptr< double[] >;
+    // count, sum or mean of the weighted data in 3D bins, with a single reduction
+    static auto bin3d( int mpiRank, const double* coordinates, const bin_axis& xAxis,
+                       const bin_axis& yAxis, const bin_axis& zAxis, statistic_method method,
+                       unsigned long dataNum, const double* data = nullptr,
+                       const double* weights = nullptr ) -> std::unique_ptr< double[] >;
+    // weighted sums of several quantities in 3D bins, with a single reduction
+    static auto sums3d( int mpiRank, const double* coordinates, const bin_axis& xAxis,
+                        const bin_axis& yAxis, const bin_axis& zAxis, unsigned long dataNum,
+                        const double* weights, unsigned long quantityNum,
+                        const double* quantities ) -> std::unique_ptr< double[] >;
+    // weighted moments of several quantities in 1D bins, with a single reduction
+    static auto moments1d( int mpiRank, const double* coord, double lowerBound, double upperBound,
+                           unsigned long binNum, unsigned long dataNum, const double* weights,
+                           unsigned long        quantityNum,
+                           const double* const* quantities ) -> std::unique_ptr< double[] >;
+    static auto moments1d( int mpiRank, const double* coord, const bin_axis& axis,
+                           unsigned long dataNum, const double* weights, unsigned long quantityNum,
+                           const double* const* quantities ) -> std::unique_ptr< double[] >;
 
 #ifdef DEBUG
 
 #else
 private:
 #endif
-    // function that determines the bin a data point should be located (evenly distributed bins)
-    static auto find_index( double lowerBound, double upperBound, unsigned long binNum,
-                            double value ) -> unsigned long;
-    static auto bin2dcount( int mpiRank, const double* xData, double xLowerBound,
-                            double xUpperBound, unsigned long xBinNum, const double* yData,
-                            double yLowerBound, double yUpperBound, unsigned long yBinNum,
+    static auto bin2dcount( int mpiRank, const double* xData, const bin_axis& xAxis,
+                            const double* yData, const bin_axis& yAxis,
                             unsigned long dataNum ) -> std::unique_ptr< double[] >;
-    static auto bin2dsum( int mpiRank, const double* xData, double xLowerBound, double xUpperBound,
-                          unsigned long xBinNum, const double* yData, double yLowerBound,
-                          double yUpperBound, unsigned long yBinNum, unsigned long dataNum,
+    static auto bin2dsum( int mpiRank, const double* xData, const bin_axis& xAxis,
+                          const double* yData, const bin_axis& yAxis, unsigned long dataNum,
                           const double* data ) -> std::unique_ptr< double[] >;
-    static auto bin2dmean( int mpiRank, const double* xData, double xLowerBound, double xUpperBound,
-                           unsigned long xBinNum, const double* yData, double yLowerBound,
-                           double yUpperBound, unsigned long yBinNum, unsigned long dataNum,
+    static auto bin2dmean( int mpiRank, const double* xData, const bin_axis& xAxis,
+                           const double* yData, const bin_axis& yAxis, unsigned long dataNum,
                            const double* data ) -> std::unique_ptr< double[] >;
-    static auto bin2dstd( const double* xData, double xLowerBound, double xUpperBound,
-                          unsigned long xBinNum, const double* yData, double yLowerBound,
-                          double yUpperBound, unsigned long yBinNum, unsigned long dataNum,
+    static auto bin2dstd( const double* xData, const bin_axis& xAxis, const double* yData,
+                          const bin_axis& yAxis, unsigned long dataNum,
                           const double* data ) -> std::unique_ptr< double[] >;
-    static auto bin1dcount( int mpiRank, const double* coord, double lowerBound, double upperBound,
-                            unsigned long binNum,
+    static auto bin1dcount( int mpiRank, const double* coord, const bin_axis& axis,
                             unsigned long dataNum ) -> std::unique_ptr< double[] >;
-    static auto bin1dsum( int mpiRank, const double* coord, double lowerBound, double upperBound,
-                          unsigned long binNum, unsigned long dataNum,
+    static auto bin1dsum( int mpiRank, const double* coord, const bin_axis& axis,
+                          unsigned long dataNum,
                           const double* data = nullptr ) -> std::unique_ptr< double[] >;
-    static auto bin1dmean( int mpiRank, const double* coord, double lowerBound, double upperBound,
-                           unsigned long binNum, unsigned long dataNum,
+    static auto bin1dmean( int mpiRank, const double* coord, const bin_axis& axis,
+                           unsigned long dataNum,
                            const double* data = nullptr ) -> std::unique_ptr< double[] >;
-    static auto bin1dstd( const double* coord, double lowerBound, double upperBound,
-                          unsigned long binNum, unsigned long dataNum,
+    static auto bin1dstd( const double* coord, const bin_axis& axis, unsigned long dataNum,
                           const double* data = nullptr ) -> std::unique_ptr< double[] >;
+    // maximal ratio of the gathered bounding boxes to the images, for the sparse reduction
+    static inline double sparseRatio = 1.0;
 };
 #endif
@@ -1,6 +1,11 @@
 #include "../include/barinfo.hpp"
+#include "../include/parallel.hpp"
+#include <algorithm>
 #include <cmath>
+#include <memory>
 #include <mpi.h>
+#include <numbers>
+#include <vector>
 using namespace std;
 
 namespace otf {
@@ -15,10 +20,8 @@ namespace otf {
 auto bar_info::A0( const unsigned partNum, const double* masses ) -> double
 {
     double A0sum = 0;
-    for ( auto i = 0U; i < partNum; ++i )
-    {
-        A0sum += masses[ i ];
-    }
+    parallel_bins::sum( partNum, 1, &A0sum,
+                        [ masses ]( double* sum, unsigned long i ) { *sum += masses[ i ]; } );
     MPI_Allreduce( MPI_IN_PLACE, &A0sum, 1, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD );
     return A0sum;
 }
@@ -33,16 +36,13 @@ auto bar_info::A0( const unsigned partNum, const double* masses ) -> double
  */
 auto bar_info::A2( const unsigned partNum, const double* masses, const double* phis ) -> double
 {
-    double A2sumRe = 0;  // real part
-    double A2sumIm = 0;  // imaginary part
-    for ( auto i = 0U; i < partNum; ++i )
-    {
-        A2sumRe += masses[ i ] * cos( 2 * phis[ i ] );
-        A2sumIm += masses[ i ] * sin( 2 * phis[ i ] );
-    }
-    MPI_Allreduce( MPI_IN_PLACE, &A2sumRe, 1, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD );
-    MPI_Allreduce( MPI_IN_PLACE, &A2sumIm, 1, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD );
-    return sqrt( A2sumRe * A2sumRe + A2sumIm * A2sumIm );
+    double A2sum[ 2 ] = { 0, 0 };  // real and imaginary parts
+    parallel_bins::sum( partNum, 2, A2sum, [ masses, phis ]( double* sum, unsigned long i ) {
+        sum[ 0 ] += masses[ i ] * cos( 2 * phis[ i ] );
+        sum[ 1 ] += masses[ i ] * sin( 2 * phis[ i ] );
+    } );
+    MPI_Allreduce( MPI_IN_PLACE, A2sum, 2, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD );
+    return sqrt( A2sum[ 0 ] * A2sum[ 0 ] + A2sum[ 1 ] * A2sum[ 1 ] );
 }
 
 /**
@@ -56,17 +56,14 @@ auto bar_info::A2( const unsigned partNum, const double* masses, const double* p
 auto bar_info::bar_angle( const unsigned partNum, const double* masses,
                           const double* phis ) -> double
 {
-    double A2sumRe = 0;  // real part
-    double A2sumIm = 0;  // imaginary part
-    for ( auto i = 0U; i < partNum; ++i )
-    {
-        A2sumRe += masses[ i ] * cos( 2 * phis[ i ] );
-        A2sumIm += masses[ i ] * sin( 2 * phis[ i ] );
-    }
+    double A2sum[ 2 ] = { 0, 0 };  // real and imaginary parts
+    parallel_bins::sum( partNum, 2, A2sum, [ masses, phis ]( double* sum, unsigned long i ) {
+        sum[ 0 ] += masses[ i ] * cos( 2 * phis[ i ] );
+        sum[ 1 ] += masses[ i ] * sin( 2 * phis[ i ] );
+    } );
     // MPI reduce
-    MPI_Allreduce( MPI_IN_PLACE, &A2sumRe, 1, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD );
-    MPI_Allreduce( MPI_IN_PLACE, &A2sumIm, 1, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD );
-    return atan2( A2sumIm, A2sumRe ) / 2;
+    MPI_Allreduce( MPI_IN_PLACE, A2sum, 2, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD );
+    return atan2( A2sum[ 1 ], A2sum[ 0 ] ) / 2;
 }
 
 /**
@@ -81,17 +78,293 @@ auto bar_info::bar_angle( const unsigned partNum, const double* masses,
 auto bar_info::Sbuckle( const unsigned partNum, const double* masses, const double* phis,
                         const double* zeds ) -> double
 {
-    const double A0value     = A0( partNum, masses );
-    double       numeratorRe = 0;  // real part
-    double       numeratorIm = 0;  // imaginary part
-    for ( auto i = 0U; i < partNum; ++i )
+    const double A0value        = A0( partNum, masses );
+    double       numerator[ 2 ] = { 0, 0 };  // real and imaginary parts
+    parallel_bins::sum( partNum, 2, numerator,
+                        [ masses, phis, zeds ]( double* sum, unsigned long i ) {
+                            sum[ 0 ] += masses[ i ] * zeds[ i ] * cos( 2 * phis[ i ] );
+                            sum[ 1 ] += masses[ i ] * zeds[ i ] * sin( 2 * phis[ i ] );
+                        } );
+    MPI_Allreduce( MPI_IN_PLACE, numerator, 2, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD );
+    return sqrt( numerator[ 0 ] * numerator[ 0 ] + numerator[ 1 ] * numerator[ 1 ] ) / A0value;
+}
+
+/**
+ * @brief Unwrap the bar angle, which is wrapped to [-pi/2, pi/2] as the m=2 phase, by adding the
+ * multiple of pi that makes it closest to the previous (unwrapped) bar angle.
+ *
+ * @param previous the previous unwrapped bar angle
+ * @param current the current wrapped bar angle
+ * @return the unwrapped bar angle
+ */
+auto bar_info::unwrap_bar_angle( const double previous, const double current ) -> double
+{
+    return current + round( ( previous - current ) / numbers::pi ) * numbers::pi;
+}
+
+/**
+ * @brief Calculate the pattern speed as the slope of the least squares linear fit of the unwrapped
+ * bar angles against time.
+ *
+ * @param num number of the data points
+ * @param times times of the data points
+ * @param phases unwrapped bar angles of the data points
+ * @return the pattern speed, or nan if there are less than 2 distinct times
+ */
+auto bar_info::pattern_speed( const unsigned num, const double* times,
+                              const double* phases ) -> double
+{
+    if ( num < 2 )
+    {
+        return nan( "" );
+    }
+
+    // mean values, subtracted for numerical stability
+    double meanTime  = 0;
+    double meanPhase = 0;
+    for ( auto i = 0U; i < num; ++i )
+    {
+        meanTime += times[ i ];
+        meanPhase += phases[ i ];
+    }
+    meanTime /= num;
+    meanPhase /= num;
+
+    double covariance = 0;
+    double variance   = 0;
+    for ( auto i = 0U; i < num; ++i )
+    {
+        covariance += ( times[ i ] - meanTime ) * ( phases[ i ] - meanPhase );
+        variance += ( times[ i ] - meanTime ) * ( times[ i ] - meanTime );
+    }
+
+    if ( variance == 0 )
+    {
+        return nan( "" );
+    }
+    return covariance / variance;
+}
+
+/**
+ * @brief Find the bin with the maximal A2 amplitude in a radial A2 profile, the empty bins (nan)
+ * are ignored.
+ *
+ * @param binNum number of the radial bins
+ * @param A2Re real parts of the A2 profile
+ * @param A2Im imaginary parts of the A2 profile
+ * @return the index of the bin, or binNum if all bins are empty
+ */
+static auto a2_max_bin( const unsigned binNum, const double* A2Re, const double* A2Im ) -> unsigned
+{
+    unsigned maxBin = binNum;
+    double   maxA2  = -1;
+    for ( auto i = 0U; i < binNum; ++i )
+    {
+        const double amplitude = hypot( A2Re[ i ], A2Im[ i ] );
+        if ( not isnan( amplitude ) and amplitude > maxA2 )
+        {
+            maxA2  = amplitude;
+            maxBin = i;
+        }
+    }
+    return maxBin;
+}
+
+/**
+ * @brief Estimate the bar length as the radius beyond the peak of the A2 profile, where the A2
+ * amplitude drops to a fraction of its maximum. The radius is linearly interpolated between the
+ * two bins across the threshold, and the empty bins (nan) are skipped.
+ *
+ * @param binNum number of the radial bins
+ * @param radii radii of the bin centers, in ascending order
+ * @param A2Re real parts of the A2 profile
+ * @param A2Im imaginary parts of the A2 profile
+ * @param fraction the fraction of the maximal A2 amplitude
+ * @return the bar length, or nan if the A2 amplitude never drops below the threshold
+ */
+auto bar_info::bar_length_a2( const unsigned binNum, const double* radii, const double* A2Re,
+                              const double* A2Im, const double fraction ) -> double
+{
+    const unsigned maxBin = a2_max_bin( binNum, A2Re, A2Im );
+    if ( maxBin == binNum )
+    {
+        return nan( "" );
+    }
+
+    const double threshold = fraction * hypot( A2Re[ maxBin ], A2Im[ maxBin ] );
+    unsigned     prevBin   = maxBin;
+    double       prevA2    = hypot( A2Re[ maxBin ], A2Im[ maxBin ] );
+    for ( auto i = maxBin + 1; i < binNum; ++i )
+    {
+        const double amplitude = hypot( A2Re[ i ], A2Im[ i ] );
+        if ( isnan( amplitude ) )
+        {
+            continue;
+        }
+        if ( amplitude < threshold )
+        {
+            return radii[ prevBin ]
+                   + ( radii[ i ] - radii[ prevBin ] ) * ( prevA2 - threshold )
+                         / ( prevA2 - amplitude );
+        }
+        prevBin = i;
+        prevA2  = amplitude;
+    }
+    return nan( "" );
+}
+
+/**
+ * @brief Estimate the bar length as the radius beyond the peak of the A2 profile, where the m=2
+ * phase deviates from the phase at the peak by more than deltaPhi. The radius is linearly
+ * interpolated between the two bins across the threshold, and the empty bins (nan) are skipped.
+ *
+ * @param binNum number of the radial bins
+ * @param radii radii of the bin centers, in ascending order
+ * @param A2Re real parts of the A2 profile
+ * @param A2Im imaginary parts of the A2 profile
+ * @param deltaPhi the maximal phase deviation of the bar, in degree
+ * @return the bar length, or nan if the phase never deviates more than deltaPhi
+ */
+auto bar_info::bar_length_phase( const unsigned binNum, const double* radii, const double* A2Re,
+                                 const double* A2Im, const double deltaPhi ) -> double
+{
+    const unsigned maxBin = a2_max_bin( binNum, A2Re, A2Im );
+    if ( maxBin == binNum )
+    {
+        return nan( "" );
+    }
+
+    // the phase deviation from the bar at the peak, in [0, pi/2]
+    const double threshold = deltaPhi * numbers::pi / 180;
+    const double barPhase  = atan2( A2Im[ maxBin ], A2Re[ maxBin ] ) / 2;
+    auto         deviation = [ barPhase ]( double re, double im ) -> double {
+        return abs( unwrap_bar_angle( barPhase, atan2( im, re ) / 2 ) - barPhase );
+    };
+
+    unsigned prevBin       = maxBin;
+    double   prevDeviation = 0;
+    for ( auto i = maxBin + 1; i < binNum; ++i )
+    {
+        if ( isnan( A2Re[ i ] ) or isnan( A2Im[ i ] ) )
+        {
+            continue;
+        }
+        const double curDeviation = deviation( A2Re[ i ], A2Im[ i ] );
+        if ( curDeviation > threshold )
+        {
+            return radii[ prevBin ]
+                   + ( radii[ i ] - radii[ prevBin ] ) * ( threshold - prevDeviation )
+                         / ( curDeviation - prevDeviation );
+        }
+        prevBin       = i;
+        prevDeviation = curDeviation;
+    }
+    return nan( "" );
+}
+
+/**
+ * @brief Calculate the Tremaine-Weinberg integrals of slits parallel to the line of nodes. For each
+ * viewing angle, the component is rotated around the z-axis such that its x-axis has the given
+ * angle with the line of nodes, then inclined around the line of nodes. In the sky plane, X is
+ * along the line of nodes and Y is perpendicular to it, and the slits are centered at
+ * Y = (k - (slitNum - 1) / 2) * slitWidth with |X| <= halfLength. The line-of-sight velocities are
+ * relative to the systemic velocity, which is the mass-weighted mean velocity of all particles, so
+ * the pattern speed is \sum m v_los / (\sum m X * sin(inclination)) of each slit, where X is
+ * relative to the (recentered) origin.
+ *
+ * @param partNum particle number
+ * @param masses masses of particles
+ * @param coordinates coordinates of particles
+ * @param velocities velocities of particles
+ * @param inclination inclination of the disk, in degree
+ * @param angleNum number of the viewing angles
+ * @param angles angles between the x-axis and the line of nodes, in degree
+ * @param slitNum number of slits
+ * @param slitWidth width of each slit
+ * @param halfLength half length of each slit
+ * @return the reduced integrals in shape (angleNum, slitNum, twQuantityNum), which are \sum m X,
+ * \sum m v_los and \sum m of the particles in each slit.
+ */
+auto bar_info::tw_integrals( const unsigned partNum, const double* masses,
+                             const double* coordinates, const double* velocities,
+                             const double inclination, const unsigned angleNum,
+                             const double* angles, const unsigned slitNum, const double slitWidth,
+                             const double halfLength ) -> unique_ptr< double[] >
+{
+    constexpr double degree = numbers::pi / 180;
+    const double     cosInc = cos( inclination * degree );
+    const double     sinInc = sin( inclination * degree );
+    vector< double > cosAngles( angleNum );
+    vector< double > sinAngles( angleNum );
+    for ( auto j = 0U; j < angleNum; ++j )
+    {
+        cosAngles[ j ] = cos( angles[ j ] * degree );
+        sinAngles[ j ] = sin( angles[ j ] * degree );
+    }
+
+    // the slits, followed by the total mass and momentum for the systemic velocity
+    const unsigned   totalNum = angleNum * slitNum * twQuantityNum;
+    const unsigned   valueNum = totalNum + 4;
+    vector< double > values( valueNum );
+
+    // all viewing angles are calculated in the same pass of the particles
+    const double offset = ( double )slitNum / 2;
+    parallel_bins::sum( partNum, valueNum, values.data(), [ & ]( double* sums, unsigned long i ) {
+        const double* pos = coordinates + 3 * i;
+        const double* vel = velocities + 3 * i;
+        double*       sys = sums + totalNum;
+        sys[ 0 ] += masses[ i ];
+        for ( auto k = 0; k < 3; ++k )
+        {
+            sys[ 1 + k ] += masses[ i ] * vel[ k ];
+        }
+        for ( auto j = 0U; j < angleNum; ++j )
+        {
+            // rotate around the z-axis, then incline around the line of nodes
+            const double skyX = pos[ 0 ] * cosAngles[ j ] - pos[ 1 ] * sinAngles[ j ];
+            const double skyY =
+                ( pos[ 0 ] * sinAngles[ j ] + pos[ 1 ] * cosAngles[ j ] ) * cosInc
+                - pos[ 2 ] * sinInc;
+            const double index = floor( skyY / slitWidth + offset );
+            if ( abs( skyX ) > halfLength or index < 0 or index >= slitNum )
+            {
+                continue;
+            }
+            const double vLos =
+                ( vel[ 0 ] * sinAngles[ j ] + vel[ 1 ] * cosAngles[ j ] ) * sinInc
+                + vel[ 2 ] * cosInc;
+
+            double* slit = sums + ( j * slitNum + ( unsigned )index ) * twQuantityNum;
+            slit[ 0 ] += masses[ i ] * skyX;
+            slit[ 1 ] += masses[ i ] * vLos;
+            slit[ 2 ] += masses[ i ];
+        }
+    } );
+
+    // a single reduction of all slits and angles, then remove the systemic velocity along each line
+    // of sight: \sum m (v_los - v_sys) = \sum m v_los - v_sys \sum m
+    MPI_Allreduce( MPI_IN_PLACE, values.data(), ( int )valueNum, MPI_DOUBLE, MPI_SUM,
+                   MPI_COMM_WORLD );
+    const double* sys           = values.data() + totalNum;
+    double        systemic[ 3 ] = { 0, 0, 0 };
+    for ( auto k = 0; sys[ 0 ] > 0 and k < 3; ++k )
+    {
+        systemic[ k ] = sys[ 1 + k ] / sys[ 0 ];
+    }
+    auto integrals( make_unique< double[] >( totalNum ) );
+    copy( values.begin(), values.begin() + totalNum, integrals.get() );
+    for ( auto j = 0U; j < angleNum; ++j )
     {
-        numeratorRe += masses[ i ] * zeds[ i ] * cos( 2 * phis[ i ] );
-        numeratorIm += masses[ i ] * zeds[ i ] * sin( 2 * phis[ i ] );
+        const double vSys =
+            ( systemic[ 0 ] * sinAngles[ j ] + systemic[ 1 ] * cosAngles[ j ] ) * sinInc
+            + systemic[ 2 ] * cosInc;
+        for ( auto k = 0U; k < slitNum; ++k )
+        {
+            double* slit = integrals.get() + ( j * slitNum + k ) * twQuantityNum;
+            slit[ 1 ] -= vSys * slit[ 2 ];
+        }
     }
-    MPI_Allreduce( MPI_IN_PLACE, &numeratorRe, 1, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD );
-    MPI_Allreduce( MPI_IN_PLACE, &numeratorIm, 1, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD );
-    return sqrt( numeratorRe * numeratorRe + numeratorIm * numeratorIm ) / A0value;
+    return integrals;
 }
 
 }  // namespace otf
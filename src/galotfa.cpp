@@ -1,6 +1,17 @@
 #include "../include/galotfa.h"
 #include "../include/monitor.hpp"
 
+/**
+ * @brief The on-the-fly analysis server, created at the first call of the APIs.
+ *
+ * @return reference to the server
+ */
+static auto Analysis_Server() -> otf::monitor&
+{
+    static otf::monitor otfServer( "./galotfa.toml" );  // create the on-the-fly analysis server
+    return otfServer;
+}
+
 /**
  * @brief API for n body simulation, without sub-grid physics parameters and redshifts.
  *
@@ -18,9 +29,25 @@ extern "C" void OnTheFly_Analysis_Nbody( const double currentTime, const unsigne
                                          const double* masses, const double* potentials,
                                          const double* coordinates, const double* velocities )
 {
-    static otf::monitor otfServer( "./galotfa.toml" );  // create the on-the-fly analysis server
-
     // call the analysis API
-    otfServer.main_analysis_api( currentTime, particleNumber, particleIDs, particleTypes, masses,
-                                 potentials, coordinates, velocities );
+    Analysis_Server().main_analysis_api( currentTime, particleNumber, particleIDs, particleTypes,
+                                         masses, potentials, coordinates, velocities );
+}
+
+/**
+ * @brief Similar to OnTheFly_Analysis_Nbody, with a hint whether the local particles were
+ * reordered since the last call.
+ *
+ * @param reordered non-zero if the local particles are known to be reordered (e.g. by a domain
+ * decomposition) since the last call, then the orbital log skips the check of the cached indexes
+ * of the logged particles and scans all local particles directly.
+ */
+extern "C" void OnTheFly_Analysis_Nbody_Reordered(
+    const double currentTime, const unsigned particleNumber, const int* particleIDs,
+    const int* particleTypes, const double* masses, const double* potentials,
+    const double* coordinates, const double* velocities, const int reordered )
+{
+    Analysis_Server().main_analysis_api( currentTime, particleNumber, particleIDs, particleTypes,
+                                         masses, potentials, coordinates, velocities,
+                                         reordered != 0 );
 }
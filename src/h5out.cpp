@@ -7,8 +7,12 @@
 #include <H5Ppublic.h>
 #include <H5Spublic.h>
 #include <H5public.h>
+#include <H5Tpublic.h>
 #include <algorithm>
+#include <chrono>
+#include <csignal>
 #include <cstdio>
+#include <cstring>
 #include <memory>
 #include <string>
 #include <sys/stat.h>
@@ -57,16 +61,91 @@ void Create_Dir_If_Necessary( const string& dir )
     }
 }
 
-h5_out::h5_out( const string& dir, const string& filename )
+// the organizers whose buffers are flushed when the program is interrupted
+static vector< h5_out* > livingOrganizers;
+
+// number of their datasets with buffered blocks, the handlers are installed only while positive
+static unsigned bufferedDatasets = 0;
+
+// the handled signals, and their previous handlers
+static constexpr int    flushSignals[] = { SIGINT, SIGTERM };
+static struct sigaction previousActions[ sizeof( flushSignals ) / sizeof( int ) ];
+
+/**
+ * @brief Restore the previous handlers of the handled signals.
+ */
+void Restore_Signal_Handlers()
+{
+    for ( auto i = 0U; i < sizeof( flushSignals ) / sizeof( int ); ++i )
+    {
+        sigaction( flushSignals[ i ], &previousActions[ i ], nullptr );
+    }
+}
+
+/**
+ * @brief Flush the buffers of the living organizers before the program is interrupted, then pass
+ * the signal to its previous handler. NOTE: the HDF5 calls are not async-signal-safe, so this is
+ * just a best effort to save the buffered logs.
+ *
+ * @param signal the received signal
+ */
+void Flush_On_Signal( int signal )
+{
+    Restore_Signal_Handlers();
+    for ( auto* organizer : livingOrganizers )
+    {
+        organizer->flush_all();
+    }
+    raise( signal );
+}
+
+/**
+ * @brief Install the signal handlers to flush the buffers at SIGINT and SIGTERM.
+ */
+void Install_Signal_Handlers()
+{
+    struct sigaction action;
+    memset( &action, 0, sizeof( action ) );
+    action.sa_handler = Flush_On_Signal;
+    sigemptyset( &action.sa_mask );
+    for ( auto i = 0U; i < sizeof( flushSignals ) / sizeof( int ); ++i )
+    {
+        sigaction( flushSignals[ i ], &action, &previousActions[ i ] );
+    }
+}
+
+/**
+ * @brief Create the hdf5 file of the logs.
+ *
+ * @param dir path of the output
+ * @param filename hdf5 filename of the logs
+ * @param bufferRows the buffered datasets are written after so many blocks are buffered
+ * @param bufferSeconds or at the next block after so many seconds since the last write, 0 for no
+ * time limit
+ * @param flushOnSignal whether write the buffers when the program is interrupted by SIGINT or
+ * SIGTERM
+ */
+h5_out::h5_out( const string& dir, const string& filename, const unsigned bufferRows,
+                const double bufferSeconds, const bool flushOnSignal )
+    : bufferRows( bufferRows ), bufferSeconds( bufferSeconds ), flushOnSignal( flushOnSignal )
 {
     Create_Dir_If_Necessary( dir );
     Backup_Old_Logs_If_Necessary( dir, filename );
     this->filename = dir + "/" + filename;
     this->file     = H5Fcreate( this->filename.c_str(), H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT );
+
+    if ( flushOnSignal )
+    {
+        livingOrganizers.push_back( this );
+    }
 }
 
 h5_out::~h5_out()
 {
+    livingOrganizers.erase( remove( livingOrganizers.begin(), livingOrganizers.end(), this ),
+                            livingOrganizers.end() );
+
+    // First: write the buffers and close the datasets
     datasetPtrs.clear();
 
     // Second: close the groups
@@ -89,11 +168,12 @@ h5_out::~h5_out()
  * @param sizeInEachDim the length of each dimension in the dataset, except the first extensible
  * one.
  * @param dataType
+ * @param buffered whether buffer the blocks in memory, recommended for the small blocks
  * @return
  */
 auto h5_out::create_dataset_in_group( const string& datasetName, const string& groupName,
                                       const vector< unsigned >& sizeInEachDim,
-                                      hid_t                     dataType ) -> int
+                                      hid_t dataType, const bool buffered ) -> int
 {
     // ensure the parent group exists
     int const returnCode = create_group_if_necessary( groupName );
@@ -113,7 +193,9 @@ auto h5_out::create_dataset_in_group( const string& datasetName, const string& g
         return -1;
     }
     unique_ptr< dataset_handle > ptrToHandle =
-        make_unique< dataset_handle >( groupId, datasetName, sizeInEachDim, dataType );
+        buffered ? make_unique< dataset_handle >( groupId, datasetName, sizeInEachDim, dataType,
+                                                  bufferRows, bufferSeconds, flushOnSignal )
+                 : make_unique< dataset_handle >( groupId, datasetName, sizeInEachDim, dataType );
     datasetPtrs[ groupId ][ datasetName ] = std::move( ptrToHandle );
 
     return 0;
@@ -168,9 +250,24 @@ auto h5_out::create_group_if_necessary( const string& groupName ) -> int
 }
 
 dataset_handle::dataset_handle( hid_t& parent, const string& datasetName,
-                                const vector< unsigned >& sizeInEachDim, hid_t& dataType )
-    : datasetName( datasetName ), dataType( dataType ), sizeInEachDim( sizeInEachDim )
+                                const vector< unsigned >& sizeInEachDim, hid_t& dataType,
+                                const unsigned bufferRows, const double bufferSeconds,
+                                const bool flushOnSignal )
+    : datasetName( datasetName ), dataType( dataType ), sizeInEachDim( sizeInEachDim ),
+      bufferRows( max( bufferRows, 1U ) ), bufferSeconds( bufferSeconds ),
+      flushOnSignal( flushOnSignal ), lastFlushTime( chrono::steady_clock::now() )
 {
+    // the memory buffer of blocks
+    blockBytes = H5Tget_size( dataType );
+    for ( const auto& size : sizeInEachDim )
+    {
+        blockBytes *= size;
+    }
+    if ( this->bufferRows > 1 )
+    {
+        buffer.resize( blockBytes * this->bufferRows );
+    }
+
     // set the chunk size and compression at here
     auto                          rank = ( int )sizeInEachDim.size() + 1;
     unique_ptr< hsize_t[] > const chunk( new hsize_t[ rank ]() );
@@ -184,7 +281,10 @@ dataset_handle::dataset_handle( hid_t& parent, const string& datasetName,
     {
         offset[ i ] = 0;
     }
-    chunk[ 0 ]   = CHUCK_SIZE;
+    // the large blocks share a chunk with less steps, so that a chunk is not too large
+    const unsigned long long rowsInLimit = MAX_CHUCK_BYTES / max( blockBytes, ( size_t )1 );
+    chunkRows    = max( 1ULL, min( ( unsigned long long )CHUCK_SIZE, rowsInLimit ) );
+    chunk[ 0 ]   = chunkRows;
     maxDims[ 0 ] = H5S_UNLIMITED;
 
     for ( auto i = 1; i < rank; ++i )
@@ -202,7 +302,14 @@ dataset_handle::dataset_handle( hid_t& parent, const string& datasetName,
         ERROR( "Failed to set chuck!" );
         return;
     }
-    // set compression
+    // set compression: the bytes are shuffled by their significance before the deflate, which
+    // groups the mostly constant high bytes of the numbers
+    status = H5Pset_shuffle( property );
+    if ( status < 0 )
+    {
+        ERROR( "Failed to set shuffle!" );
+        return;
+    }
     status = H5Pset_deflate( property, 6 );
     if ( status < 0 )
     {
@@ -253,8 +360,29 @@ auto h5_out::flush_single_block( const string& groupName, const string& datasetN
     return 0;
 }
 
+/**
+ * @brief Write the buffers of all datasets to the file, and flush the file.
+ *
+ * @return 0 if succeed
+ */
+auto h5_out::flush_all() -> int
+{
+    int returnCode = 0;
+    for ( auto& group : datasetPtrs )
+    {
+        for ( auto& dataset : group.second )
+        {
+            returnCode |= dataset.second->flush_buffer();
+        }
+    }
+    H5Fflush( file, H5F_SCOPE_GLOBAL );
+    return returnCode;
+}
+
 dataset_handle::~dataset_handle()
 {
+    flush_buffer();
+
     // remove the additional garbage values in the dataset
     fileSize[ 0 ]       = curIndex;
     herr_t const status = H5Dset_extent( dataset, fileSize.get() );
@@ -286,19 +414,24 @@ dataset_handle::~dataset_handle()
  */
 auto dataset_handle::flush_single_block( const void* dataBuffer ) -> int
 {
+    if ( bufferRows > 1 )
+    {
+        return buffer_single_block( dataBuffer );
+    }
+
     // static variables
     static herr_t status    = -1;
     static hid_t  fileSpace = H5I_INVALID_HID;
 
     // extend the dataspace at the begin or any time reach the end of a chuck
-    if ( curIndex % CHUCK_SIZE == 0 )
+    if ( curIndex % chunkRows == 0 )
     {
         // calculate the number of used chucks
         static unsigned long long chuckNum = 0;
-        chuckNum                           = curIndex / CHUCK_SIZE;
+        chuckNum                           = curIndex / chunkRows;
 
         // extend the file size
-        fileSize[ 0 ] = ( chuckNum + 1 ) * CHUCK_SIZE;
+        fileSize[ 0 ] = ( chuckNum + 1 ) * chunkRows;
         status        = H5Dextend( dataset, fileSize.get() );
         H5Dflush( dataset );
 
@@ -330,3 +463,80 @@ auto dataset_handle::flush_single_block( const void* dataBuffer ) -> int
 
     return 0;
 }
+
+/**
+ * @brief Copy a block to the memory buffer, and write the buffer to the file if it's full or it has
+ * not been written for a while. NOTE: the elapsed time is only checked here, so the buffer is not
+ * written by time until the next block arrives.
+ *
+ * @param dataBuffer pointer to the data buffer, which includes the data in a single-step.
+ * @return
+ */
+auto dataset_handle::buffer_single_block( const void* dataBuffer ) -> int
+{
+    memcpy( buffer.data() + bufferedNum * blockBytes, dataBuffer, blockBytes );
+    if ( bufferedNum++ == 0 and flushOnSignal and bufferedDatasets++ == 0 )
+    {
+        Install_Signal_Handlers();
+    }
+
+    const chrono::duration< double > sinceLastFlush = chrono::steady_clock::now() - lastFlushTime;
+    if ( bufferedNum == bufferRows
+         or ( bufferSeconds > 0 and sinceLastFlush.count() >= bufferSeconds ) )
+    {
+        return flush_buffer();
+    }
+    return 0;
+}
+
+/**
+ * @brief Write all the buffered blocks to the file, by a single hyperslab selection and write.
+ *
+ * @return
+ */
+auto dataset_handle::flush_buffer() -> int
+{
+    lastFlushTime = chrono::steady_clock::now();
+    if ( bufferedNum == 0 )
+    {
+        return 0;
+    }
+
+    // extend the dataset to hold exactly the written blocks
+    fileSize[ 0 ] = curIndex + bufferedNum;
+    herr_t status = H5Dset_extent( dataset, fileSize.get() );
+    if ( status < 0 )
+    {
+        ERROR( "Extention of the dataset [%s] failed, there may be no enough memory!",
+               datasetName.c_str() );
+        return -1;
+    }
+
+    // the buffered blocks in memory and their positions in the file
+    const auto rank         = ( int )sizeInEachDim.size() + 1;
+    countOfSingleBlock[ 0 ] = bufferedNum;
+    offset[ 0 ]             = curIndex;
+    hid_t const memorySpace = H5Screate_simple( rank, countOfSingleBlock.get(), nullptr );
+    hid_t const fileSpace   = H5Dget_space( dataset );
+    status = H5Sselect_hyperslab( fileSpace, H5S_SELECT_SET, offset.get(), nullptr,
+                                  countOfSingleBlock.get(), nullptr );
+    status = H5Dwrite( dataset, dataType, memorySpace, fileSpace, H5P_DEFAULT, buffer.data() );
+    H5Sclose( fileSpace );
+    H5Sclose( memorySpace );
+    countOfSingleBlock[ 0 ] = 1;
+
+    curIndex += bufferedNum;
+    bufferedNum = 0;
+    if ( flushOnSignal and --bufferedDatasets == 0 )
+    {
+        Restore_Signal_Handlers();
+    }
+
+    if ( status < 0 )
+    {
+        ERROR( "Dataset write failed!" );
+        return -1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,64 @@
+#include "../include/idset.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+using namespace std;
+
+namespace otf {
+
+/**
+ * @brief Build the set from an id list, the repeated ids are allowed.
+ *
+ * @param ids the id list
+ */
+id_set::id_set( const vector< int >& ids )
+{
+    if ( ids.empty() )
+    {
+        return;
+    }
+    const auto [ minIt, maxIt ] = minmax_element( ids.begin(), ids.end() );
+    minId                       = *minIt;
+    range                       = ( uint64_t )( ( int64_t )*maxIt - minId + 1 );
+
+    // dense bitmap over the range of ids
+    if ( range <= maxBitsPerId * ids.size() )
+    {
+        bitmap.assign( ( range + 63 ) / 64, 0 );
+        for ( const auto id : ids )
+        {
+            const auto offset = ( uint64_t )( ( int64_t )id - minId );
+            count += ( ( bitmap[ offset >> 6 ] >> ( offset & 63 ) ) & 1 ) == 0 ? 1 : 0;
+            bitmap[ offset >> 6 ] |= 1ULL << ( offset & 63 );
+        }
+        return;
+    }
+
+    // hash table with at least twice the slots of the ids
+    dense = false;
+    shift = 63;
+    while ( ( 1ULL << ( 64 - shift ) ) < 2 * ids.size() )
+    {
+        --shift;
+    }
+    mask = ( 1ULL << ( 64 - shift ) ) - 1;
+    table.assign( mask + 1, emptyKey );
+    for ( const auto id : ids )
+    {
+        if ( id == emptyKey )
+        {
+            count += hasEmptyKey ? 0 : 1;
+            hasEmptyKey = true;
+            continue;
+        }
+        auto slot = hash( id );
+        while ( table[ slot ] != emptyKey and table[ slot ] != id )
+        {
+            slot = ( slot + 1 ) & mask;
+        }
+        count += table[ slot ] == emptyKey ? 1 : 0;
+        table[ slot ] = id;
+    }
+}
+
+}  // namespace otf
@@ -4,14 +4,20 @@
 #include "../include/h5out.hpp"
 #include "../include/myprompt.hpp"
 #include "../include/para.hpp"
+#include "../include/parallel.hpp"
+#include "../include/radixsort.hpp"
 #include "../include/recenter.hpp"
 #include "../include/selector.hpp"
 #include "../include/statistic.hpp"
 #include <H5Tpublic.h>
 #include <algorithm>
 #include <cmath>
+#include <cstddef>
+#include <cstdint>
 #include <memory>
 #include <mpi.h>
+#include <numbers>
+#include <set>
 #include <string>
 #include <string_view>
 #include <utility>
@@ -37,6 +43,10 @@ void print_global_part( otf::runtime_para& para )
     }
     INFO( "Output to  [%s]/[%s]", para.outputDir.c_str(), para.fileName.c_str() );
     INFO( "Max iteration [%u], epsilon [%g]", para.maxIter, para.epsilon );
+    INFO( "Scalar logs are written every [%u] steps, or at the next step after [%g] seconds",
+          para.bufferRows, para.bufferTime );
+    INFO( "Flush the scalar logs at SIGINT or SIGTERM [%s]",
+          para.flushOnSignal ? "true" : "false" );
 }
 
 /**
@@ -74,7 +84,37 @@ void print_orbital_part( otf::runtime_para& para )
         ERROR( "Get into an unexpected branch!" );
     }
     INFO( "Random selection fraction: %g.", para.orbit->fraction );
+    INFO( "Random selection seed: %lu.", ( unsigned long )para.orbit->seed );
     INFO( "ID list filename : %s", para.orbit->idfile.c_str() );
+    switch ( para.orbit->idformat )
+    {
+    case otf::orbit::id_file_format::TEXT:
+        INFO( "ID list format: text." );
+        break;
+    case otf::orbit::id_file_format::INT32:
+        INFO( "ID list format: binary int32." );
+        break;
+    case otf::orbit::id_file_format::INT64:
+        INFO( "ID list format: binary int64." );
+        break;
+    case otf::orbit::id_file_format::HDF5:
+        INFO( "ID list format: dataset [%s] in an HDF5 file.", para.orbit->iddataset.c_str() );
+        break;
+    }
+    switch ( para.orbit->storage.mode )
+    {
+    case otf::orbit_storage_para::storage_mode::DOUBLE:
+        INFO( "Orbit storage: double." );
+        break;
+    case otf::orbit_storage_para::storage_mode::FLOAT:
+        INFO( "Orbit storage: float." );
+        break;
+    case otf::orbit_storage_para::storage_mode::QUANTIZED:
+        INFO( "Orbit storage: %u-bit quantized in box %g and velocity box %g, delta encoding: %s.",
+              para.orbit->storage.bits, para.orbit->storage.posBox, para.orbit->storage.velBox,
+              para.orbit->storage.delta ? "true" : "false" );
+        break;
+    }
 
     if ( para.orbit->recenter.enable )
     {
@@ -100,6 +140,31 @@ void print_orbital_part( otf::runtime_para& para )
     {
         INFO( "%d ", id );
     }
+    INFO( "Rotate the orbits to the principal axes of the anchors: %s.",
+          para.orbit->recenter.align ? "true" : "false" );
+    if ( para.orbit->recenter.align )
+    {
+        INFO( "Alignment radius of the anchors: %g", para.orbit->recenter.alignRadius );
+    }
+}
+
+/**
+ * @brief Name of the scale of radial bins.
+ *
+ * @param scale the bin scale
+ * @return the name
+ */
+auto scale_name( bin_scale scale ) -> const char*
+{
+    switch ( scale )
+    {
+    case bin_scale::LINEAR:
+        return "linear";
+    case bin_scale::LOG:
+        return "logarithmic";
+    default:
+        return "custom edges";
+    }
 }
 
 /**
@@ -157,6 +222,22 @@ void print_component_part( otf::runtime_para& para )
             INFO( "Image bin number: %d.", comp.second->image.binNum );
         }
 
+        if ( comp.second->kinematics.enable )
+        {
+            INFO( "Kinematic maps of [%s] is enabled.", comp.second->compName.c_str() );
+            INFO( "Kinematic maps half length: %g.", comp.second->kinematics.halfLength );
+            INFO( "Kinematic maps bin number: %u.", comp.second->kinematics.binNum );
+        }
+
+        if ( comp.second->grid.enable )
+        {
+            INFO( "3D grids of [%s] is enabled.", comp.second->compName.c_str() );
+            INFO( "3D grids half length: %g.", comp.second->grid.halfLength );
+            INFO( "3D grids bin number: %u.", comp.second->grid.binNum );
+            INFO( "3D grids period: %u.", comp.second->grid.period );
+            INFO( "3D grids of velocities: %s.", comp.second->grid.velocity ? "true" : "false" );
+        }
+
         if ( comp.second->sBar.enable )
         {
             INFO( "A2 of [%s] is enabled.", comp.second->compName.c_str() );
@@ -171,6 +252,27 @@ void print_component_part( otf::runtime_para& para )
             INFO( "barAngle rmax : %g.", comp.second->barAngle.rmax );
         }
 
+        if ( comp.second->patternSpeed.enable )
+        {
+            INFO( "Pattern speed of [%s] is enabled.", comp.second->compName.c_str() );
+            INFO( "Pattern speed fitting window : %u.", comp.second->patternSpeed.window );
+        }
+
+        if ( comp.second->TW.enable )
+        {
+            INFO( "Tremaine-Weinberg integrals of [%s] is enabled.",
+                  comp.second->compName.c_str() );
+            INFO( "TW inclination : %g.", comp.second->TW.inclination );
+            INFO( "TW viewing angles:" );
+            for ( auto& angle : comp.second->TW.angles )
+            {
+                INFO( "%g ", angle );
+            }
+            INFO( "TW slit number : %u.", comp.second->TW.slitNum );
+            INFO( "TW slit width : %g.", comp.second->TW.slitWidth );
+            INFO( "TW slit half length : %g.", comp.second->TW.halfLength );
+        }
+
         if ( comp.second->sBuckle.enable )
         {
             INFO( "buckle of [%s] is enabled.", comp.second->compName.c_str() );
@@ -184,6 +286,43 @@ void print_component_part( otf::runtime_para& para )
             INFO( "Radial A2 profile rmin : %g.", comp.second->A2profile.rmin );
             INFO( "Radial A2 profile rmax : %g.", comp.second->A2profile.rmax );
             INFO( "Radial A2 profile binnum : %u.", comp.second->A2profile.binNum );
+            INFO( "Radial A2 profile scale : %s.",
+                  scale_name( comp.second->A2profile.axis->get_scale() ) );
+        }
+
+        if ( comp.second->profile.enable )
+        {
+            INFO( "Radial profile of [%s] is enabled.", comp.second->compName.c_str() );
+            INFO( "Radial profile rmin : %g.", comp.second->profile.rmin );
+            INFO( "Radial profile rmax : %g.", comp.second->profile.rmax );
+            INFO( "Radial profile binnum : %u.", comp.second->profile.binNum );
+            INFO( "Radial profile scale : %s.",
+                  scale_name( comp.second->profile.axis->get_scale() ) );
+            if ( not comp.second->profile.percentiles.empty() )
+            {
+                INFO( "Radial profile velocity percentiles:" );
+                for ( auto& percentile : comp.second->profile.percentiles )
+                {
+                    INFO( "%g ", percentile );
+                }
+            }
+        }
+
+        if ( comp.second->lagrangian.enable )
+        {
+            INFO( "Lagrangian radii of [%s] is enabled.", comp.second->compName.c_str() );
+            INFO( "Lagrangian radii mass fractions:" );
+            for ( auto& fraction : comp.second->lagrangian.fractions )
+            {
+                INFO( "%g ", fraction );
+            }
+        }
+
+        if ( comp.second->barLength.enable )
+        {
+            INFO( "Bar length of [%s] is enabled.", comp.second->compName.c_str() );
+            INFO( "Bar length A2 fraction : %g.", comp.second->barLength.fraction );
+            INFO( "Bar length phase deviation : %g.", comp.second->barLength.deltaPhi );
         }
     }
 }
@@ -235,17 +374,58 @@ monitor::monitor( const string_view& tomlParaFile )
     // get the mpi size
     MPI_Comm_size( MPI_COMM_WORLD, &mpiSize );
 
+    // the accumulators are allocated once and reused in all analysis steps
+    for ( auto& comp : para.comps )
+    {
+        if ( comp.second->profile.enable )
+        {
+            profileAccumulators[ comp.second->compName ] =
+                make_unique< binned_accumulator >( *comp.second->profile.axis, profileMomentNum );
+        }
+        // 3 velocity components in each radial bin, and the spherical radii in the last bin
+        const unsigned long sketchNum =
+            ( comp.second->profile.percentiles.empty() ? 0 : 3 * comp.second->profile.binNum )
+            + ( comp.second->lagrangian.enable ? 1 : 0 );
+        if ( sketchNum > 0 )
+        {
+            quantileSketches[ comp.second->compName ] = make_unique< quantile_sketch >( sketchNum );
+        }
+        if ( comp.second->kinematics.enable )
+        {
+            const bin_axis axis( -comp.second->kinematics.halfLength,
+                                 comp.second->kinematics.halfLength,
+                                 comp.second->kinematics.binNum );
+            kinematicAccumulators[ comp.second->compName ] =
+                make_unique< binned_accumulator >( axis, axis, kinematicMomentNum );
+        }
+    }
+
     // read in the parameters
     MPI_INFO( mpiRank, "Read in parameter from %s", tomlParaFile.data() );
     if ( isRootRank )
     {
         print_para_info( para );
-        h5Organizer = make_unique< h5_out >( para.outputDir, para.fileName );
+        h5Organizer = make_unique< h5_out >( para.outputDir, para.fileName, para.bufferRows,
+                                             para.bufferTime, para.flushOnSignal );
     }
 }
 
 monitor::~monitor()
 {
+    // write the buffered logs
+    if ( h5Organizer != nullptr )
+    {
+        h5Organizer->flush_all();
+    }
+
+    // the derived datatype of the orbit records, if MPI is still available
+    int finalized = 0;
+    MPI_Finalized( &finalized );
+    if ( orbitPointType != MPI_DATATYPE_NULL and finalized == 0 )
+    {
+        MPI_Type_free( &orbitPointType );
+    }
+
     if ( mpiInitialzedByMonitor )
     {
         MPI_Finalize();
@@ -262,24 +442,22 @@ monitor::~monitor()
  * @param mass masses of particles
  * @param coordinate coordinates of particles
  * @param velocity velocities of particles
+ * @param reordered whether the local particles are known to be reordered (e.g. by a domain
+ * decomposition) since the last call, then the orbital log does not try the cached indexes of the
+ * logged particles
  */
 void monitor::main_analysis_api( const double time, const unsigned particleNumber, const int* ids,
                                  const int* partTypes, const double* masses,
                                  const double* potentials, const double* coordinates,
-                                 const double* velocities )
+                                 const double* velocities, const bool reordered )
 {
     if ( not para.enableOtf )
     {
         return;
     }
+    reorderedSinceLog = reorderedSinceLog or reordered;
 
-    // First: orbital logs part
-    if ( para.orbit->enable )
-    {
-        orbital_log( time, particleNumber, ids, partTypes, masses, coordinates, velocities );
-    }
-
-    // Second: analyze each component
+    // First: analyze each component
     // NOTE: analyze each component
     for ( auto& comp : para.comps )
     {
@@ -287,10 +465,96 @@ void monitor::main_analysis_api( const double time, const unsigned particleNumbe
                             velocities, comp.second );
     }
 
+    // Second: orbital logs part, after the components so that their centers can be reused
+    if ( para.orbit->enable )
+    {
+        orbital_log( time, particleNumber, ids, partTypes, masses, potentials, coordinates,
+                     velocities );
+    }
+
     // Last: increase the synchronized step counter
     stepCounter++;
 }
 
+/**
+ * @brief Get the frame of the orbits in the current log step. If a component with the same
+ * particle types as the anchors is recentered by the same method in this step, its center (and
+ * its rotation if it's aligned within the same radius) is reused, otherwise the anchor particles
+ * are recentered (and aligned) here.
+ *
+ * @param particleNumber number of particles in the local mpi rank
+ * @param partTypes PartTypes of particles
+ * @param masses masses of particles
+ * @param potentials potentials of particles
+ * @param coordinates coordinates of particles
+ */
+void monitor::orbit_frame( const unsigned particleNumber, const int* partTypes,
+                           const double* masses, const double* potentials,
+                           const double* coordinates )
+{
+    const auto& recenter = para.orbit->recenter;
+    const auto  anchors  = set< unsigned >( recenter.anchorIds.begin(), recenter.anchorIds.end() );
+    bool        reused   = false;
+    for ( auto& comp : para.comps )
+    {
+        const auto frame = compFrames.find( comp.first );
+        if ( frame == compFrames.end() or frame->second.step != ( long )stepCounter
+             or set< unsigned >( comp.second->types.begin(), comp.second->types.end() ) != anchors
+             or comp.second->recenter.method != recenter.method
+             or comp.second->recenter.radius != recenter.radius
+             or not equal( recenter.initialGuess, recenter.initialGuess + 3,
+                           comp.second->recenter.initialGuess ) )
+        {
+            continue;
+        }
+        orbitFrame         = frame->second;
+        orbitFrame.aligned = orbitFrame.aligned and recenter.align
+                             and comp.second->align.radius == recenter.alignRadius;
+        reused             = true;
+        break;
+    }
+    if ( reused and orbitFrame.aligned == recenter.align )
+    {
+        return;
+    }
+
+    // the anchor particles
+    vector< double > anchorMasses, anchorPotentials, anchorCoordinates;
+    for ( unsigned i = 0; i < particleNumber; ++i )
+    {
+        if ( anchors.contains( ( unsigned )partTypes[ i ] ) )
+        {
+            anchorMasses.push_back( masses[ i ] );
+            anchorPotentials.push_back( potentials[ i ] );
+            anchorCoordinates.insert( anchorCoordinates.end(), coordinates + 3 * i,
+                                      coordinates + 3 * i + 3 );
+        }
+    }
+    const auto anchorNum = ( unsigned )anchorMasses.size();
+
+    // recenter the anchor particles, if no component frame is reused
+    if ( not reused )
+    {
+        const auto center = iterative_center( recenter, anchorNum, anchorMasses.data(),
+                                              anchorPotentials.data(), anchorCoordinates.data() );
+        orbitFrame        = frameContainer();
+        orbitFrame.step   = stepCounter;
+        copy( center.get(), center.get() + 3, orbitFrame.center );
+    }
+
+    // align the anchor particles around the center
+    if ( recenter.align )
+    {
+        for ( auto i = 0UL; i < anchorCoordinates.size(); ++i )
+        {
+            anchorCoordinates[ i ] -= orbitFrame.center[ i % 3 ];
+        }
+        alignment_rotation( anchorNum, anchorMasses.data(), anchorCoordinates.data(),
+                            recenter.alignRadius, orbitFrame.rotation );
+        orbitFrame.aligned = true;
+    }
+}
+
 /**
  * @brief The API of orbital log.
  *
@@ -299,54 +563,157 @@ void monitor::main_analysis_api( const double time, const unsigned particleNumbe
  * @param particleID ids of particles
  * @param particleType PartTypes of particles
  * @param mass masses of particles
+ * @param potential potentials of particles
  * @param coordinate coordinates of particles
  * @param velocity velocities of particles
  */
 void monitor::orbital_log( const double time, const unsigned particleNumber, const int* ids,
-                           const int* partTypes, const double* masses, const double* coordinates,
-                           const double* velocities )
+                           const int* partTypes, const double* masses, const double* potentials,
+                           const double* coordinates, const double* velocities )
 {
     if ( stepCounter % para.orbit->period != 0 )  // only log in the chosen steps
     {
         return;
     }
 
+    // the frame of the orbits: centered on the anchor particles, and optionally rotated
+    if ( para.orbit->recenter.enable )
+    {
+        orbit_frame( particleNumber, partTypes, masses, potentials, coordinates );
+    }
+
     // First: extract the data for orbital log, and the data for each component
-    auto orbitData =
-        id_data_process( time, particleNumber, ids, partTypes, masses, coordinates, velocities );
-    // if it's the first extraction, create the datasets in the root rank
+    const auto& orbitData = id_data_process( particleNumber, ids, partTypes, masses, coordinates,
+                                             velocities, reorderedSinceLog );
+    reorderedSinceLog     = false;
+    const auto& storage   = para.orbit->storage;
+    using mode            = otf::orbit_storage_para::storage_mode;
+    // if it's the first extraction, create the datasets in the root rank: the ids of the logged
+    // particles, the times of the log steps, and the orbits of all particles in a single dataset
+    // of (time, particle, point)
     if ( isRootRank and stepCounter == 0 )
     {
         for ( auto& data : orbitData )
         {
-            // create the datasets of particles' orbit
-            const string datasetName = "Particle-" + to_string( data.particleID );
-            h5Organizer->create_dataset_in_group( datasetName, "Orbit", { orbitPointDim },
-                                                  H5T_NATIVE_DOUBLE );
-            // backup the dataset names
-            orbitDatasetNames.push_back( datasetName );
+            orbitIDs.push_back( data.particleID );
+        }
+        sort( orbitIDs.begin(), orbitIDs.end() );
+        for ( auto i = 0U; i < orbitIDs.size(); ++i )
+        {
+            orbitSlots[ orbitIDs[ i ] ] = i;
+        }
+        if ( not orbitIDs.empty() )
+        {
+            h5Organizer->create_dataset_in_group( "ParticleIDs", "Orbit",
+                                                  { ( unsigned )orbitIDs.size() }, H5T_NATIVE_INT );
+            h5Organizer->flush_single_block( "Orbit", "ParticleIDs", orbitIDs.data() );
+            h5Organizer->create_dataset_in_group( "Time", "Orbit", { 1 }, H5T_NATIVE_DOUBLE,
+                                                  true );
+            const hid_t orbitType = storage.mode == mode::DOUBLE  ? H5T_NATIVE_DOUBLE
+                                    : storage.mode == mode::FLOAT ? H5T_NATIVE_FLOAT
+                                                                  : H5T_NATIVE_INT32;
+            h5Organizer->create_dataset_in_group(
+                "Orbits", "Orbit", { ( unsigned )orbitIDs.size(), orbitPointDim }, orbitType );
+            // the units of the quantized values of each column
+            if ( storage.mode == mode::QUANTIZED )
+            {
+                const double levels = ( double )( ( 1U << ( storage.bits - 1 ) ) - 1 );
+                const double scales[ orbitPointDim ] = {
+                    storage.posBox / levels, storage.posBox / levels, storage.posBox / levels,
+                    storage.velBox / levels, storage.velBox / levels, storage.velBox / levels
+                };
+                h5Organizer->create_dataset_in_group( "QuantizeScales", "Orbit",
+                                                      { orbitPointDim }, H5T_NATIVE_DOUBLE );
+                h5Organizer->flush_single_block( "Orbit", "QuantizeScales", scales );
+                orbitLastQuant.assign( orbitIDs.size() * orbitPointDim, 0 );
+            }
         }
     }
 
-    // Second: log the orbits in the root rank
-    if ( isRootRank )
+    // Second: log the orbits in the root rank, as a single block of the dataset
+    if ( isRootRank and not orbitIDs.empty() )
     {
-        for ( auto i = 0UL; i < orbitDatasetNames.size(); ++i )
+        // place the records by their ids, the particles not found in this step are left as nan
+        orbitBlock.assign( orbitIDs.size() * orbitPointDim, nan( "" ) );
+        for ( const auto& point : orbitData )
         {
-#ifdef DEBUG
-            auto returnCode = h5Organizer->flush_single_block( "Orbit", orbitDatasetNames[ i ],
-                                                               orbitData[ i ].data );
-            if ( returnCode != 0 )
+            const auto slot = orbitSlots.find( point.particleID );
+            if ( slot != orbitSlots.end() )
+            {
+                copy( point.data, point.data + orbitPointDim,
+                      orbitBlock.data() + slot->second * orbitPointDim );
+            }
+        }
+        const void* block = orbitBlock.data();
+        if ( storage.mode == mode::FLOAT )
+        {
+            orbitFloatBlock.assign( orbitBlock.begin(), orbitBlock.end() );
+            block = orbitFloatBlock.data();
+        }
+        else if ( storage.mode == mode::QUANTIZED )
+        {
+            const auto clamped = quantize_orbits();
+            if ( clamped > 0 )
             {
-                ERROR( "The dataset [Orbit/%s] written faild!", orbitDatasetNames[ i ].c_str() );
-                throw;
+                WARN( "%lu values of the orbits are out of the quantization box at time [%lf].",
+                      clamped, time );
             }
+            block = orbitQuantBlock.data();
+        }
+        h5Organizer->flush_single_block( "Orbit", "Time", &time );
+#ifdef DEBUG
+        auto returnCode = h5Organizer->flush_single_block( "Orbit", "Orbits", block );
+        if ( returnCode != 0 )
+        {
+            ERROR( "The dataset [Orbit/Orbits] written faild!" );
+            throw;
+        }
 #else
-            h5Organizer->flush_single_block( "Orbit", orbitDatasetNames[ i ].c_str(),
-                                             orbitData[ i ].data );
+        h5Organizer->flush_single_block( "Orbit", "Orbits", block );
 #endif
+    }
+}
+
+/**
+ * @brief Quantize the orbit block to the fixed-point integers: each value is rounded to the
+ * nearest multiple of box / (2^(bits-1) - 1), after it's clamped into [-box, box]. With the delta
+ * encoding, the difference from the last quantized value of the same particle is stored instead,
+ * so the values are recovered by the cumulative sum along the time, skipping the missing ones.
+ * The small differences of the smooth orbits are mostly zero bytes, which are well compressed
+ * with the shuffle filter.
+ *
+ * @return number of the values clamped into the box
+ */
+auto monitor::quantize_orbits() -> unsigned long
+{
+    const auto&   storage = para.orbit->storage;
+    const double  levels  = ( double )( ( 1U << ( storage.bits - 1 ) ) - 1 );
+    unsigned long clamped = 0;
+    orbitQuantBlock.resize( orbitBlock.size() );
+    for ( auto i = 0UL; i < orbitBlock.size(); ++i )
+    {
+        const double value = orbitBlock[ i ];
+        if ( isnan( value ) )
+        {
+            orbitQuantBlock[ i ] = orbitMissing;
+            continue;
+        }
+        const double box   = i % orbitPointDim < 3 ? storage.posBox : storage.velBox;
+        const double level = value / box * levels;
+        clamped += fabs( level ) > levels ? 1 : 0;
+        const auto quantized = ( int32_t )lround( max( -levels, min( levels, level ) ) );
+        if ( storage.delta )
+        {
+            // at most 2^31 - 2 in magnitude, never the sentinel
+            orbitQuantBlock[ i ] = quantized - orbitLastQuant[ i ];
+            orbitLastQuant[ i ]  = quantized;
+        }
+        else
+        {
+            orbitQuantBlock[ i ] = quantized;
         }
     }
+    return clamped;
 }
 
 /**
@@ -454,6 +821,14 @@ auto monitor::component_data_analyze( monitor::compDataContainer&        dataCon
         recenter_coordinate( dataContainer, comp, compRes );
     }
 
+    // NOTE: sort the particles by their radii if necessary, only once: after the alignment if
+    // it's enabled, as the rotation changes the cylindrical radii, so the bar info and the
+    // alignment itself scan the unsorted particles then
+    if ( comp->radSort.enable and not comp->align.enable )
+    {
+        sort_by_radius( dataContainer );
+    }
+
     // NOTE: calculate the bar info if necessary: Sbar, Sbuckle, bar angle and
     if ( comp->sBar.enable or comp->barAngle.enable or comp->sBuckle.enable )
     {
@@ -463,7 +838,11 @@ auto monitor::component_data_analyze( monitor::compDataContainer&        dataCon
     // NOTE: align the system if necessary
     if ( comp->align.enable )
     {
-        align_coordinate( dataContainer, comp );
+        align_coordinate( dataContainer, comp, compRes );
+        if ( comp->radSort.enable )
+        {
+            sort_by_radius( dataContainer );
+        }
     }
 
     // NOTE: calculate the image if necessary
@@ -472,15 +851,70 @@ auto monitor::component_data_analyze( monitor::compDataContainer&        dataCon
         image( dataContainer, comp, compRes );
     }
 
+    // NOTE: calculate the kinematic maps
+    if ( comp->kinematics.enable )
+    {
+        kinematic_maps( dataContainer, comp, compRes );
+    }
+
+    // NOTE: calculate the 3D grids in their own period
+    if ( comp->grid.enable and ( stepCounter / comp->period ) % comp->grid.period == 0 )
+    {
+        voxel_grid( dataContainer, comp, compRes );
+    }
+
     // NOTE: calculate the radial A2 profile
     if ( comp->A2profile.enable )
     {
         a2_profile( dataContainer, comp, compRes );
     }
 
+    // NOTE: calculate the radial profile
+    if ( comp->profile.enable )
+    {
+        radial_profile( dataContainer, comp, compRes );
+    }
+
+    // NOTE: calculate the velocity percentiles and the Lagrangian radii
+    if ( quantileSketches.contains( comp->compName ) )
+    {
+        quantile_profiles( dataContainer, comp, compRes );
+    }
+
+    // NOTE: calculate the Tremaine-Weinberg integrals
+    if ( comp->TW.enable )
+    {
+        tw_integrals( dataContainer, comp, compRes );
+    }
+
     return compRes;
 }
 
+/**
+ * @brief Get the center of a system iteratively, with the enclosed radius of 100, 50, 10, 1 and 0.5
+ * times of the given radius, starting from the initial guess.
+ *
+ * @param recenter parameters of the recenter
+ * @param partNum number of particles in the local mpi rank
+ * @param masses masses of particles
+ * @param potentials potentials of particles
+ * @param coordinates coordinates of particles
+ * @return the center of the system
+ */
+auto monitor::iterative_center( const recenter_para& recenter, const unsigned partNum,
+                                const double* masses, const double* potentials,
+                                const double* coordinates ) -> unique_ptr< double[] >
+{
+    auto center = recenter::get_center( recenter.method, partNum, masses, potentials, coordinates,
+                                        recenter.radius * 100, recenter.initialGuess );
+    for ( const double factor : { 50.0, 10.0, 1.0, 0.5 } )
+    {
+        center = recenter::get_center( recenter.method, partNum, masses, potentials, coordinates,
+                                       recenter.radius * factor, center.get() );
+    }
+    return center;
+}
+
 /**
  * @brief The API to recenter the coordinates in a data container object.
  *
@@ -497,31 +931,9 @@ void monitor::recenter_coordinate( monitor::compDataContainer&        dataContai
     recenter.method = "com"
     */
 
-    // get the system center based on the inital guess: 100 times enclosed radius
-    auto center = recenter::get_center( comp->recenter.method, dataContainer.partNum,
-                                        dataContainer.masses.get(), dataContainer.potentials.get(),
-                                        dataContainer.coordinates.get(),
-                                        comp->recenter.radius * 100, comp->recenter.initialGuess );
-    // get the system center based on the previous result: 50 times enclosed radius
-    center = recenter::get_center( comp->recenter.method, dataContainer.partNum,
-                                   dataContainer.masses.get(), dataContainer.potentials.get(),
-                                   dataContainer.coordinates.get(), comp->recenter.radius * 50,
-                                   center.get() );
-    // get the system center based on the previous result: 10 times enclosed radius
-    center = recenter::get_center( comp->recenter.method, dataContainer.partNum,
-                                   dataContainer.masses.get(), dataContainer.potentials.get(),
-                                   dataContainer.coordinates.get(), comp->recenter.radius * 10,
-                                   center.get() );
-    // get the system center based on the previous result: 1 times enclosed radius
-    center = recenter::get_center( comp->recenter.method, dataContainer.partNum,
-                                   dataContainer.masses.get(), dataContainer.potentials.get(),
-                                   dataContainer.coordinates.get(), comp->recenter.radius,
-                                   center.get() );
-    // get the system center based on the previous result: 0.5 times enclosed radius
-    center = recenter::get_center( comp->recenter.method, dataContainer.partNum,
-                                   dataContainer.masses.get(), dataContainer.potentials.get(),
-                                   dataContainer.coordinates.get(), comp->recenter.radius * 0.5,
-                                   center.get() );
+    const auto center =
+        iterative_center( comp->recenter, dataContainer.partNum, dataContainer.masses.get(),
+                          dataContainer.potentials.get(), dataContainer.coordinates.get() );
     // restore the position of the center
     for ( auto i = 0; i < 3; ++i )
     {
@@ -539,63 +951,112 @@ void monitor::recenter_coordinate( monitor::compDataContainer&        dataContai
 }
 
 /**
- * @brief The API to align the coordinates in a data container object.
+ * @brief Sort the particles in a data container object by their cylindrical radii, and cache the
+ * radii and azimuthal angles. After the sorting, any radial range of particles is a contiguous
+ * slice of the data arrays, see monitor::radial_slice.
  *
- * @param dataContainer reference to the data container
- * @param comp wrapper of parameters for analysis of a single component
+ * @param dataContainer reference to the data container to be sorted
  */
-void monitor::align_coordinate( monitor::compDataContainer&        dataContainer,
-                                std::unique_ptr< otf::component >& comp )
+void monitor::sort_by_radius( monitor::compDataContainer& dataContainer )
+{
+    const unsigned partNum = dataContainer.partNum;
+    auto           radii( make_unique< double[] >( partNum ) );
+    for ( unsigned i = 0; i < partNum; ++i )
+    {
+        radii[ i ] = sqrt(
+            dataContainer.coordinates[ 3 * i + 0 ] * dataContainer.coordinates[ 3 * i + 0 ]
+            + dataContainer.coordinates[ 3 * i + 1 ] * dataContainer.coordinates[ 3 * i + 1 ] );
+    }
+    auto order = radix_sort::argsort( radii.get(), partNum );
+
+    // permute the data into the sorted order
+    auto sortedRadii( make_unique< double[] >( partNum ) );
+    auto sortedPhis( make_unique< double[] >( partNum ) );
+    auto sortedMasses( make_unique< double[] >( partNum ) );
+    auto sortedPotentials( make_unique< double[] >( partNum ) );
+    auto sortedCoordinates( make_unique< double[] >( partNum * 3 ) );
+    auto sortedVelocities( make_unique< double[] >( partNum * 3 ) );
+    for ( unsigned i = 0; i < partNum; ++i )
+    {
+        const unsigned j      = order[ i ];
+        sortedRadii[ i ]      = radii[ j ];
+        sortedMasses[ i ]     = dataContainer.masses[ j ];
+        sortedPotentials[ i ] = dataContainer.potentials[ j ];
+        for ( unsigned k = 0; k < 3; ++k )
+        {
+            sortedCoordinates[ 3 * i + k ] = dataContainer.coordinates[ 3 * j + k ];
+            sortedVelocities[ 3 * i + k ]  = dataContainer.velocities[ 3 * j + k ];
+        }
+        sortedPhis[ i ] = atan2( sortedCoordinates[ 3 * i + 1 ], sortedCoordinates[ 3 * i + 0 ] );
+    }
+
+    dataContainer.radii          = std::move( sortedRadii );
+    dataContainer.phis           = std::move( sortedPhis );
+    dataContainer.masses         = std::move( sortedMasses );
+    dataContainer.potentials     = std::move( sortedPotentials );
+    dataContainer.coordinates    = std::move( sortedCoordinates );
+    dataContainer.velocities     = std::move( sortedVelocities );
+    dataContainer.sortedByRadius = true;
+}
+
+/**
+ * @brief Get the index range of the particles in a radial range by binary search, which requires
+ * the particles have been sorted by monitor::sort_by_radius.
+ *
+ * @param dataContainer reference to the sorted data container
+ * @param rmin the lower inclusive limit of the radial range
+ * @param rmax the upper limit of the radial range
+ * @param closedUpper whether the upper limit is inclusive
+ * @return the pair of [first, last) indexes of the particles in the range
+ */
+auto monitor::radial_slice( const monitor::compDataContainer& dataContainer, const double rmin,
+                            const double rmax,
+                            const bool   closedUpper ) -> pair< unsigned, unsigned >
+{
+    const double* begin = dataContainer.radii.get();
+    const double* end   = begin + dataContainer.partNum;
+    const double* first = lower_bound( begin, end, rmin );
+    const double* last =
+        closedUpper ? upper_bound( first, end, rmax ) : lower_bound( first, end, rmax );
+    return { unsigned( first - begin ), unsigned( last - begin ) };
+}
+
+/**
+ * @brief The rotation matrix to the principal axes of the inertia tensor of the particles within a
+ * spherical radius, where the inertia tensor is reduced from all mpi ranks.
+ *
+ * @param partNum number of the particles to be checked in the local mpi rank
+ * @param masses masses of the particles
+ * @param coordinates coordinates of the particles, relative to the center
+ * @param radius the enclosed radius
+ * @param rotation the row-major rotation matrix, which is the transpose of the eigenvectors
+ */
+void monitor::alignment_rotation( const unsigned partNum, const double* masses,
+                                  const double* coordinates, const double radius,
+                                  double* rotation )
 {
     // get the intertia tensor
     double inertiaTensor[ 9 ] = { 0, 0, 0, 0, 0, 0, 0, 0, 0 };
-    for ( unsigned i = 0; i < dataContainer.partNum; ++i )
+    for ( unsigned i = 0; i < partNum; ++i )
     {
-        // get the spherical radius of the particle
-        static double radius;
-        radius = sqrt(
-            dataContainer.coordinates[ i * 3 + 0 ] * dataContainer.coordinates[ i * 3 + 0 ]
-            + dataContainer.coordinates[ i * 3 + 1 ] * dataContainer.coordinates[ i * 3 + 1 ]
-            + dataContainer.coordinates[ i * 3 + 2 ] * dataContainer.coordinates[ i * 3 + 2 ] );
-
+        const double* pos = coordinates + i * 3;
         // check whether the particle locates in the enclosed radius
-        if ( comp->align.radius < radius )
+        if ( radius < sqrt( pos[ 0 ] * pos[ 0 ] + pos[ 1 ] * pos[ 1 ] + pos[ 2 ] * pos[ 2 ] ) )
         {
             continue;
         }
 
         // diagonal terms
-        inertiaTensor[ 0 * 3 + 0 ] +=
-            dataContainer.masses[ i ]
-            * ( dataContainer.coordinates[ i * 3 + 1 ] * dataContainer.coordinates[ i * 3 + 1 ]
-                + dataContainer.coordinates[ i * 3 + 2 ] * dataContainer.coordinates[ i * 3 + 2 ] );
-        inertiaTensor[ 1 * 3 + 1 ] +=
-            dataContainer.masses[ i ]
-            * ( dataContainer.coordinates[ i * 3 + 0 ] * dataContainer.coordinates[ i * 3 + 0 ]
-                + dataContainer.coordinates[ i * 3 + 2 ] * dataContainer.coordinates[ i * 3 + 2 ] );
-        inertiaTensor[ 2 * 3 + 2 ] +=
-            dataContainer.masses[ i ]
-            * ( dataContainer.coordinates[ i * 3 + 0 ] * dataContainer.coordinates[ i * 3 + 0 ]
-                + dataContainer.coordinates[ i * 3 + 1 ] * dataContainer.coordinates[ i * 3 + 1 ] );
+        inertiaTensor[ 0 * 3 + 0 ] += masses[ i ] * ( pos[ 1 ] * pos[ 1 ] + pos[ 2 ] * pos[ 2 ] );
+        inertiaTensor[ 1 * 3 + 1 ] += masses[ i ] * ( pos[ 0 ] * pos[ 0 ] + pos[ 2 ] * pos[ 2 ] );
+        inertiaTensor[ 2 * 3 + 2 ] += masses[ i ] * ( pos[ 0 ] * pos[ 0 ] + pos[ 1 ] * pos[ 1 ] );
         // non-diagonal terms
-        inertiaTensor[ 0 * 3 + 1 ] += -dataContainer.masses[ i ]
-                                      * dataContainer.coordinates[ i * 3 + 0 ]
-                                      * dataContainer.coordinates[ i * 3 + 1 ];
-        inertiaTensor[ 0 * 3 + 2 ] += -dataContainer.masses[ i ]
-                                      * dataContainer.coordinates[ i * 3 + 0 ]
-                                      * dataContainer.coordinates[ i * 3 + 2 ];
-        inertiaTensor[ 1 * 3 + 0 ] += -dataContainer.masses[ i ]
-                                      * dataContainer.coordinates[ i * 3 + 1 ]
-                                      * dataContainer.coordinates[ i * 3 + 0 ];
-        inertiaTensor[ 1 * 3 + 2 ] += -dataContainer.masses[ i ]
-                                      * dataContainer.coordinates[ i * 3 + 1 ]
-                                      * dataContainer.coordinates[ i * 3 + 2 ];
-        inertiaTensor[ 2 * 3 + 0 ] += -dataContainer.masses[ i ]
-                                      * dataContainer.coordinates[ i * 3 + 2 ]
-                                      * dataContainer.coordinates[ i * 3 + 0 ];
-        inertiaTensor[ 2 * 3 + 1 ] += -dataContainer.masses[ i ]
-                                      * dataContainer.coordinates[ i * 3 + 2 ]
-                                      * dataContainer.coordinates[ i * 3 + 1 ];
+        inertiaTensor[ 0 * 3 + 1 ] += -masses[ i ] * pos[ 0 ] * pos[ 1 ];
+        inertiaTensor[ 0 * 3 + 2 ] += -masses[ i ] * pos[ 0 ] * pos[ 2 ];
+        inertiaTensor[ 1 * 3 + 0 ] += -masses[ i ] * pos[ 1 ] * pos[ 0 ];
+        inertiaTensor[ 1 * 3 + 2 ] += -masses[ i ] * pos[ 1 ] * pos[ 2 ];
+        inertiaTensor[ 2 * 3 + 0 ] += -masses[ i ] * pos[ 2 ] * pos[ 0 ];
+        inertiaTensor[ 2 * 3 + 1 ] += -masses[ i ] * pos[ 2 ] * pos[ 1 ];
     }
     // reduce the inertiaTensor from all mpi ranks
     MPI_Allreduce( MPI_IN_PLACE, inertiaTensor, 9, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD );
@@ -624,34 +1085,50 @@ void monitor::align_coordinate( monitor::compDataContainer&        dataContainer
         eigenVectors[ 8 ] *= -1;
     }
     // NOTE: rotation matrix is Transpose(EigenMatrix) x Identity
+    for ( int i = 0; i < 3; ++i )
+    {
+        for ( int j = 0; j < 3; ++j )
+        {
+            rotation[ i * 3 + j ] = eigenVectors[ j * 3 + i ];
+        }
+    }
+}
+
+/**
+ * @brief The API to align the coordinates in a data container object.
+ *
+ * @param dataContainer reference to the data container
+ * @param comp wrapper of parameters for analysis of a single component
+ */
+void monitor::align_coordinate( monitor::compDataContainer&        dataContainer,
+                                std::unique_ptr< otf::component >& comp, compResContainer& res )
+{
+    // the particles are never sorted by radius here, as they are only sorted after the alignment
+    alignment_rotation( dataContainer.partNum, dataContainer.masses.get(),
+                        dataContainer.coordinates.get(), comp->align.radius, res.rotation );
 
     // rotate the coordinates and velocities
-    static double x = 0;
-    static double y = 0;
-    static double z = 0;
+    const double* rot = res.rotation;
+    static double x   = 0;
+    static double y   = 0;
+    static double z   = 0;
     for ( unsigned i = 0; i < dataContainer.partNum; ++i )
     {
         // coordinates
         x = dataContainer.coordinates[ i * 3 + 0 ];
         y = dataContainer.coordinates[ i * 3 + 1 ];
         z = dataContainer.coordinates[ i * 3 + 2 ];
-        dataContainer.coordinates[ i * 3 + 0 ] =
-            eigenVectors[ 0 ] * x + eigenVectors[ 3 ] * y + eigenVectors[ 6 ] * z;
-        dataContainer.coordinates[ i * 3 + 1 ] =
-            eigenVectors[ 1 ] * x + eigenVectors[ 4 ] * y + eigenVectors[ 7 ] * z;
-        dataContainer.coordinates[ i * 3 + 2 ] =
-            eigenVectors[ 2 ] * x + eigenVectors[ 5 ] * y + eigenVectors[ 8 ] * z;
+        dataContainer.coordinates[ i * 3 + 0 ] = rot[ 0 ] * x + rot[ 1 ] * y + rot[ 2 ] * z;
+        dataContainer.coordinates[ i * 3 + 1 ] = rot[ 3 ] * x + rot[ 4 ] * y + rot[ 5 ] * z;
+        dataContainer.coordinates[ i * 3 + 2 ] = rot[ 6 ] * x + rot[ 7 ] * y + rot[ 8 ] * z;
 
         // velocities
         x = dataContainer.velocities[ i * 3 + 0 ];
         y = dataContainer.velocities[ i * 3 + 1 ];
         z = dataContainer.velocities[ i * 3 + 2 ];
-        dataContainer.velocities[ i * 3 + 0 ] =
-            eigenVectors[ 0 ] * x + eigenVectors[ 3 ] * y + eigenVectors[ 6 ] * z;
-        dataContainer.velocities[ i * 3 + 1 ] =
-            eigenVectors[ 1 ] * x + eigenVectors[ 4 ] * y + eigenVectors[ 7 ] * z;
-        dataContainer.velocities[ i * 3 + 2 ] =
-            eigenVectors[ 2 ] * x + eigenVectors[ 5 ] * y + eigenVectors[ 8 ] * z;
+        dataContainer.velocities[ i * 3 + 0 ] = rot[ 0 ] * x + rot[ 1 ] * y + rot[ 2 ] * z;
+        dataContainer.velocities[ i * 3 + 1 ] = rot[ 3 ] * x + rot[ 4 ] * y + rot[ 5 ] * z;
+        dataContainer.velocities[ i * 3 + 2 ] = rot[ 6 ] * x + rot[ 7 ] * y + rot[ 8 ] * z;
     }
     // TODO: test the rotation part
 }
@@ -666,6 +1143,12 @@ void monitor::align_coordinate( monitor::compDataContainer&        dataContainer
 void monitor::bar_info( monitor::compDataContainer&        dataContainer,
                         std::unique_ptr< otf::component >& comp, compResContainer& res )
 {
+    if ( dataContainer.sortedByRadius )
+    {
+        bar_info_sorted( dataContainer, comp, res );
+        return;
+    }
+
     // NOTE: bar angle
     if ( comp->barAngle.enable )
     {
@@ -716,7 +1199,7 @@ void monitor::bar_info( monitor::compDataContainer&        dataContainer,
                 + dataContainer.coordinates[ 3 * i + 1 ] * dataContainer.coordinates[ 3 * i + 1 ] );
 
             // if the particle not in the specified region, go to the next loop
-            if ( radius < comp->barAngle.rmin or radius > comp->barAngle.rmax )
+            if ( radius < comp->sBar.rmin or radius > comp->sBar.rmax )
             {
                 continue;
             }
@@ -750,7 +1233,7 @@ void monitor::bar_info( monitor::compDataContainer&        dataContainer,
                 + dataContainer.coordinates[ 3 * i + 1 ] * dataContainer.coordinates[ 3 * i + 1 ] );
 
             // if the particle not in the specified region, go to the next loop
-            if ( radius < comp->barAngle.rmin or radius > comp->barAngle.rmax )
+            if ( radius < comp->sBuckle.rmin or radius > comp->sBuckle.rmax )
             {
                 continue;
             }
@@ -768,81 +1251,434 @@ void monitor::bar_info( monitor::compDataContainer&        dataContainer,
 }
 
 /**
- * @brief API to calculate the radial A2 profile.
+ * @brief Similar to monitor::bar_info, but for the data sorted by radii: each radial range is a
+ * contiguous slice of the cached masses and azimuthal angles, so no filter-copy is needed.
+ *
+ * @param dataContainer container of the extracted data, sorted by radii
+ * @param comp parameters of the component analysis
+ * @param res container of the analysis results
+ */
+void monitor::bar_info_sorted( monitor::compDataContainer&        dataContainer,
+                               std::unique_ptr< otf::component >& comp, compResContainer& res )
+{
+    if ( comp->barAngle.enable )
+    {
+        auto [ first, last ] =
+            radial_slice( dataContainer, comp->barAngle.rmin, comp->barAngle.rmax, true );
+        res.barAngle = bar_info::bar_angle( last - first, dataContainer.masses.get() + first,
+                                            dataContainer.phis.get() + first );
+    }
+
+    if ( comp->sBar.enable )
+    {
+        auto [ first, last ] =
+            radial_slice( dataContainer, comp->sBar.rmin, comp->sBar.rmax, true );
+        double const A0 = bar_info::A0( last - first, dataContainer.masses.get() + first );
+        double const A2 = bar_info::A2( last - first, dataContainer.masses.get() + first,
+                                        dataContainer.phis.get() + first );
+        res.sBar        = A2 / A0;
+    }
+
+    if ( comp->sBuckle.enable )
+    {
+        auto [ first, last ] =
+            radial_slice( dataContainer, comp->sBuckle.rmin, comp->sBuckle.rmax, true );
+        // the z coordinates are strided in the coordinates array
+        unique_ptr< double[] > const usedZeds( new double[ last - first ] );
+        for ( unsigned i = first; i < last; ++i )
+        {
+            usedZeds[ i - first ] = dataContainer.coordinates[ 3 * i + 2 ];
+        }
+        res.sBuckle = bar_info::Sbuckle( last - first, dataContainer.masses.get() + first,
+                                         dataContainer.phis.get() + first, usedZeds.get() );
+    }
+}
+
+/**
+ * @brief Update the history of the bar angle with the current one, and calculate the pattern speed
+ * by a linear fit of the unwrapped bar angles in the recent window. The result is nan until there
+ * are at least 2 points in the window. Only called in the root rank.
+ *
+ * @param time time of the simulation
+ * @param comp parameters of the component analysis
+ * @param res container of the analysis results, where the bar angle is already calculated
+ */
+void monitor::pattern_speed( const double time, std::unique_ptr< otf::component >& comp,
+                             compResContainer& res )
+{
+    auto& state = compStates[ comp->compName ];
+    if ( state.barPhases.empty() )
+    {
+        state.barPhases.push_back( res.barAngle );
+    }
+    else
+    {
+        state.barPhases.push_back(
+            bar_info::unwrap_bar_angle( state.barPhases.back(), res.barAngle ) );
+    }
+    state.barTimes.push_back( time );
+
+    // only keep the points in the fitting window
+    while ( state.barTimes.size() > comp->patternSpeed.window )
+    {
+        state.barTimes.pop_front();
+        state.barPhases.pop_front();
+    }
+
+    const vector< double > times( state.barTimes.begin(), state.barTimes.end() );
+    const vector< double > phases( state.barPhases.begin(), state.barPhases.end() );
+    res.patternSpeed =
+        bar_info::pattern_speed( ( unsigned )times.size(), times.data(), phases.data() );
+}
+
+/**
+ * @brief API to calculate the radial profile of several quantities, the moments of all quantities
+ * are accumulated in a single pass and reduced in a single reduction. The velocity moments are
+ * weighted by the particle masses.
  *
  * @param dataContainer container of the extracted data
  * @param comp parameters of the component analysis
  * @param res container of the analysis results
  */
-void monitor::a2_profile( monitor::compDataContainer&        dataContainer,
-                          std::unique_ptr< otf::component >& comp, compResContainer& res ) const
+void monitor::radial_profile( monitor::compDataContainer&        dataContainer,
+                              std::unique_ptr< otf::component >& comp,
+                              compResContainer&                  res ) const
 {
-    // extracted data
-    unsigned                       count = 0;
-    unique_ptr< double[] > const   usedMasses( new double[ dataContainer.partNum ] );
-    unique_ptr< double[] > const   usedPhis( new double[ dataContainer.partNum ] );
-    unique_ptr< unsigned[] > const locs( new unsigned[ dataContainer.partNum ] );
-
-    // extract the used data
-    static double   lowerBound = comp->A2profile.rmin;
-    static double   upperBound = comp->A2profile.rmax;
-    static unsigned binNum     = comp->A2profile.binNum;
-    for ( unsigned i = 0; i < dataContainer.partNum; ++i )
+    const unsigned partNum = dataContainer.partNum;
+    auto           radii( make_unique< double[] >( partNum ) );
+    auto           vRs( make_unique< double[] >( partNum ) );
+    auto           vPhis( make_unique< double[] >( partNum ) );
+    auto           vZs( make_unique< double[] >( partNum ) );
+    auto           zeds( make_unique< double[] >( partNum ) );
+    for ( unsigned i = 0; i < partNum; ++i )
     {
-        // get the radius of the current particle
-        static double radius = 0;
-        radius               = sqrt(
-            dataContainer.coordinates[ 3 * i + 0 ] * dataContainer.coordinates[ 3 * i + 0 ]
-            + dataContainer.coordinates[ 3 * i + 1 ] * dataContainer.coordinates[ 3 * i + 1 ] );
+        const double* pos = dataContainer.coordinates.get() + 3 * i;
+        const double* vel = dataContainer.velocities.get() + 3 * i;
+        const double  phi = dataContainer.sortedByRadius ? dataContainer.phis[ i ]
+                                                         : atan2( pos[ 1 ], pos[ 0 ] );
+        radii[ i ] =
+            dataContainer.sortedByRadius ? dataContainer.radii[ i ] : hypot( pos[ 0 ], pos[ 1 ] );
+        vRs[ i ]   = vel[ 0 ] * cos( phi ) + vel[ 1 ] * sin( phi );
+        vPhis[ i ] = -vel[ 0 ] * sin( phi ) + vel[ 1 ] * cos( phi );
+        vZs[ i ]   = vel[ 2 ];
+        zeds[ i ]  = pos[ 2 ];
+    }
+
+    // moments of v_R, v_phi, v_z and z
+    const double* quantities[ profileMomentNum ] = { vRs.get(), vPhis.get(), vZs.get(),
+                                                     zeds.get() };
+    auto&         accumulator                    = *profileAccumulators.at( comp->compName );
+    accumulator.reset();
+    accumulator.add( partNum, radii.get(), dataContainer.masses.get(), quantities );
+    accumulator.reduce( mpiRank );
+
+    // restore the analysis results
+    if ( isRootRank )
+    {
+        res.profile = make_unique< double[] >( comp->profile.binNum * profileQuantityNum );
+        for ( unsigned i = 0; i < comp->profile.binNum; ++i )
+        {
+            double*      row    = res.profile.get() + i * profileQuantityNum;
+            const double rInner = comp->profile.axis->edge( i );
+            const double rOuter = comp->profile.axis->edge( i + 1 );
+
+            row[ 0 ] = accumulator.count( i );
+            row[ 1 ] = accumulator.weight( i );
+            row[ 2 ] = row[ 1 ] / ( numbers::pi * ( rOuter * rOuter - rInner * rInner ) );
+            // mean and dispersion of the velocities
+            for ( unsigned j = 0; j < 3; ++j )
+            {
+                row[ 3 + 2 * j ] = accumulator.mean( i, j );
+                row[ 4 + 2 * j ] = accumulator.dispersion( i, j );
+            }
+            // the second moment of z
+            row[ 9 ] = accumulator.mean_square( i, 3 );
+        }
+    }
+}
 
-        // if the particle not in the specified region, go to the next loop
-        if ( radius < comp->A2profile.rmin or radius >= comp->A2profile.rmax )
+/**
+ * @brief API to calculate the mass-weighted percentiles of the velocities in the radial bins and
+ * the Lagrangian radii. The particles are sketched locally, then the sketches are merged by a
+ * single reduction, so no particle is gathered.
+ *
+ * @param dataContainer container of the extracted data
+ * @param comp parameters of the component analysis
+ * @param res container of the analysis results
+ */
+void monitor::quantile_profiles( monitor::compDataContainer&        dataContainer,
+                                 std::unique_ptr< otf::component >& comp,
+                                 compResContainer&                  res ) const
+{
+    const unsigned long percentileNum = comp->profile.percentiles.size();
+    const unsigned long velocityNum   = percentileNum > 0 ? 3UL * comp->profile.binNum : 0;
+    auto&               sketch        = *quantileSketches.at( comp->compName );
+    sketch.reset();
+    for ( unsigned i = 0; i < dataContainer.partNum; ++i )
+    {
+        const double* pos  = dataContainer.coordinates.get() + 3 * i;
+        const double* vel  = dataContainer.velocities.get() + 3 * i;
+        const double  mass = dataContainer.masses[ i ];
+        if ( comp->lagrangian.enable )
+        {
+            sketch.add( velocityNum, hypot( pos[ 0 ], pos[ 1 ], pos[ 2 ] ), mass );
+        }
+        const double radius =
+            dataContainer.sortedByRadius ? dataContainer.radii[ i ] : hypot( pos[ 0 ], pos[ 1 ] );
+        if ( velocityNum == 0 or not comp->profile.axis->contains( radius ) )
         {
             continue;
         }
+        const double phi = dataContainer.sortedByRadius ? dataContainer.phis[ i ]
+                                                        : atan2( pos[ 1 ], pos[ 0 ] );
+        const unsigned long bin = 3 * comp->profile.axis->find_index( radius );
+        sketch.add( bin, vel[ 0 ] * cos( phi ) + vel[ 1 ] * sin( phi ), mass );
+        sketch.add( bin + 1, -vel[ 0 ] * sin( phi ) + vel[ 1 ] * cos( phi ), mass );
+        sketch.add( bin + 2, vel[ 2 ], mass );
+    }
+    sketch.reduce( mpiRank );
 
-        usedPhis[ count ] =
-            atan2( dataContainer.coordinates[ 3 * i + 1 ], dataContainer.coordinates[ 3 * i + 0 ] );
-        usedMasses[ count ] = dataContainer.masses[ i ];
-        locs[ count ] =
-            unsigned( ( radius - lowerBound ) / ( upperBound - lowerBound ) * ( double )binNum );
-        ++count;
+    // restore the analysis results
+    if ( isRootRank )
+    {
+        if ( percentileNum > 0 )
+        {
+            res.percentiles = make_unique< double[] >( velocityNum * percentileNum );
+            for ( auto i = 0UL; i < comp->profile.binNum; ++i )
+            {
+                for ( auto j = 0UL; j < percentileNum; ++j )
+                {
+                    for ( auto k = 0UL; k < 3; ++k )
+                    {
+                        res.percentiles[ ( i * percentileNum + j ) * 3 + k ] =
+                            sketch.quantile( 3 * i + k, comp->profile.percentiles[ j ] / 100 );
+                    }
+                }
+            }
+        }
+        if ( comp->lagrangian.enable )
+        {
+            res.lagrangianRadii = make_unique< double[] >( comp->lagrangian.fractions.size() );
+            for ( auto j = 0UL; j < comp->lagrangian.fractions.size(); ++j )
+            {
+                res.lagrangianRadii[ j ] =
+                    sketch.quantile( velocityNum, comp->lagrangian.fractions[ j ] );
+            }
+        }
     }
+}
 
-    // Other used variables
-    auto A2ReSend( make_unique< double[] >( binNum ) );
-    auto A2ReRecv( make_unique< double[] >( binNum ) );
-    auto A2ImSend( make_unique< double[] >( binNum ) );
-    auto A2ImRecv( make_unique< double[] >( binNum ) );
-    auto A0Send( make_unique< double[] >( binNum ) );
-    auto A0Recv( make_unique< double[] >( binNum ) );
+/**
+ * @brief API to calculate the face-on kinematic maps, the moments of all velocity components in
+ * each pixel are accumulated in a single pass and reduced in a single reduction. The velocity
+ * moments are weighted by the particle masses.
+ *
+ * @param dataContainer container of the extracted data
+ * @param comp parameters of the component analysis
+ * @param res container of the analysis results
+ */
+void monitor::kinematic_maps( monitor::compDataContainer&        dataContainer,
+                              std::unique_ptr< otf::component >& comp,
+                              compResContainer&                  res ) const
+{
+    const unsigned partNum = dataContainer.partNum;
+    auto           xs( make_unique< double[] >( partNum ) );
+    auto           ys( make_unique< double[] >( partNum ) );
+    auto           vRs( make_unique< double[] >( partNum ) );
+    auto           vPhis( make_unique< double[] >( partNum ) );
+    auto           vZs( make_unique< double[] >( partNum ) );
+    for ( unsigned i = 0; i < partNum; ++i )
+    {
+        const double* pos = dataContainer.coordinates.get() + 3 * i;
+        const double* vel = dataContainer.velocities.get() + 3 * i;
+        const double  phi = dataContainer.sortedByRadius ? dataContainer.phis[ i ]
+                                                         : atan2( pos[ 1 ], pos[ 0 ] );
+        xs[ i ]    = pos[ 0 ];
+        ys[ i ]    = pos[ 1 ];
+        vRs[ i ]   = vel[ 0 ] * cos( phi ) + vel[ 1 ] * sin( phi );
+        vPhis[ i ] = -vel[ 0 ] * sin( phi ) + vel[ 1 ] * cos( phi );
+        vZs[ i ]   = vel[ 2 ];
+    }
 
-    // Accumulate in the local mpi rank
-    for ( unsigned i = 0; i < count; ++i )
+    // moments of v_R, v_phi and v_z (the line-of-sight velocity of the face-on view)
+    const double* quantities[ kinematicMomentNum ] = { vRs.get(), vPhis.get(), vZs.get() };
+    auto&         accumulator = *kinematicAccumulators.at( comp->compName );
+    accumulator.reset();
+    accumulator.add( partNum, xs.get(), ys.get(), dataContainer.masses.get(), quantities );
+    accumulator.reduce( mpiRank );
+
+    // restore the analysis results
+    if ( isRootRank )
     {
-        A2ReSend[ locs[ i ] ] += usedMasses[ i ] * cos( 2 * usedPhis[ i ] );
-        A2ImSend[ locs[ i ] ] += usedMasses[ i ] * sin( 2 * usedPhis[ i ] );
-        A0Send[ locs[ i ] ] += usedMasses[ i ];
+        const double cellSize = 2 * comp->kinematics.halfLength / comp->kinematics.binNum;
+        res.kinematics = make_unique< double[] >( accumulator.bin_num() * kinematicQuantityNum );
+        for ( auto i = 0UL; i < accumulator.bin_num(); ++i )
+        {
+            double* pixel = res.kinematics.get() + i * kinematicQuantityNum;
+            pixel[ 0 ]    = accumulator.count( i );
+            pixel[ 1 ]    = accumulator.weight( i ) / ( cellSize * cellSize );
+            for ( unsigned j = 0; j < kinematicMomentNum; ++j )
+            {
+                pixel[ 2 + 2 * j ] = accumulator.mean( i, j );
+                pixel[ 3 + 2 * j ] = accumulator.dispersion( i, j );
+            }
+        }
+    }
+}
+
+/**
+ * @brief API to calculate the 3D voxel grids of the mass density and the mass-weighted mean
+ * velocities, which are reduced to the root process.
+ *
+ * @param dataContainer container of the extracted data
+ * @param comp parameters of the component analysis
+ * @param res container of the analysis results
+ */
+void monitor::voxel_grid( monitor::compDataContainer&        dataContainer,
+                          std::unique_ptr< otf::component >& comp, compResContainer& res ) const
+{
+    // the masses and the mass-weighted velocities are deposited in a single pass
+    const bin_axis axis( -comp->grid.halfLength, comp->grid.halfLength, comp->grid.binNum );
+    const unsigned quantityNum = comp->grid.velocity ? 3 : 0;
+    auto           sums        = statistic::sums3d( mpiRank, dataContainer.coordinates.get(), axis,
+                                                    axis, axis, dataContainer.partNum,
+                                                    dataContainer.masses.get(), quantityNum,
+                                                    dataContainer.velocities.get() );
+
+    // restore the results
+    if ( isRootRank )
+    {
+        const double        cellSize  = axis.edge( 1 ) - axis.edge( 0 );
+        const unsigned long gridSize  = axis.bin_num() * axis.bin_num() * axis.bin_num();
+        const unsigned long binLength = 1 + quantityNum;
+        res.gridDensity               = make_unique< double[] >( gridSize );
+        for ( auto k = 0U; k < quantityNum; ++k )
+        {
+            res.gridVelocities[ k ] = make_unique< double[] >( gridSize );
+        }
+        for ( auto i = 0UL; i < gridSize; ++i )
+        {
+            const double mass    = sums[ binLength * i ];
+            res.gridDensity[ i ] = mass / ( cellSize * cellSize * cellSize );
+            for ( auto k = 0U; k < quantityNum; ++k )
+            {
+                res.gridVelocities[ k ][ i ] =
+                    mass != 0 ? sums[ binLength * i + 1 + k ] / mass : nan( "" );
+            }
+        }
+    }
+}
+
+/**
+ * @brief Estimate the bar length from the reduced radial A2 profile, only called in the root rank.
+ *
+ * @param comp parameters of the component analysis
+ * @param res container of the analysis results, where the A2 profile is already calculated
+ */
+void monitor::bar_length( std::unique_ptr< otf::component >& comp, compResContainer& res )
+{
+    const unsigned binNum = comp->A2profile.binNum;
+    auto           radii( make_unique< double[] >( binNum ) );
+    for ( unsigned i = 0; i < binNum; ++i )
+    {
+        radii[ i ] = comp->A2profile.axis->center( i );
+    }
+
+    res.barLengthA2  = bar_info::bar_length_a2( binNum, radii.get(), res.A2Re.get(),
+                                                res.A2Im.get(), comp->barLength.fraction );
+    res.barLengthPhi = bar_info::bar_length_phase( binNum, radii.get(), res.A2Re.get(),
+                                                   res.A2Im.get(), comp->barLength.deltaPhi );
+}
+
+/**
+ * @brief API to calculate the Tremaine-Weinberg integrals of the slits, in the (aligned) frame of
+ * the component.
+ *
+ * @param dataContainer container of the extracted data
+ * @param comp parameters of the component analysis
+ * @param res container of the analysis results
+ */
+void monitor::tw_integrals( monitor::compDataContainer&        dataContainer,
+                            std::unique_ptr< otf::component >& comp, compResContainer& res )
+{
+    res.TWintegrals = bar_info::tw_integrals(
+        dataContainer.partNum, dataContainer.masses.get(), dataContainer.coordinates.get(),
+        dataContainer.velocities.get(), comp->TW.inclination, ( unsigned )comp->TW.angles.size(),
+        comp->TW.angles.data(), comp->TW.slitNum, comp->TW.slitWidth, comp->TW.halfLength );
+}
+
+/**
+ * @brief API to calculate the radial A2 profile.
+ *
+ * @param dataContainer container of the extracted data
+ * @param comp parameters of the component analysis
+ * @param res container of the analysis results
+ */
+void monitor::a2_profile( monitor::compDataContainer&        dataContainer,
+                          std::unique_ptr< otf::component >& comp, compResContainer& res ) const
+{
+    const bin_axis& axis       = *comp->A2profile.axis;
+    const double    lowerBound = comp->A2profile.rmin;
+    const unsigned  binNum     = comp->A2profile.binNum;
+
+    // (real part of A2, imaginary part of A2, A0) of each bin, reduced together
+    auto bins( make_unique< double[] >( 3 * binNum ) );
+    auto binsRecv( make_unique< double[] >( 3 * binNum ) );
+
+    if ( dataContainer.sortedByRadius )
+    {
+        // each radial bin is a contiguous slice of the sorted data
+        unsigned first = radial_slice( dataContainer, lowerBound, lowerBound ).first;
+        for ( unsigned bin = 0; bin < binNum; ++bin )
+        {
+            const double   binUpper = axis.edge( bin + 1 );
+            const unsigned last     = radial_slice( dataContainer, binUpper, binUpper ).first;
+            for ( unsigned i = first; i < last; ++i )
+            {
+                const double mass = dataContainer.masses[ i ];
+                bins[ 3 * bin + 0 ] += mass * cos( 2 * dataContainer.phis[ i ] );
+                bins[ 3 * bin + 1 ] += mass * sin( 2 * dataContainer.phis[ i ] );
+                bins[ 3 * bin + 2 ] += mass;
+            }
+            first = last;
+        }
+    }
+    else
+    {
+        const double* coords = dataContainer.coordinates.get();
+        const double* masses = dataContainer.masses.get();
+        parallel_bins::deposit(
+            dataContainer.partNum, binNum, 3, bins.get(),
+            [ coords, &axis ]( unsigned long i ) -> long {
+                const double radius = sqrt( coords[ 3 * i + 0 ] * coords[ 3 * i + 0 ]
+                                            + coords[ 3 * i + 1 ] * coords[ 3 * i + 1 ] );
+                return axis.contains( radius ) ? ( long )axis.find_index( radius ) : -1;
+            },
+            [ coords, masses ]( double* bin, unsigned long i ) {
+                const double phi = atan2( coords[ 3 * i + 1 ], coords[ 3 * i + 0 ] );
+                bin[ 0 ] += masses[ i ] * cos( 2 * phi );
+                bin[ 1 ] += masses[ i ] * sin( 2 * phi );
+                bin[ 2 ] += masses[ i ];
+            } );
     }
 
     // MPI reduce
-    MPI_Reduce( A2ReSend.get(), A2ReRecv.get(), binNum, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD );
-    MPI_Reduce( A2ImSend.get(), A2ImRecv.get(), binNum, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD );
-    MPI_Reduce( A0Send.get(), A0Recv.get(), binNum, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD );
+    MPI_Reduce( bins.get(), binsRecv.get(), 3 * binNum, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD );
 
     // restore the analysis results
     if ( isRootRank )
     {
+        res.A2Re = make_unique< double[] >( binNum );
+        res.A2Im = make_unique< double[] >( binNum );
         for ( unsigned i = 0; i < binNum; ++i )
         {
-            A2ReRecv[ i ] /= A0Recv[ i ];
-            A2ImRecv[ i ] /= A0Recv[ i ];
+            res.A2Re[ i ] = binsRecv[ 3 * i + 0 ] / binsRecv[ 3 * i + 2 ];
+            res.A2Im[ i ] = binsRecv[ 3 * i + 1 ] / binsRecv[ 3 * i + 2 ];
         }
-        res.A2Im = std::move( A2ImRecv );
-        res.A2Re = std::move( A2ReRecv );
     }
 }
 
+
 /**
  * @brief API to calculate the image matrices.
  *
@@ -853,36 +1689,29 @@ void monitor::a2_profile( monitor::compDataContainer&        dataContainer,
 void monitor::image( monitor::compDataContainer&        dataContainer,
                      std::unique_ptr< otf::component >& comp, compResContainer& res ) const
 {
-    // extracted the xs, ys, zs for bin2d function
-    const unique_ptr< double[] > xs( new double[ dataContainer.partNum ] );
-    unique_ptr< double[] > const ys( new double[ dataContainer.partNum ] );
-    unique_ptr< double[] > const zs( new double[ dataContainer.partNum ] );
-    for ( unsigned i = 0; i < dataContainer.partNum; ++i )
-    {
-        xs[ i ] = dataContainer.coordinates[ 3 * i + 0 ];
-        ys[ i ] = dataContainer.coordinates[ 3 * i + 1 ];
-        zs[ i ] = dataContainer.coordinates[ 3 * i + 2 ];
-    }
-
-    // calculate the image matrix
-    auto imageXY = statistic::bin2d(
-        mpiRank, xs.get(), -comp->image.halfLength, comp->image.halfLength, comp->image.binNum,
-        ys.get(), -comp->image.halfLength, comp->image.halfLength, comp->image.binNum,
-        statistic_method::COUNT, dataContainer.partNum, dataContainer.masses.get() );
-    auto imageXZ = statistic::bin2d(
-        mpiRank, xs.get(), -comp->image.halfLength, comp->image.halfLength, comp->image.binNum,
-        zs.get(), -comp->image.halfLength, comp->image.halfLength, comp->image.binNum,
-        statistic_method::COUNT, dataContainer.partNum, dataContainer.masses.get() );
-    auto imageYZ = statistic::bin2d(
-        mpiRank, ys.get(), -comp->image.halfLength, comp->image.halfLength, comp->image.binNum,
-        zs.get(), -comp->image.halfLength, comp->image.halfLength, comp->image.binNum,
-        statistic_method::COUNT, dataContainer.partNum, dataContainer.masses.get() );
-
+    // the surface densities, all the three projections are deposited in the same pass of the
+    // particles
+    const bin_axis axis( -comp->image.halfLength, comp->image.halfLength, comp->image.binNum );
+    auto           images = statistic::projections(
+        mpiRank, dataContainer.coordinates.get(), axis, dataContainer.partNum,
+        dataContainer.masses.get(), comp->image.kernel );
 
     // restore the results
-    res.imageXY = std::move( imageXY );
-    res.imageXZ = std::move( imageXZ );
-    res.imageYZ = std::move( imageYZ );
+    if ( isRootRank )
+    {
+        const unsigned long imageSize = axis.bin_num() * axis.bin_num();
+        const double        cellSize  = axis.edge( 1 ) - axis.edge( 0 );
+        for ( auto i = 0UL; i < 3 * imageSize; ++i )
+        {
+            images[ i ] /= cellSize * cellSize;
+        }
+        res.imageXY                   = make_unique< double[] >( imageSize );
+        res.imageXZ                   = make_unique< double[] >( imageSize );
+        res.imageYZ                   = make_unique< double[] >( imageSize );
+        copy( images.get(), images.get() + imageSize, res.imageXY.get() );
+        copy( images.get() + imageSize, images.get() + 2 * imageSize, res.imageXZ.get() );
+        copy( images.get() + 2 * imageSize, images.get() + 3 * imageSize, res.imageYZ.get() );
+    }
 }
 
 /**
@@ -899,7 +1728,7 @@ void monitor::image( monitor::compDataContainer&        dataContainer,
 void monitor::component_analysis( double time, unsigned particleNumber, const int* partTypes,
                                   const double* masses, const double* potentials,
                                   const double* coordinates, const double* velocities,
-                                  unique_ptr< otf::component >& comp ) const
+                                  unique_ptr< otf::component >& comp )
 {
     if ( stepCounter % comp->period != 0 )  // only analyze the data in the specified steps
     {
@@ -912,34 +1741,57 @@ void monitor::component_analysis( double time, unsigned particleNumber, const in
 
     // NOTE: get the analysis result
     auto compResContainer = component_data_analyze( compDataContainer, comp );
+    if ( comp->recenter.enable )  // the frame may be reused by the orbital log of this step
+    {
+        auto& frame   = compFrames[ comp->compName ];
+        frame.step    = stepCounter;
+        frame.aligned = comp->align.enable;
+        copy( compResContainer.center, compResContainer.center + 3, frame.center );
+        copy( compResContainer.rotation, compResContainer.rotation + 9, frame.rotation );
+    }
+    if ( isRootRank and comp->patternSpeed.enable )
+    {
+        pattern_speed( time, comp, compResContainer );
+    }
+    if ( isRootRank and comp->barLength.enable )
+    {
+        bar_length( comp, compResContainer );
+    }
 
     // NOTE: create the datasets at the first call
     if ( isRootRank and stepCounter == 0 )
     {
         // create the datasets for times
-        h5Organizer->create_dataset_in_group( "Time", comp->compName, { 1 }, H5T_NATIVE_DOUBLE );
+        h5Organizer->create_dataset_in_group( "Time", comp->compName, { 1 }, H5T_NATIVE_DOUBLE,
+                                              true );
 
         // create the datasets for center positions
         if ( comp->recenter.enable )
         {
             h5Organizer->create_dataset_in_group( "Center", comp->compName, { 3 },
-                                                  H5T_NATIVE_DOUBLE );
+                                                  H5T_NATIVE_DOUBLE, true );
         }
 
         // create the datasets for bar infos
         if ( comp->sBar.enable )
         {
-            h5Organizer->create_dataset_in_group( "A2", comp->compName, { 1 }, H5T_NATIVE_DOUBLE );
+            h5Organizer->create_dataset_in_group( "A2", comp->compName, { 1 }, H5T_NATIVE_DOUBLE,
+                                                  true );
         }
         if ( comp->barAngle.enable )
         {
             h5Organizer->create_dataset_in_group( "BarAngle", comp->compName, { 1 },
-                                                  H5T_NATIVE_DOUBLE );
+                                                  H5T_NATIVE_DOUBLE, true );
         }
         if ( comp->sBuckle.enable )
         {
             h5Organizer->create_dataset_in_group( "Sbuckle", comp->compName, { 1 },
-                                                  H5T_NATIVE_DOUBLE );
+                                                  H5T_NATIVE_DOUBLE, true );
+        }
+        if ( comp->patternSpeed.enable )
+        {
+            h5Organizer->create_dataset_in_group( "PatternSpeed", comp->compName, { 1 },
+                                                  H5T_NATIVE_DOUBLE, true );
         }
 
         // create the datasets for image
@@ -957,18 +1809,43 @@ void monitor::component_analysis( double time, unsigned particleNumber, const in
                                                   H5T_NATIVE_DOUBLE );
         }
 
+        // create the datasets for kinematic maps
+        if ( comp->kinematics.enable )
+        {
+            h5Organizer->create_dataset_in_group(
+                "Kinematics", comp->compName,
+                { comp->kinematics.binNum, comp->kinematics.binNum, kinematicQuantityNum },
+                H5T_NATIVE_DOUBLE );
+        }
+
+        // create the datasets for 3D grids, with their own times
+        if ( comp->grid.enable )
+        {
+            const unsigned binNum = comp->grid.binNum;
+            h5Organizer->create_dataset_in_group( "GridTime", comp->compName, { 1 },
+                                                  H5T_NATIVE_DOUBLE, true );
+            h5Organizer->create_dataset_in_group( "GridDensity", comp->compName,
+                                                  { binNum, binNum, binNum }, H5T_NATIVE_DOUBLE );
+            if ( comp->grid.velocity )
+            {
+                for ( const auto* name : { "GridVX", "GridVY", "GridVZ" } )
+                {
+                    h5Organizer->create_dataset_in_group(
+                        name, comp->compName, { binNum, binNum, binNum }, H5T_NATIVE_DOUBLE );
+                }
+            }
+        }
+
         // create the datasets for radial A2 profile
         if ( comp->A2profile.enable )
         {
             // for radii
             h5Organizer->create_dataset_in_group( "A2profile_Rs", comp->compName,
                                                   { comp->A2profile.binNum }, H5T_NATIVE_DOUBLE );
-            double rBinSize =
-                ( comp->A2profile.rmax - comp->A2profile.rmin ) / comp->A2profile.binNum;
             auto A2Rs( make_unique< double[] >( comp->A2profile.binNum ) );
             for ( unsigned i = 0; i < comp->A2profile.binNum; ++i )
             {
-                A2Rs[ i ] = comp->A2profile.rmin + ( i + 0.5 ) * rBinSize;
+                A2Rs[ i ] = comp->A2profile.axis->center( i );
             }
             h5Organizer->flush_single_block( comp->compName, "A2profile_Rs", A2Rs.get() );
 
@@ -979,6 +1856,60 @@ void monitor::component_analysis( double time, unsigned particleNumber, const in
             h5Organizer->create_dataset_in_group( "A2profile_Im", comp->compName,
                                                   { comp->A2profile.binNum }, H5T_NATIVE_DOUBLE );
         }
+
+        // create the datasets for radial profile
+        if ( comp->profile.enable )
+        {
+            // for radii
+            h5Organizer->create_dataset_in_group( "Profile_Rs", comp->compName,
+                                                  { comp->profile.binNum }, H5T_NATIVE_DOUBLE );
+            auto profileRs( make_unique< double[] >( comp->profile.binNum ) );
+            for ( unsigned i = 0; i < comp->profile.binNum; ++i )
+            {
+                profileRs[ i ] = comp->profile.axis->center( i );
+            }
+            h5Organizer->flush_single_block( comp->compName, "Profile_Rs", profileRs.get() );
+
+            // for the quantities in each bin
+            h5Organizer->create_dataset_in_group( "Profile", comp->compName,
+                                                  { comp->profile.binNum, profileQuantityNum },
+                                                  H5T_NATIVE_DOUBLE );
+
+            // for the velocity percentiles in each bin
+            if ( not comp->profile.percentiles.empty() )
+            {
+                h5Organizer->create_dataset_in_group(
+                    "Profile_Percentiles", comp->compName,
+                    { comp->profile.binNum, ( unsigned )comp->profile.percentiles.size(), 3 },
+                    H5T_NATIVE_DOUBLE );
+            }
+        }
+
+        // create the datasets for Lagrangian radii
+        if ( comp->lagrangian.enable )
+        {
+            h5Organizer->create_dataset_in_group( "LagrangianRadii", comp->compName,
+                                                  { ( unsigned )comp->lagrangian.fractions.size() },
+                                                  H5T_NATIVE_DOUBLE, true );
+        }
+
+        // create the datasets for bar length
+        if ( comp->barLength.enable )
+        {
+            h5Organizer->create_dataset_in_group( "BarLength_A2", comp->compName, { 1 },
+                                                  H5T_NATIVE_DOUBLE, true );
+            h5Organizer->create_dataset_in_group( "BarLength_Phase", comp->compName, { 1 },
+                                                  H5T_NATIVE_DOUBLE, true );
+        }
+
+        // create the datasets for Tremaine-Weinberg integrals
+        if ( comp->TW.enable )
+        {
+            h5Organizer->create_dataset_in_group(
+                "TWintegrals", comp->compName,
+                { ( unsigned )comp->TW.angles.size(), comp->TW.slitNum, bar_info::twQuantityNum },
+                H5T_NATIVE_DOUBLE );
+        }
     }
 
     // NOTE: flush the data
@@ -1007,6 +1938,11 @@ void monitor::component_analysis( double time, unsigned particleNumber, const in
         {
             h5Organizer->flush_single_block( comp->compName, "Sbuckle", &compResContainer.sBuckle );
         }
+        if ( comp->patternSpeed.enable )
+        {
+            h5Organizer->flush_single_block( comp->compName, "PatternSpeed",
+                                             &compResContainer.patternSpeed );
+        }
 
         // radial A2 profile
         if ( comp->A2profile.enable )
@@ -1017,6 +1953,41 @@ void monitor::component_analysis( double time, unsigned particleNumber, const in
                                              compResContainer.A2Im.get() );
         }
 
+        // radial profile
+        if ( comp->profile.enable )
+        {
+            h5Organizer->flush_single_block( comp->compName, "Profile",
+                                             compResContainer.profile.get() );
+            if ( not comp->profile.percentiles.empty() )
+            {
+                h5Organizer->flush_single_block( comp->compName, "Profile_Percentiles",
+                                                 compResContainer.percentiles.get() );
+            }
+        }
+
+        // Lagrangian radii
+        if ( comp->lagrangian.enable )
+        {
+            h5Organizer->flush_single_block( comp->compName, "LagrangianRadii",
+                                             compResContainer.lagrangianRadii.get() );
+        }
+
+        // bar length
+        if ( comp->barLength.enable )
+        {
+            h5Organizer->flush_single_block( comp->compName, "BarLength_A2",
+                                             &compResContainer.barLengthA2 );
+            h5Organizer->flush_single_block( comp->compName, "BarLength_Phase",
+                                             &compResContainer.barLengthPhi );
+        }
+
+        // Tremaine-Weinberg integrals
+        if ( comp->TW.enable )
+        {
+            h5Organizer->flush_single_block( comp->compName, "TWintegrals",
+                                             compResContainer.TWintegrals.get() );
+        }
+
         // images
         if ( comp->image.enable )
         {
@@ -1027,97 +1998,124 @@ void monitor::component_analysis( double time, unsigned particleNumber, const in
             h5Organizer->flush_single_block( comp->compName, "ImageYZ",
                                              compResContainer.imageYZ.get() );
         }
+
+        // kinematic maps
+        if ( comp->kinematics.enable )
+        {
+            h5Organizer->flush_single_block( comp->compName, "Kinematics",
+                                             compResContainer.kinematics.get() );
+        }
+
+        // 3D grids, only in the gridded steps
+        if ( compResContainer.gridDensity )
+        {
+            h5Organizer->flush_single_block( comp->compName, "GridTime", &time );
+            h5Organizer->flush_single_block( comp->compName, "GridDensity",
+                                             compResContainer.gridDensity.get() );
+            const char* names[ 3 ] = { "GridVX", "GridVY", "GridVZ" };
+            for ( unsigned k = 0; k < 3 and comp->grid.velocity; ++k )
+            {
+                h5Organizer->flush_single_block( comp->compName, names[ k ],
+                                                 compResContainer.gridVelocities[ k ].get() );
+            }
+        }
     }
 }
 
 /**
- * @brief Extract the orbital data points and sort them based on the particle IDs, only the root
- * rank will return the effective data.
+ * @brief Extract the orbital data points, which are packed into records locally and gathered to
+ * the root rank by a single MPI_Gatherv of a derived datatype. Only the root rank will return the
+ * effective data, in the order of the ranks rather than the particle IDs.
  *
- * @param time time of the simulation
  * @param particleNumber number of particles in the local mpi rank
  * @param particleID ids of particles
  * @param particleType PartTypes of particles
  * @param mass masses of particles
  * @param coordinate coordinates of particles
  * @param velocity velocities of particles
- * @return the vector of orbitPoint objects
+ * @param reordered whether the local particles are known to be reordered since the last call
+ * @return the gathered orbitPoint records, which are kept until the next call
  */
-auto monitor::id_data_process( const double time, const unsigned particleNumber,
-                               const int* particleIDs, const int* particleTypes,
-                               const double* masses, const double* coordinates,
-                               const double* velocities ) const -> vector< orbitPoint >
+auto monitor::id_data_process( const unsigned particleNumber, const int* particleIDs,
+                               const int* particleTypes, const double* masses,
+                               const double* coordinates, const double* velocities,
+                               const bool reordered ) -> const vector< orbitPoint >&
 {
-    vector< orbitPoint >             points;
     static const otf::orbit_selector orbitSelector( para );
     auto getData = orbitSelector.select( particleNumber, particleIDs, particleTypes, masses,
-                                         coordinates, velocities );
+                                         coordinates, velocities, reordered );
 
-    // NOTE: MPI collection
-    const int                 localNum = getData->count;  // the number of ids in local mpi rank
-    const unique_ptr< int[] > numInEachRank( new int[ mpiSize ]() );  // number in each rank
-    // collective communication to gather the number of particles in each rank
-    MPI_Allgather( &localNum, 1, MPI_INT, numInEachRank.get(), 1, MPI_INT, MPI_COMM_WORLD );
-
-    // get the global total number
-    int totalNum = 0;
-    for ( int i = 0; i < mpiSize; ++i )
+    // the datatype of a record: the id and the data points, committed once
+    if ( orbitPointType == MPI_DATATYPE_NULL )
     {
-        totalNum += numInEachRank[ i ];
+        const int          lengths[ 2 ]       = { 1, orbitPointDim };
+        const MPI_Aint     displacements[ 2 ] = { offsetof( orbitPoint, particleID ),
+                                                  offsetof( orbitPoint, data ) };
+        const MPI_Datatype types[ 2 ]         = { MPI_INT, MPI_DOUBLE };
+        MPI_Datatype       structType;
+        MPI_Type_create_struct( 2, lengths, displacements, types, &structType );
+        MPI_Type_create_resized( structType, 0, sizeof( orbitPoint ), &orbitPointType );
+        MPI_Type_commit( &orbitPointType );
+        MPI_Type_free( &structType );
     }
 
-    // the offset of the local mpi rank, used for variable length mpi gathering
-    int localOffset = 0;
-    for ( int i = 0; i < mpiRank; ++i )
+    // NOTE: pack the local records
+    const int localNum = ( int )getData->count;  // the number of ids in local mpi rank
+    orbitLocalRecords.resize( localNum );
+    for ( int i = 0; i < localNum; ++i )
     {
-        localOffset += numInEachRank[ i ];
-    }
-
-    // the array of offset values
-    const unique_ptr< int[] > offsets( new int[ mpiSize ]() );
-    MPI_Allgather( &localOffset, 1, MPI_INT, offsets.get(), 1, MPI_INT, MPI_COMM_WORLD );
-
-    // number of data points and offsets of 3D array
-    const unique_ptr< int[] > numInEachRank3D( new int[ mpiSize ]() );  // number in each rank
-    const unique_ptr< int[] > offsets3D( new int[ mpiSize ]() );
-    for ( auto i = 0; i < mpiSize; ++i )
-    {
-        numInEachRank3D[ i ] = numInEachRank[ i ] * 3;
-        offsets3D[ i ]       = offsets[ i ] * 3;
+        auto& record      = orbitLocalRecords[ i ];
+        record.particleID = getData->id[ i ];
+        for ( int j = 0; j < 3; ++j )
+        {
+            record.data[ j ]     = getData->coordinate[ i * 3 + j ];
+            record.data[ 3 + j ] = getData->velocity[ i * 3 + j ];
+        }
+        if ( not para.orbit->recenter.enable )
+        {
+            continue;
+        }
+        // to the frame of the anchors: recenter, then rotate both coordinates and velocities
+        double* pos = record.data;
+        double* vel = record.data + 3;
+        for ( int j = 0; j < 3; ++j )
+        {
+            pos[ j ] -= orbitFrame.center[ j ];
+        }
+        if ( orbitFrame.aligned )
+        {
+            const double* rot      = orbitFrame.rotation;
+            const double  old[ 6 ] = { pos[ 0 ], pos[ 1 ], pos[ 2 ], vel[ 0 ], vel[ 1 ], vel[ 2 ] };
+            for ( int j = 0; j < 3; ++j )
+            {
+                pos[ j ] = rot[ j * 3 ] * old[ 0 ] + rot[ j * 3 + 1 ] * old[ 1 ]
+                           + rot[ j * 3 + 2 ] * old[ 2 ];
+                vel[ j ] = rot[ j * 3 ] * old[ 3 ] + rot[ j * 3 + 1 ] * old[ 4 ]
+                           + rot[ j * 3 + 2 ] * old[ 5 ];
+            }
+        }
     }
 
-    // global array of datas
-    const unique_ptr< int[] >    gIDs( new int[ totalNum ]() );
-    const unique_ptr< double[] > gCoordinate( new double[ totalNum * 3 ]() );
-    const unique_ptr< double[] > gVelocity( new double[ totalNum * 3 ]() );
-    // gather ids
-    MPI_Gatherv( getData->id.data(), localNum, MPI_INT, gIDs.get(), numInEachRank.get(),
-                 offsets.get(), MPI_INT, 0, MPI_COMM_WORLD );
-    // gather coordinates
-    MPI_Gatherv( getData->coordinate.data(), localNum * 3, MPI_DOUBLE, gCoordinate.get(),
-                 numInEachRank3D.get(), offsets3D.get(), MPI_DOUBLE, 0, MPI_COMM_WORLD );
-    // gather velocities
-    MPI_Gatherv( getData->velocity.data(), localNum * 3, MPI_DOUBLE, gVelocity.get(),
-                 numInEachRank3D.get(), offsets3D.get(), MPI_DOUBLE, 0, MPI_COMM_WORLD );
-
-    if ( not isRootRank )  // if not root rank, directly return
+    // NOTE: MPI collection, the buffers of the root rank are reused in all steps
+    if ( isRootRank )
     {
-        return points;
+        orbitCounts.resize( mpiSize );
+        orbitOffsets.resize( mpiSize );
     }
-
-    // NOTE: construct the vector of the orbit data points
-    for ( auto i = 0; i < totalNum; ++i )
+    MPI_Gather( &localNum, 1, MPI_INT, orbitCounts.data(), 1, MPI_INT, 0, MPI_COMM_WORLD );
+    if ( isRootRank )
     {
-        points.push_back( orbitPoint(
-            { gIDs[ i ],
-              { time, gCoordinate[ i * 3 + 0 ], gCoordinate[ i * 3 + 1 ], gCoordinate[ i * 3 + 2 ],
-                gVelocity[ i * 3 + 0 ], gVelocity[ i * 3 + 1 ], gVelocity[ i * 3 + 2 ] } } ) );
+        int totalNum = 0;
+        for ( int i = 0; i < mpiSize; ++i )
+        {
+            orbitOffsets[ i ] = totalNum;
+            totalNum += orbitCounts[ i ];
+        }
+        orbitRecords.resize( totalNum );
     }
-
-    // NOTE: sort the orbit points based on their id
-    static auto cmp = []( orbitPoint p1, orbitPoint p2 ) { return p1.particleID < p2.particleID; };
-    sort( points.begin(), points.end(), cmp );
-    return points;
+    MPI_Gatherv( orbitLocalRecords.data(), localNum, orbitPointType, orbitRecords.data(),
+                 orbitCounts.data(), orbitOffsets.data(), orbitPointType, 0, MPI_COMM_WORLD );
+    return orbitRecords;
 }
 
 }  // namespace otf
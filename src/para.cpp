@@ -12,6 +12,64 @@ using namespace std;
 
 namespace otf {
 
+/**
+ * @brief Read the radial bins of a profile: either the explicit edges, or rmin, rmax, binnum and an
+ * optional scale ("linear" by default, or "log").
+ *
+ * @param node the toml node of the profile
+ * @param rmin the lower bound of the bins
+ * @param rmax the upper bound of the bins
+ * @param binNum number of the bins
+ * @return the bins, or nullptr if the parameters are illegal
+ */
+static auto radial_bins( toml::node_view< toml::node > node, double& rmin, double& rmax,
+                         unsigned& binNum ) -> std::unique_ptr< bin_axis >
+{
+    if ( toml::array* arr = node[ "edges" ].as_array() )
+    {
+        vector< double > edges;
+        arr->for_each( [ &edges ]( auto&& el ) {
+            if constexpr ( toml::is_number< decltype( el ) > )
+            {
+                edges.push_back( ( double )*el );
+            }
+        } );
+        if ( edges.size() < 2 )
+        {
+            return nullptr;
+        }
+        for ( auto i = 1UL; i < edges.size(); ++i )
+        {
+            if ( not( edges[ i ] > edges[ i - 1 ] ) )
+            {
+                return nullptr;
+            }
+        }
+        rmin   = edges.front();
+        rmax   = edges.back();
+        binNum = edges.size() - 1;
+        return make_unique< bin_axis >( edges );
+    }
+
+    rmin                    = *node[ "rmin" ].value< double >();
+    rmax                    = *node[ "rmax" ].value< double >();
+    binNum                  = *node[ "binnum" ].value< unsigned >();
+    const std::string scale = node[ "scale" ].value_or( "linear" );
+    if ( not( rmin >= 0 and rmin < rmax and binNum > 0 ) )
+    {
+        return nullptr;
+    }
+    if ( scale == "linear" )
+    {
+        return make_unique< bin_axis >( rmin, rmax, binNum );
+    }
+    if ( scale == "log" and rmin > 0 )
+    {
+        return make_unique< bin_axis >( rmin, rmax, binNum, bin_scale::LOG );
+    }
+    return nullptr;
+}
+
 runtime_para::runtime_para( const std::string_view& tomlParaFile )
 {
     if ( access( tomlParaFile.data(), F_OK ) != 0 )
@@ -56,6 +114,20 @@ runtime_para::runtime_para( const std::string_view& tomlParaFile )
         throw;
     };
 
+    // buffer policy of the scalar logs
+    constexpr unsigned defaultBufferRows = 64;
+    constexpr double   defaultBufferTime = 60;  // in seconds
+    bufferRows    = paraTable[ "global" ][ "bufferrows" ].value_or( defaultBufferRows );
+    bufferTime    = paraTable[ "global" ][ "buffertime" ].value_or( defaultBufferTime );
+    flushOnSignal = paraTable[ "global" ][ "flushonsignal" ].value_or( false );
+    if ( not( bufferRows > 0 and bufferTime >= 0 ) )
+    {
+        int rank;
+        MPI_Comm_rank( MPI_COMM_WORLD, &rank );
+        MPI_ERROR( rank, "bufferrows must be positive and buffertime must be non-negative!" );
+        throw;
+    };
+
     // orbital log parameters
     orbit = make_unique< otf::orbit >( *paraTable[ "orbit" ].as_table() );
 
@@ -81,7 +153,10 @@ runtime_para::runtime_para( const std::string_view& tomlParaFile )
         effective = comp.second->recenter.enable or comp.second->align.enable
                     or comp.second->sBar.enable or comp.second->barAngle.enable
                     or comp.second->sBuckle.enable or comp.second->image.enable
-                    or comp.second->A2profile.enable;
+                    or comp.second->A2profile.enable or comp.second->patternSpeed.enable
+                    or comp.second->TW.enable or comp.second->barLength.enable
+                    or comp.second->profile.enable or comp.second->kinematics.enable
+                    or comp.second->grid.enable or comp.second->lagrangian.enable;
 
         if ( not effective )
         {
@@ -186,12 +261,69 @@ component::component( string_view& compName, toml::table& compNodeTable )
         align.radius = *compNodeTable[ "align" ][ "radius" ].value< double >();
     }
 
+    // radial sort, optional
+    radSort.enable = compNodeTable[ "radsort" ][ "enable" ].value_or( false );
+
     // image
     image.enable = *compNodeTable[ "image" ][ "enable" ].value< bool >();
     if ( image.enable )
     {
         image.halfLength = *compNodeTable[ "image" ][ "halflength" ].value< double >();
         image.binNum     = *compNodeTable[ "image" ][ "binnum" ].value< unsigned >();
+        const std::string kernel = compNodeTable[ "image" ][ "kernel" ].value_or( "ngp" );
+        if ( kernel == "ngp" )
+        {
+            image.kernel = image_kernel::NGP;
+        }
+        else if ( kernel == "cic" )
+        {
+            image.kernel = image_kernel::CIC;
+        }
+        else if ( kernel == "tsc" )
+        {
+            image.kernel = image_kernel::TSC;
+        }
+        else
+        {
+            int rank;
+            MPI_Comm_rank( MPI_COMM_WORLD, &rank );
+            MPI_ERROR( rank, "The image kernel [%s] of [%s] is illegal.", kernel.c_str(),
+                       compName.data() );
+            throw;
+        }
+    }
+
+    // kinematic maps, optional
+    kinematics.enable = compNodeTable[ "kinematics" ][ "enable" ].value_or( false );
+    if ( kinematics.enable )
+    {
+        kinematics.halfLength = *compNodeTable[ "kinematics" ][ "halflength" ].value< double >();
+        kinematics.binNum     = *compNodeTable[ "kinematics" ][ "binnum" ].value< unsigned >();
+        if ( not( kinematics.halfLength > 0 and kinematics.binNum > 0 ) )
+        {
+            int rank;
+            MPI_Comm_rank( MPI_COMM_WORLD, &rank );
+            MPI_ERROR( rank, "The parameters for kinematic maps of [%s] is illegal.",
+                       compName.data() );
+            throw;
+        };
+    }
+
+    // 3D voxel grids, optional
+    grid.enable = compNodeTable[ "grid" ][ "enable" ].value_or( false );
+    if ( grid.enable )
+    {
+        grid.halfLength = *compNodeTable[ "grid" ][ "halflength" ].value< double >();
+        grid.binNum     = *compNodeTable[ "grid" ][ "binnum" ].value< unsigned >();
+        grid.period     = compNodeTable[ "grid" ][ "period" ].value_or( 1U );
+        grid.velocity   = compNodeTable[ "grid" ][ "velocity" ].value_or( false );
+        if ( not( grid.halfLength > 0 and grid.binNum > 0 and grid.period > 0 ) )
+        {
+            int rank;
+            MPI_Comm_rank( MPI_COMM_WORLD, &rank );
+            MPI_ERROR( rank, "The parameters for 3D grids of [%s] is illegal.", compName.data() );
+            throw;
+        };
     }
 
     // bar info parameters
@@ -241,15 +373,57 @@ component::component( string_view& compName, toml::table& compNodeTable )
             throw;
         };
     }
-    // buckling strength
+    // bar pattern speed, optional
+    patternSpeed.enable = compNodeTable[ "patternspeed" ][ "enable" ].value_or( false );
+    if ( patternSpeed.enable )
+    {
+        patternSpeed.window = *compNodeTable[ "patternspeed" ][ "window" ].value< unsigned >();
+        if ( not( patternSpeed.window >= 2 and barAngle.enable ) )
+        {
+            int rank;
+            MPI_Comm_rank( MPI_COMM_WORLD, &rank );
+            MPI_ERROR( rank,
+                       "The pattern speed of [%s] requires barangle.enable=true and a window of at "
+                       "least 2 steps.",
+                       compName.data() );
+            throw;
+        };
+    }
+    // Tremaine-Weinberg integrals, optional
+    TW.enable = compNodeTable[ "TW" ][ "enable" ].value_or( false );
+    if ( TW.enable )
+    {
+        TW.inclination = *compNodeTable[ "TW" ][ "inclination" ].value< double >();
+        if ( toml::array* arr = compNodeTable[ "TW" ][ "angles" ].as_array() )
+        {
+            arr->for_each( [ this ]( auto&& el ) {
+                if constexpr ( toml::is_number< decltype( el ) > )
+                {
+                    TW.angles.push_back( ( double )*el );
+                }
+            } );
+        }
+        TW.slitNum    = *compNodeTable[ "TW" ][ "slitnum" ].value< unsigned >();
+        TW.slitWidth  = *compNodeTable[ "TW" ][ "slitwidth" ].value< double >();
+        TW.halfLength = *compNodeTable[ "TW" ][ "halflength" ].value< double >();
+        if ( not( TW.inclination > 0 and TW.inclination < 90 and TW.angles.size() > 0
+                  and TW.slitNum > 0 and TW.slitWidth > 0 and TW.halfLength > 0 ) )
+        {
+            int rank;
+            MPI_Comm_rank( MPI_COMM_WORLD, &rank );
+            MPI_ERROR( rank,
+                       "The parameters for Tremaine-Weinberg integrals of [%s] is illegal.",
+                       compName.data() );
+            throw;
+        };
+    }
+    // radial A2 profile
     A2profile.enable = *compNodeTable[ "A2profile" ][ "enable" ].value< bool >();
     if ( A2profile.enable )
     {
-        A2profile.rmin   = *compNodeTable[ "A2profile" ][ "rmin" ].value< double >();
-        A2profile.rmax   = *compNodeTable[ "A2profile" ][ "rmax" ].value< double >();
-        A2profile.binNum = *compNodeTable[ "A2profile" ][ "binnum" ].value< unsigned >();
-        if ( not( A2profile.rmin >= 0 and A2profile.rmin < A2profile.rmax
-                  and A2profile.binNum > 0 ) )
+        A2profile.axis = radial_bins( compNodeTable[ "A2profile" ], A2profile.rmin,
+                                      A2profile.rmax, A2profile.binNum );
+        if ( not( A2profile.axis and A2profile.rmin >= 0 ) )
         {
             int rank;
             MPI_Comm_rank( MPI_COMM_WORLD, &rank );
@@ -258,6 +432,88 @@ component::component( string_view& compName, toml::table& compNodeTable )
             throw;
         };
     }
+    // bar length from the radial A2 profile, optional
+    barLength.enable = compNodeTable[ "barlength" ][ "enable" ].value_or( false );
+    if ( barLength.enable )
+    {
+        barLength.fraction = *compNodeTable[ "barlength" ][ "fraction" ].value< double >();
+        barLength.deltaPhi = *compNodeTable[ "barlength" ][ "dphi" ].value< double >();
+        if ( not( A2profile.enable and barLength.fraction > 0 and barLength.fraction < 1
+                  and barLength.deltaPhi > 0 and barLength.deltaPhi < 90 ) )
+        {
+            int rank;
+            MPI_Comm_rank( MPI_COMM_WORLD, &rank );
+            MPI_ERROR( rank,
+                       "The bar length of [%s] requires A2profile.enable=true, 0 < fraction < 1 "
+                       "and 0 < dphi < 90.",
+                       compName.data() );
+            throw;
+        };
+    }
+    // radial profile, optional
+    profile.enable = compNodeTable[ "profile" ][ "enable" ].value_or( false );
+    if ( profile.enable )
+    {
+        profile.axis = radial_bins( compNodeTable[ "profile" ], profile.rmin, profile.rmax,
+                                    profile.binNum );
+        if ( not( profile.axis and profile.rmin >= 0 ) )
+        {
+            int rank;
+            MPI_Comm_rank( MPI_COMM_WORLD, &rank );
+            MPI_ERROR( rank, "The parameters for radial profile calculation of [%s] is illegal.",
+                       compName.data() );
+            throw;
+        };
+        // percentiles of the velocities in each bin, optional
+        if ( toml::array* arr = compNodeTable[ "profile" ][ "percentiles" ].as_array() )
+        {
+            arr->for_each( [ this ]( auto&& el ) {
+                if constexpr ( toml::is_number< decltype( el ) > )
+                {
+                    profile.percentiles.push_back( ( double )*el );
+                }
+            } );
+        }
+        for ( const auto percentile : profile.percentiles )
+        {
+            if ( not( percentile >= 0 and percentile <= 100 ) )
+            {
+                int rank;
+                MPI_Comm_rank( MPI_COMM_WORLD, &rank );
+                MPI_ERROR( rank, "The percentile [%g] of the radial profile of [%s] is illegal.",
+                           percentile, compName.data() );
+                throw;
+            }
+        }
+    }
+    // Lagrangian radii, optional
+    lagrangian.enable = compNodeTable[ "lagrangian" ][ "enable" ].value_or( false );
+    if ( lagrangian.enable )
+    {
+        if ( toml::array* arr = compNodeTable[ "lagrangian" ][ "fractions" ].as_array() )
+        {
+            arr->for_each( [ this ]( auto&& el ) {
+                if constexpr ( toml::is_number< decltype( el ) > )
+                {
+                    lagrangian.fractions.push_back( ( double )*el );
+                }
+            } );
+        }
+        bool legal = lagrangian.fractions.size() > 0;
+        for ( const auto fraction : lagrangian.fractions )
+        {
+            legal = legal and fraction > 0 and fraction <= 1;
+        }
+        if ( not legal )
+        {
+            int rank;
+            MPI_Comm_rank( MPI_COMM_WORLD, &rank );
+            MPI_ERROR( rank,
+                       "The Lagrangian radii of [%s] require the mass fractions in (0, 1].",
+                       compName.data() );
+            throw;
+        };
+    }
 }
 
 orbit::orbit( toml::table& orbitNode )
@@ -315,12 +571,41 @@ orbit::orbit( toml::table& orbitNode )
         // random selection
         fraction = *orbitNode[ "fraction" ].value< double >();
         assert( fraction > 0 and fraction <= 1 );
+        seed = ( uint64_t )orbitNode[ "seed" ].value_or( ( int64_t )0 );
     }
     else
     {
         // By a text file
         const string tmpIdFileName( *orbitNode[ "idfile" ].value< string_view >() );
         this->idfile = tmpIdFileName;
+        const string format = orbitNode[ "idformat" ].value_or( "text" );
+        if ( format == "text" )
+        {
+            idformat = id_file_format::TEXT;
+        }
+        else if ( format == "int32" )
+        {
+            idformat = id_file_format::INT32;
+        }
+        else if ( format == "int64" )
+        {
+            idformat = id_file_format::INT64;
+        }
+        else if ( format == "hdf5" )
+        {
+            idformat = id_file_format::HDF5;
+        }
+        else
+        {
+            int rank;
+            MPI_Comm_rank( MPI_COMM_WORLD, &rank );
+            MPI_ERROR( rank,
+                       "Get an unknown value for [orbit.idformat]: [%s], must be one of 'text', "
+                       "'int32', 'int64' and 'hdf5'.",
+                       format.c_str() );
+            throw;
+        }
+        iddataset = orbitNode[ "iddataset" ].value_or( "ParticleIDs" );
     }
 
     // recenter parameters
@@ -360,6 +645,56 @@ orbit::orbit( toml::table& orbitNode )
         {
             recenter.initialGuess[ i ] = *iguess[ i ].value< double >();
         }
+        recenter.align       = orbitNode[ "recenter" ][ "align" ].value_or( false );
+        recenter.alignRadius = orbitNode[ "recenter" ][ "alignradius" ].value_or( recenter.radius );
+        if ( recenter.align and not( recenter.alignRadius > 0 ) )
+        {
+            int rank;
+            MPI_Comm_rank( MPI_COMM_WORLD, &rank );
+            MPI_ERROR( rank, "recenter.alignradius of the orbital log must be positive!" );
+            throw;
+        }
+    }
+
+    // storage of the orbits
+    const string mode = orbitNode[ "storage" ][ "mode" ].value_or( "double" );
+    if ( mode == "double" )
+    {
+        storage.mode = orbit_storage_para::storage_mode::DOUBLE;
+    }
+    else if ( mode == "float" )
+    {
+        storage.mode = orbit_storage_para::storage_mode::FLOAT;
+    }
+    else if ( mode == "quantized" )
+    {
+        storage.mode = orbit_storage_para::storage_mode::QUANTIZED;
+    }
+    else
+    {
+        int rank;
+        MPI_Comm_rank( MPI_COMM_WORLD, &rank );
+        MPI_ERROR( rank,
+                   "Get an unknown value for [orbit.storage.mode]: [%s], must be one of 'double', "
+                   "'float' and 'quantized'.",
+                   mode.c_str() );
+        throw;
+    }
+    if ( storage.mode == orbit_storage_para::storage_mode::QUANTIZED )
+    {
+        storage.posBox = orbitNode[ "storage" ][ "box" ].value_or( 0.0 );
+        storage.velBox = orbitNode[ "storage" ][ "vbox" ].value_or( 0.0 );
+        storage.bits   = orbitNode[ "storage" ][ "bits" ].value_or( 24U );
+        storage.delta  = orbitNode[ "storage" ][ "delta" ].value_or( true );
+        if ( not( storage.posBox > 0 and storage.velBox > 0 and storage.bits >= 2
+                  and storage.bits <= 31 ) )
+        {
+            int rank;
+            MPI_Comm_rank( MPI_COMM_WORLD, &rank );
+            MPI_ERROR( rank, "The quantized orbits require storage.box > 0, storage.vbox > 0 and "
+                             "2 <= storage.bits <= 31." );
+            throw;
+        }
     }
 }
 
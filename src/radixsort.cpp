@@ -0,0 +1,97 @@
+#include "../include/radixsort.hpp"
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <utility>
+#include <vector>
+using namespace std;
+
+namespace otf {
+
+/**
+ * @brief Map a double to an unsigned integer, such that the order of the integers is the same as
+ * the order of the doubles.
+ *
+ * @param key the double value
+ * @return the ordered bits of the value
+ */
+auto radix_sort::ordered_bits( const double key ) -> uint64_t
+{
+    constexpr uint64_t signBit = 1ULL << 63;
+    uint64_t           bits    = 0;
+    memcpy( &bits, &key, sizeof( double ) );
+    // negative: flip all bits, positive: flip the sign bit only
+    return ( bits & signBit ) != 0 ? ~bits : bits | signBit;
+}
+
+/**
+ * @brief Get the permutation that sorts the keys in ascending order, by a stable LSD radix sort.
+ * The passes whose digits are the same for all keys are skipped, which is the usual case for the
+ * high bits of the radii.
+ *
+ * @param keys the keys to be sorted
+ * @param num number of keys
+ * @return a unique_ptr to the indexes of the keys in the sorted order
+ */
+auto radix_sort::argsort( const double* keys, const unsigned num ) -> unique_ptr< unsigned[] >
+{
+    constexpr uint64_t digitMask = radix - 1;
+    constexpr unsigned passNum   = ( 64 + digitBits - 1 ) / digitBits;
+
+    vector< uint64_t > bits( num );
+    vector< uint64_t > bitsTmp( num );
+    vector< unsigned > order( num );
+    vector< unsigned > orderTmp( num );
+    for ( unsigned i = 0; i < num; ++i )
+    {
+        bits[ i ]  = ordered_bits( keys[ i ] );
+        order[ i ] = i;
+    }
+
+    vector< unsigned > offsets( radix );
+    for ( unsigned pass = 0; pass < passNum; ++pass )
+    {
+        const unsigned shift = pass * digitBits;
+
+        // histogram of the current digit
+        fill( offsets.begin(), offsets.end(), 0U );
+        for ( unsigned i = 0; i < num; ++i )
+        {
+            ++offsets[ ( bits[ i ] >> shift ) & digitMask ];
+        }
+
+        // skip the pass if all keys share the same digit
+        if ( num == 0 or offsets[ ( bits[ 0 ] >> shift ) & digitMask ] == num )
+        {
+            continue;
+        }
+
+        // exclusive prefix sum: the first position of each digit
+        unsigned sum = 0;
+        for ( auto& offset : offsets )
+        {
+            const unsigned count = offset;
+            offset               = sum;
+            sum += count;
+        }
+
+        // scatter to the sorted positions of this digit
+        for ( unsigned i = 0; i < num; ++i )
+        {
+            const unsigned pos = offsets[ ( bits[ i ] >> shift ) & digitMask ]++;
+            bitsTmp[ pos ]     = bits[ i ];
+            orderTmp[ pos ]    = order[ i ];
+        }
+        std::swap( bits, bitsTmp );
+        std::swap( order, orderTmp );
+    }
+
+    auto res( make_unique< unsigned[] >( num ) );
+    for ( unsigned i = 0; i < num; ++i )
+    {
+        res[ i ] = order[ i ];
+    }
+    return res;
+}
+
+}  // namespace otf
@@ -2,6 +2,7 @@
 #include "../include/myprompt.hpp"
 #include <algorithm>
 #include <cmath>
+#include <limits>
 #include <memory>
 #include <mpi.h>
 using namespace std;
@@ -121,14 +122,15 @@ auto recenter::most_bound_particle( const double* potential, const double* coord
 {
     auto      minPotPosition( make_unique< double[] >( 3 ) );
     const int minLocateId = min_element( potential, potential + partNum ) - potential;
-    double    min         = potential[ minLocateId ];  // local min
+    // local min, a rank without particles never holds the global min
+    double min = partNum > 0 ? potential[ minLocateId ] : numeric_limits< double >::infinity();
     // global min after reduce
     MPI_Allreduce( MPI_IN_PLACE, &min, 1, MPI_DOUBLE, MPI_MIN, MPI_COMM_WORLD );
 
     // Get the rank number of the minimal potential
     int minLocateRank = 0;
     MPI_Comm_rank( MPI_COMM_WORLD, &minLocateRank );
-    if ( min != potential[ minLocateId ] )  // local min!=global min
+    if ( partNum == 0 or min != potential[ minLocateId ] )  // local min!=global min
     {
         minLocateRank = 0;
     }
@@ -2,15 +2,18 @@
 #include "../include/myprompt.hpp"
 #include "../include/para.hpp"
 #include <algorithm>
+#include <climits>
+#include <cstdint>
 #include <cstdlib>
+#include <fcntl.h>
 #include <fstream>
+#include <hdf5.h>
 #include <ios>
-#include <iterator>
 #include <memory>
 #include <mpi.h>
-#include <random>
-#include <set>
 #include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <sys/unistd.h>
 #include <unistd.h>
 #include <utility>
@@ -20,63 +23,42 @@ using namespace std;
 namespace otf {
 
 /**
- * @brief Select particle ids with a specified fraction, can be used in any mpi rank.
+ * @brief Whether a particle id is sampled with a specified fraction, by a seeded hash of the id:
+ * the id is mixed with the seed by the splitmix64 finalizer, and it's sampled if the hash is in the
+ * lowest fraction of its range. So the sampling is reproducible with the same seed, independent of
+ * the mpi decomposition, and can be decided in any mpi rank without communication.
  *
- * @param raw raw id list
- * @param types pointer to the particle types of simulation data
- * @param sampleTypes vector of the targeted particle types to be sampled
- * @param fraction sampling fraction
- * @return a vector<unsigned> of the selected id list
+ * @param particleID the particle id
+ * @param seed seed of the hash, different seeds give independent samples
+ * @param fraction sampling fraction, in (0, 1]
+ * @return whether the id is sampled
  */
-auto orbit_selector::id_sample( const vector< int >& rawIds, const int* types,
-                                const vector< int >& sampleTypes, double fraction ) -> vector< int >
+auto orbit_selector::id_sampled( const int particleID, const uint64_t seed, const double fraction )
+    -> bool
 {
-    // check the fraction argument is reasonable
-    if ( fraction <= 0 or fraction > 1 )
-    {
-        ERROR( "Try to select a illegal fraction: [%lf]", fraction );
-    }
-
-    auto          partNum = rawIds.size();
-    vector< int > filtered( partNum );  // exclude the particles without target types
-    auto          counter = 0UL;        // counter of effective particles in this mpi rank
-    for ( auto i = 0UL; i < partNum; ++i )
-    {
-        if ( find( sampleTypes.begin(), sampleTypes.end(), types[ i ] ) != sampleTypes.end() )
-        {
-            filtered[ counter++ ] = rawIds[ i ];
-        }
-    }
-    filtered.resize( counter );  // remove the tailing rubish values
-
-    if ( fraction == 1 )  // if it's 100% fraction, directly return the ids
-    {
-        return filtered;
-    }
-
-    // if not 100%, use std::sample to randomly sample the ids
-    auto const    selectNum = ( size_t )( counter * fraction );  // number of data points
-    vector< int > res;                                           // results
-    sample( filtered.begin(), filtered.end(), back_inserter( res ), selectNum,
-            mt19937{ random_device{}() } );
-    return res;
+    const auto mix = []( uint64_t z ) {
+        z = ( z ^ ( z >> 30 ) ) * 0xBF58476D1CE4E5B9ULL;
+        z = ( z ^ ( z >> 27 ) ) * 0x94D049BB133111EBULL;
+        return z ^ ( z >> 31 );
+    };
+    const uint64_t hash = mix( ( uint64_t )( uint32_t )particleID
+                               + mix( seed + 0x9E3779B97F4A7C15ULL ) );
+    // the highest 53 bits as a uniform number in [0, 1)
+    return ( double )( hash >> 11 ) * 0x1p-53 < fraction;
 }
 
 /**
- * @brief Read the ids in the given id list file, can be used in any mpi rank to read the ids into
- * it.
+ * @brief Read the ids in a text file, one id per line.
  *
- * @param idFilename filename of the id list file (in ASCII txt format)
- * @return std::vector<int> of the ids.
+ * @param idFilename filename of the id list file
+ * @return std::vector<int> of the ids
  */
-auto orbit_selector::id_read( const string& idFilename ) -> vector< int >
+static auto read_text_ids( const string& idFilename ) -> vector< int >
 {
     // check the availability of the file
     if ( access( idFilename.c_str(), F_OK ) != 0 )
     {
-        int rank;
-        MPI_Comm_rank( MPI_COMM_WORLD, &rank );
-        MPI_ERROR( rank, "Particle ID file not found: [%s]", idFilename.c_str() );
+        ERROR( "Particle ID file not found: [%s]", idFilename.c_str() );
         throw "Particle ID File not found!";
     }
 
@@ -103,85 +85,283 @@ auto orbit_selector::id_read( const string& idFilename ) -> vector< int >
             }
         }
     }
-
-    // Remove the possible repeated values
-    set< int > tmpSet( ids.begin(), ids.end() );
-    ids.assign( tmpSet.begin(), tmpSet.end() );
-
     return ids;
 }
 
-orbit_selector::orbit_selector( const runtime_para& para ) : para( para )
+/**
+ * @brief Convert the 64-bit ids to int, all of them must be in the range of int.
+ *
+ * @param raw the 64-bit ids
+ * @param idNum number of the ids
+ * @param idFilename filename of the id list file, for the error message
+ * @return std::vector<int> of the ids
+ */
+static auto narrow_ids( const int64_t* raw, const size_t idNum, const string& idFilename )
+    -> vector< int >
 {
-    ;
+    vector< int > ids( idNum );
+    for ( auto i = 0UL; i < idNum; ++i )
+    {
+        if ( raw[ i ] < INT_MIN or raw[ i ] > INT_MAX )
+        {
+            ERROR( "Get a particle ID [%ld] out of the range of int in [%s].", ( long )raw[ i ],
+                   idFilename.c_str() );
+            throw "Get a particle ID out of range";
+        }
+        ids[ i ] = ( int )raw[ i ];
+    }
+    return ids;
 }
 
 /**
- * @brief extract the target ids of orbital log based on the specified parameters.
+ * @brief Read the ids in a raw binary file of native integers, which is mapped into the memory
+ * rather than read by the stream.
  *
- * @param particleNumber the number of particles, which will be used to determine the array length
- * @param particleID the id of particles
- * @param partType the PartType of particles
- * @return a vector of the extracted ids
+ * @param idFilename filename of the id list file
+ * @param width bytes of each id: 4 for int32, or 8 for int64
+ * @return std::vector<int> of the ids
  */
-auto orbit_selector::extract_target_ids( const unsigned particleNumber, const int* particleID,
-                                         const int* partType ) const -> vector< int >
+static auto read_binary_ids( const string& idFilename, const size_t width ) -> vector< int >
 {
-    // get the target id list based on specified parameters
-    vector< int > targetIDs;
-    if ( para.orbit->method == otf::orbit::id_selection_method::RANDOM )  // by random sampling
+    const int   fd = open( idFilename.c_str(), O_RDONLY );
+    struct stat info;
+    if ( fd < 0 or fstat( fd, &info ) != 0 )
     {
-        // restore the raw ids into an vector
-        vector< int > rawIds( particleNumber );
-        for ( auto i = 0U; i < particleNumber; ++i )
+        ERROR( "Failed to open the particle ID file: [%s]", idFilename.c_str() );
+        if ( fd >= 0 )
         {
-            rawIds[ i ] = particleID[ i ];
+            close( fd );
         }
-        // random sampling
-        auto localTargetIDs =
-            id_sample( rawIds, partType, para.orbit->sampleTypes, para.orbit->fraction );
-
-        // gather the target ids in each rank to one vector
-        int rank;
-        int size;
-        MPI_Comm_rank( MPI_COMM_WORLD, &rank );
-        MPI_Comm_size( MPI_COMM_WORLD, &size );
-
-        int localLength = localTargetIDs.size();  // the number of ids in local mpi rank
-        const unique_ptr< int[] > numInEachRank( new int[ size ]() );  // number in each rank
-        // collective communication: gather the number of particles in each rank
-        MPI_Allgather( &localLength, 1, MPI_INT, numInEachRank.get(), 1, MPI_INT, MPI_COMM_WORLD );
-
-        // get the global total number
-        int totalLength = 0;
-        for ( int i = 0; i < size; ++i )
+        throw "Failed to open the particle ID file!";
+    }
+    const auto bytes = ( size_t )info.st_size;
+    if ( bytes == 0 )
+    {
+        close( fd );
+        return {};
+    }
+    if ( bytes % width != 0 )
+    {
+        close( fd );
+        ERROR( "The size of the particle ID file [%s] is not a multiple of %lu bytes.",
+               idFilename.c_str(), width );
+        throw "Get a truncated particle ID file";
+    }
+    void* const mapped = mmap( nullptr, bytes, PROT_READ, MAP_PRIVATE, fd, 0 );
+    close( fd );  // the mapping is kept after the file is closed
+    if ( mapped == MAP_FAILED )
+    {
+        ERROR( "Failed to map the particle ID file: [%s]", idFilename.c_str() );
+        throw "Failed to map the particle ID file!";
+    }
+    madvise( mapped, bytes, MADV_SEQUENTIAL );
+
+    vector< int > ids;
+    try
+    {
+        if ( width == sizeof( int32_t ) )
         {
-            totalLength += numInEachRank[ i ];
+            const auto* raw = ( const int32_t* )mapped;
+            ids.assign( raw, raw + bytes / width );
         }
+        else
+        {
+            ids = narrow_ids( ( const int64_t* )mapped, bytes / width, idFilename );
+        }
+    }
+    catch ( ... )
+    {
+        munmap( mapped, bytes );
+        throw;
+    }
+    munmap( mapped, bytes );
+    return ids;
+}
 
-        // the offset of the local mpi rank, used for variable length mpi gathering
-        int localOffset = 0;
-        for ( int i = 0; i < rank; ++i )
+/**
+ * @brief Read the ids in a dataset of an HDF5 file, in any integer type and any shape.
+ *
+ * @param idFilename filename of the id list file
+ * @param dataset name of the dataset
+ * @return std::vector<int> of the ids
+ */
+static auto read_hdf5_ids( const string& idFilename, const string& dataset ) -> vector< int >
+{
+    const hid_t file = H5Fopen( idFilename.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT );
+    if ( file < 0 )
+    {
+        ERROR( "Failed to open the particle ID file: [%s]", idFilename.c_str() );
+        throw "Failed to open the particle ID file!";
+    }
+    const hid_t data = H5Dopen2( file, dataset.c_str(), H5P_DEFAULT );
+    if ( data < 0 )
+    {
+        H5Fclose( file );
+        ERROR( "Dataset [%s] not found in the particle ID file [%s].", dataset.c_str(),
+               idFilename.c_str() );
+        throw "Particle ID dataset not found!";
+    }
+    const hid_t space = H5Dget_space( data );
+    const auto  idNum = ( size_t )max( H5Sget_simple_extent_npoints( space ), ( hssize_t )0 );
+    vector< int64_t > raw( idNum );
+    // the ids are converted to 64-bit integers by HDF5, then checked before narrowing to int
+    const herr_t status = idNum == 0 ? 0
+                                     : H5Dread( data, H5T_NATIVE_INT64, H5S_ALL, H5S_ALL,
+                                                H5P_DEFAULT, raw.data() );
+    H5Sclose( space );
+    H5Dclose( data );
+    H5Fclose( file );
+    if ( status < 0 )
+    {
+        ERROR( "Failed to read the dataset [%s] in the particle ID file [%s].", dataset.c_str(),
+               idFilename.c_str() );
+        throw "Failed to read the particle ID dataset!";
+    }
+    return narrow_ids( raw.data(), idNum, idFilename );
+}
+
+/**
+ * @brief Read the ids in the id list file. The file is only read in the root rank, then the ids
+ * are broadcast to all ranks, so it must be called in all ranks.
+ *
+ * @param orbitPara parameters of the orbital log, which give the id list file and its format
+ * @return std::vector<int> of the unique ids in ascending order.
+ */
+auto orbit_selector::id_read( const orbit& orbitPara ) -> vector< int >
+{
+    int rank;
+    MPI_Comm_rank( MPI_COMM_WORLD, &rank );
+    vector< int > ids;
+    long          idNum = 0;  // -1 if the root rank fails to read the file
+    if ( rank == 0 )
+    {
+        try
         {
-            localOffset += numInEachRank[ i ];
+            switch ( orbitPara.idformat )
+            {
+            case orbit::id_file_format::TEXT:
+                ids = read_text_ids( orbitPara.idfile );
+                break;
+            case orbit::id_file_format::INT32:
+                ids = read_binary_ids( orbitPara.idfile, sizeof( int32_t ) );
+                break;
+            case orbit::id_file_format::INT64:
+                ids = read_binary_ids( orbitPara.idfile, sizeof( int64_t ) );
+                break;
+            case orbit::id_file_format::HDF5:
+                ids = read_hdf5_ids( orbitPara.idfile, orbitPara.iddataset );
+                break;
+            }
+            // Remove the possible repeated values
+            sort( ids.begin(), ids.end() );
+            ids.erase( unique( ids.begin(), ids.end() ), ids.end() );
+            idNum = ids.size() <= INT_MAX ? ( long )ids.size() : -1;
         }
+        catch ( ... )
+        {
+            idNum = -1;
+        }
+    }
+
+    MPI_Bcast( &idNum, 1, MPI_LONG, 0, MPI_COMM_WORLD );
+    if ( idNum < 0 )
+    {
+        MPI_ERROR( rank, "Failed to read the particle ID file: [%s]", orbitPara.idfile.c_str() );
+        throw "Failed to read the particle ID file!";
+    }
+    ids.resize( idNum );
+    MPI_Bcast( ids.data(), ( int )idNum, MPI_INT, 0, MPI_COMM_WORLD );
+    return ids;
+}
+
+orbit_selector::orbit_selector( const runtime_para& para ) : para( para )
+{
+    ;
+}
+
+/**
+ * @brief Whether a particle is a target of the orbital log: in the id list file, or of the sampled
+ * types and sampled by its id.
+ *
+ * @param particleID the particle id
+ * @param partType the PartType of the particle
+ * @return whether the particle is a target
+ */
+auto orbit_selector::is_target( const int particleID, const int partType ) const -> bool
+{
+    if ( para.orbit->method == otf::orbit::id_selection_method::TXTFILE )
+    {
+        return targetIDs->contains( particleID );
+    }
+    const auto& types = para.orbit->sampleTypes;
+    return find( types.begin(), types.end(), partType ) != types.end()
+           and id_sampled( particleID, para.orbit->seed, para.orbit->fraction );
+}
 
-        // the array of offset values
-        const unique_ptr< int[] > offsets( new int[ size ]() );
-        MPI_Allgather( &localOffset, 1, MPI_INT, offsets.get(), 1, MPI_INT, MPI_COMM_WORLD );
+/**
+ * @brief Find the local indexes of the target particles. The particles found in the last call are
+ * verified by their ids at their last indexes first, and if all of them are still there in all
+ * ranks, the full membership scan of the local particles is skipped. So the cost of most steps is
+ * O(number of target particles), rather than O(number of local particles).
+ *
+ * @param particleNumber number of particles in the local mpi rank
+ * @param particleID particle ids
+ * @param partType PartTypes of particles
+ * @param reordered whether the local particles are known to be reordered since the last call
+ * @return the local indexes of the target particles, in ascending order
+ */
+auto orbit_selector::find_targets( const unsigned particleNumber, const int* particleID,
+                                   const int* partType, const bool reordered ) const
+    -> const vector< unsigned >&
+{
+    if ( not targetIDs and para.orbit->method == otf::orbit::id_selection_method::TXTFILE )
+    {
+        targetIDs = make_unique< id_set >( id_read( *para.orbit ) );
+    }
 
-        // the global target ids
-        vector< int > globalTargetIds( totalLength );
-        MPI_Allgatherv( localTargetIDs.data(), localLength, MPI_INT, globalTargetIds.data(),
-                        numInEachRank.get(), offsets.get(), MPI_INT, MPI_COMM_WORLD );
-        std::swap( globalTargetIds, targetIDs );
+    // verify the hints: {number of hits, number of ranks with a miss}, where the types are also
+    // verified for the sampling, as a particle may change its type (e.g. gas to star) with its id
+    const bool sampled     = para.orbit->method != otf::orbit::id_selection_method::TXTFILE;
+    int        counts[ 2 ] = { 0, reordered or lastFoundNum < 0 ? 1 : 0 };
+    for ( auto i = 0UL; i < hintIndexes.size() and counts[ 1 ] == 0; ++i )
+    {
+        const unsigned index = hintIndexes[ i ];
+        if ( index < particleNumber and particleID[ index ] == hintIDs[ i ]
+             and ( not sampled or partType[ index ] == hintTypes[ i ] ) )
+        {
+            ++counts[ 0 ];
+        }
+        else
+        {
+            counts[ 1 ] = 1;
+        }
     }
-    else  // txt file
+    // the particles migrated from other ranks are not in the hints, so all hints of all ranks must
+    // be hit to skip the full scan
+    MPI_Allreduce( MPI_IN_PLACE, counts, 2, MPI_INT, MPI_SUM, MPI_COMM_WORLD );
+    if ( counts[ 1 ] == 0 and counts[ 0 ] == lastFoundNum )
     {
-        // read from a txt file
-        targetIDs = id_read( para.orbit->idfile );
+        return hintIndexes;
     }
-    return targetIDs;
+
+    // full scan with the membership lookup
+    ++fullScanNum;
+    hintIndexes.clear();
+    hintIDs.clear();
+    hintTypes.clear();
+    for ( auto i = 0U; i < particleNumber; ++i )
+    {
+        if ( is_target( particleID[ i ], partType[ i ] ) )
+        {
+            hintIndexes.push_back( i );
+            hintIDs.push_back( particleID[ i ] );
+            hintTypes.push_back( partType[ i ] );
+        }
+    }
+    long foundNum = ( long )hintIndexes.size();
+    MPI_Allreduce( MPI_IN_PLACE, &foundNum, 1, MPI_LONG, MPI_SUM, MPI_COMM_WORLD );
+    lastFoundNum = foundNum;
+    return hintIndexes;
 }
 
 /**
@@ -193,11 +373,14 @@ auto orbit_selector::extract_target_ids( const unsigned particleNumber, const in
  * @param mass masses of particles
  * @param coordinate coordinates of particles
  * @param velocity velocity of particles
+ * @param reordered whether the local particles are known to be reordered since the last call,
+ * if so, the cached indexes of the target particles are not tried
  * @return the extracted data, restore in a dataContainer object
  */
 auto orbit_selector::select( const unsigned particleNumber, const int* particleID,
                              const int* partType, const double* mass, const double* coordinate,
-                             const double* velocity ) const -> unique_ptr< dataContainer >
+                             const double* velocity, const bool reordered ) const
+    -> unique_ptr< dataContainer >
 {
     if ( not para.orbit->enable )
     {
@@ -205,41 +388,30 @@ auto orbit_selector::select( const unsigned particleNumber, const int* particleI
         return nullptr;
     }
 
-    static vector< int > targetIDs = extract_target_ids( particleNumber, particleID, partType );
+    const auto& indexes = find_targets( particleNumber, particleID, partType, reordered );
 
     // count of found particles
-    unsigned counter = 0;
+    const auto counter = ( unsigned )indexes.size();
 
     // temporary variables restoring extracted data
-    vector< double > tmpMass( particleNumber );
-    vector< int >    tmpId( particleNumber );
-    vector< double > tmpPos( particleNumber * 3 );
-    vector< double > tmpVel( particleNumber * 3 );
+    vector< double > tmpMass( counter );
+    vector< int >    tmpId( counter );
+    vector< double > tmpPos( counter * 3 );
+    vector< double > tmpVel( counter * 3 );
 
-    for ( auto i = 0U; i < particleNumber; ++i )
+    for ( auto j = 0U; j < counter; ++j )
     {
-        // check whether the id is in the target id list
-        if ( find( targetIDs.begin(), targetIDs.end(), particleID[ i ] ) != targetIDs.end() )
-        {
-            tmpMass[ counter ]        = mass[ i ];
-            tmpId[ counter ]          = particleID[ i ];
-            tmpPos[ counter * 3 + 0 ] = coordinate[ i * 3 + 0 ];
-            tmpPos[ counter * 3 + 1 ] = coordinate[ i * 3 + 1 ];
-            tmpPos[ counter * 3 + 2 ] = coordinate[ i * 3 + 2 ];
-            tmpVel[ counter * 3 + 0 ] = velocity[ i * 3 + 0 ];
-            tmpVel[ counter * 3 + 1 ] = velocity[ i * 3 + 1 ];
-            tmpVel[ counter * 3 + 2 ] = velocity[ i * 3 + 2 ];
-            // increase the count of particles found
-            counter++;
-        }
+        const auto i        = indexes[ j ];
+        tmpMass[ j ]        = mass[ i ];
+        tmpId[ j ]          = particleID[ i ];
+        tmpPos[ j * 3 + 0 ] = coordinate[ i * 3 + 0 ];
+        tmpPos[ j * 3 + 1 ] = coordinate[ i * 3 + 1 ];
+        tmpPos[ j * 3 + 2 ] = coordinate[ i * 3 + 2 ];
+        tmpVel[ j * 3 + 0 ] = velocity[ i * 3 + 0 ];
+        tmpVel[ j * 3 + 1 ] = velocity[ i * 3 + 1 ];
+        tmpVel[ j * 3 + 2 ] = velocity[ i * 3 + 2 ];
     }
 
-    // remove the rubish value at the end
-    tmpMass.resize( counter );
-    tmpId.resize( counter );
-    tmpPos.resize( counter * 3 );
-    tmpVel.resize( counter * 3 );
-
     // get the data container
     unique_ptr< dataContainer > container = make_unique< dataContainer >();
     container->count                      = counter;
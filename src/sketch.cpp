@@ -0,0 +1,304 @@
+#include "../include/sketch.hpp"
+#include "../include/myprompt.hpp"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <mpi.h>
+#include <numbers>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+using namespace std;
+
+// the pending values of a bin are merged when there are so many times of the capacity
+static constexpr unsigned long pendingFactor = 4;
+
+/**
+ * @brief Digests in bins, all of them are empty at the beginning.
+ *
+ * @param binNum number of bins
+ * @param compression the delta parameter of the t-digest, the number of centroids is at most
+ * about delta, and the error of the quantiles is about 1 / delta in the middle
+ */
+quantile_sketch::quantile_sketch( const unsigned long binNum, const double compression )
+    : compression( compression ), binNum( binNum ),
+      capacity( ( unsigned long )ceil( compression ) + 2 ),
+      recordLength( headLength + 2 * capacity ), pending( binNum )
+{
+    if ( not( binNum > 0 and compression >= 10 ) )
+    {
+        ERROR( "Get an illegal quantile sketch with %lu bins and compression %g!", binNum,
+               compression );
+        throw invalid_argument( "Illegal quantile sketch." );
+    }
+    records.resize( binNum * recordLength );
+    reset();
+}
+
+/**
+ * @brief Clear all digests, the memory is kept for the next step.
+ */
+void quantile_sketch::reset()
+{
+    fill( records.begin(), records.end(), 0.0 );
+    for ( auto bin = 0UL; bin < binNum; ++bin )
+    {
+        double* record = records.data() + bin * recordLength;
+        record[ 2 ]    = numeric_limits< double >::infinity();
+        record[ 3 ]    = -numeric_limits< double >::infinity();
+        record[ 4 ]    = compression;
+        pending[ bin ].clear();
+    }
+}
+
+/**
+ * @brief Add a weighted value to a bin, which is buffered until there are enough pending values.
+ *
+ * @param bin index of the bin
+ * @param value the value
+ * @param weight weight of the value, the non-positive weights are ignored
+ */
+void quantile_sketch::add( const unsigned long bin, const double value, const double weight )
+{
+    if ( not( weight > 0 ) or isnan( value ) )
+    {
+        return;
+    }
+    pending[ bin ].emplace_back( value, weight );
+    if ( pending[ bin ].size() >= pendingFactor * capacity )
+    {
+        flush( bin );
+    }
+}
+
+/**
+ * @brief Add the weighted values to the bins of their coordinates.
+ *
+ * @param dataNum number of data points
+ * @param coord coordinates of the data points
+ * @param axis the bins
+ * @param values the values to be sketched
+ * @param weights weights of the values, nullptr for the unit weights
+ */
+void quantile_sketch::add( const unsigned long dataNum, const double* coord, const bin_axis& axis,
+                           const double* values, const double* weights )
+{
+    for ( auto i = 0UL; i < dataNum; ++i )
+    {
+        if ( axis.contains( coord[ i ] ) )
+        {
+            add( axis.find_index( coord[ i ] ), values[ i ],
+                 weights == nullptr ? 1 : weights[ i ] );
+        }
+    }
+}
+
+/**
+ * @brief Merge the pending values of a bin into its record.
+ *
+ * @param bin index of the bin
+ */
+void quantile_sketch::flush( const unsigned long bin )
+{
+    auto& values = pending[ bin ];
+    if ( values.empty() )
+    {
+        return;
+    }
+    double* record = records.data() + bin * recordLength;
+    for ( const auto& value : values )
+    {
+        record[ 2 ] = min( record[ 2 ], value.first );
+        record[ 3 ] = max( record[ 3 ], value.first );
+    }
+    compress( record, values );
+    values.clear();
+}
+
+void quantile_sketch::flush_all()
+{
+    for ( auto bin = 0UL; bin < binNum; ++bin )
+    {
+        flush( bin );
+    }
+}
+
+/**
+ * @brief Merge the centroids into a record. All centroids are sorted by their means, then the
+ * adjacent ones are merged as long as the merged one spans no more than one unit of the arcsine
+ * scale function k(q) = delta / (2 pi) * asin(2q - 1). So any two adjacent centroids span more than
+ * one unit, and there are at most delta + 1 centroids.
+ *
+ * @param record the record to be updated, except its min and max
+ * @param centroids the (mean, weight) pairs to be merged, used as a buffer and destroyed
+ */
+void quantile_sketch::compress( double* record, vector< pair< double, double > >& centroids )
+{
+    const auto   num         = ( unsigned long )record[ 0 ];
+    const double compression = record[ 4 ];
+    double*      pairs       = record + headLength;
+    for ( auto i = 0UL; i < num; ++i )
+    {
+        centroids.emplace_back( pairs[ 2 * i ], pairs[ 2 * i + 1 ] );
+    }
+    sort( centroids.begin(), centroids.end() );
+
+    double total = 0;
+    for ( const auto& centroid : centroids )
+    {
+        total += centroid.second;
+    }
+    // the quantile limit of the centroid starting from the quantile q
+    const auto limit = [ compression ]( const double q ) {
+        const double k = compression / ( 2 * numbers::pi ) * asin( 2 * q - 1 ) + 1;
+        return k >= compression / 4 ? 1.0 : ( 1 + sin( 2 * numbers::pi * k / compression ) ) / 2;
+    };
+
+    unsigned long merged = 0;
+    double        mean   = centroids[ 0 ].first;
+    double        weight = centroids[ 0 ].second;
+    double        before = 0;  // weight before the current centroid
+    double        qLimit = limit( 0 );
+    for ( auto i = 1UL; i < centroids.size(); ++i )
+    {
+        if ( ( before + weight + centroids[ i ].second ) / total <= qLimit )
+        {
+            weight += centroids[ i ].second;
+            mean += ( centroids[ i ].first - mean ) * centroids[ i ].second / weight;
+            continue;
+        }
+        pairs[ 2 * merged ]     = mean;
+        pairs[ 2 * merged + 1 ] = weight;
+        ++merged;
+        before += weight;
+        qLimit = limit( before / total );
+        mean   = centroids[ i ].first;
+        weight = centroids[ i ].second;
+    }
+    pairs[ 2 * merged ]     = mean;
+    pairs[ 2 * merged + 1 ] = weight;
+    record[ 0 ]             = ( double )( merged + 1 );
+    record[ 1 ]             = total;
+}
+
+/**
+ * @brief The user-defined MPI reduction: merge each record of in into the one of inout.
+ *
+ * @param in the records to be merged
+ * @param inout the records to be updated
+ * @param len number of records
+ * @param datatype the datatype of a record, which gives the length of the records
+ */
+void quantile_sketch::merge_records( void* in, void* inout, int* len, MPI_Datatype* datatype )
+{
+    int bytes = 0;
+    MPI_Type_size( *datatype, &bytes );
+    const auto recordLength = ( unsigned long )bytes / sizeof( double );
+
+    vector< pair< double, double > > centroids;
+    for ( auto r = 0; r < *len; ++r )
+    {
+        const double* other  = ( const double* )in + r * recordLength;
+        double*       record = ( double* )inout + r * recordLength;
+        const auto    num    = ( unsigned long )other[ 0 ];
+        if ( num == 0 )
+        {
+            continue;
+        }
+        centroids.clear();
+        for ( auto i = 0UL; i < num; ++i )
+        {
+            centroids.emplace_back( other[ headLength + 2 * i ], other[ headLength + 2 * i + 1 ] );
+        }
+        record[ 2 ] = min( record[ 2 ], other[ 2 ] );
+        record[ 3 ] = max( record[ 3 ], other[ 3 ] );
+        compress( record, centroids );
+    }
+}
+
+/**
+ * @brief Merge the digests of all ranks into the root rank, by a single reduction.
+ *
+ * @param mpiRank rank of the current process
+ */
+void quantile_sketch::reduce( const int mpiRank )
+{
+    // not commutative, so the digests are always merged in the same order; the operator and the
+    // datatype are freed after the reduction, as they are cheap to create
+    MPI_Op mergeOp;
+    MPI_Op_create( merge_records, 0, &mergeOp );
+    MPI_Datatype recordType;
+    MPI_Type_contiguous( ( int )recordLength, MPI_DOUBLE, &recordType );
+    MPI_Type_commit( &recordType );
+
+    flush_all();
+    MPI_Reduce( mpiRank == 0 ? MPI_IN_PLACE : records.data(), records.data(), ( int )binNum,
+                recordType, mergeOp, 0, MPI_COMM_WORLD );
+    MPI_Type_free( &recordType );
+    MPI_Op_free( &mergeOp );
+}
+
+/**
+ * @brief Total weight in a bin.
+ *
+ * @param bin index of the bin
+ * @return the total weight
+ */
+auto quantile_sketch::weight( const unsigned long bin ) -> double
+{
+    flush( bin );
+    return records[ bin * recordLength + 1 ];
+}
+
+/**
+ * @brief The value below which the fraction q of the weight in a bin lies, by a linear
+ * interpolation between the centers of the centroids, and between the min (max) and the first
+ * (last) centroid.
+ *
+ * @param bin index of the bin
+ * @param q the fraction, in [0, 1]
+ * @return the quantile, nan for an empty bin
+ */
+auto quantile_sketch::quantile( const unsigned long bin, const double q ) -> double
+{
+    flush( bin );
+    const double* record = records.data() + bin * recordLength;
+    const auto    num    = ( unsigned long )record[ 0 ];
+    const double* pairs  = record + headLength;
+    if ( num == 0 )
+    {
+        return nan( "" );
+    }
+    if ( num == 1 )
+    {
+        return pairs[ 0 ];
+    }
+
+    const double total  = record[ 1 ];
+    const double target = min( max( q, 0.0 ), 1.0 ) * total;
+    // in the left half of the first centroid, or the right half of the last one
+    if ( target < pairs[ 1 ] / 2 )
+    {
+        return record[ 2 ] + ( pairs[ 0 ] - record[ 2 ] ) * target / ( pairs[ 1 ] / 2 );
+    }
+    const double lastWeight = pairs[ 2 * num - 1 ];
+    if ( target > total - lastWeight / 2 )
+    {
+        return record[ 3 ]
+               - ( record[ 3 ] - pairs[ 2 * num - 2 ] ) * ( total - target ) / ( lastWeight / 2 );
+    }
+
+    // between the centers of two adjacent centroids
+    double center = pairs[ 1 ] / 2;  // cumulative weight at the center of the i-th centroid
+    for ( auto i = 0UL; i + 1 < num; ++i )
+    {
+        const double next = center + ( pairs[ 2 * i + 1 ] + pairs[ 2 * i + 3 ] ) / 2;
+        if ( target <= next )
+        {
+            const double fraction = ( target - center ) / ( next - center );
+            return pairs[ 2 * i ] + ( pairs[ 2 * i + 2 ] - pairs[ 2 * i ] ) * fraction;
+        }
+        center = next;
+    }
+    return pairs[ 2 * num - 2 ];
+}
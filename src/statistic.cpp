@@ -1,11 +1,523 @@
 #include "../include/statistic.hpp"
 #include "../include/myprompt.hpp"
+#include "../include/parallel.hpp"
+#include <algorithm>
 #include <cmath>
 #include <cstdlib>
-#include <cstring>
+#include <limits>
 #include <memory>
 #include <mpi.h>
+#include <stdexcept>
+#include <vector>
 using namespace std;
+using otf::parallel_bins;
+
+/**
+ * @brief Running statistics of the data in a bin: number, mean and the sum of squared deviations
+ * from the mean (M2), which are updated with the Welford algorithm.
+ */
+struct welford_bin
+{
+    double count;
+    double mean;
+    double m2;
+};
+
+/**
+ * @brief Add a data point to the running statistics of a bin.
+ *
+ * @param bin the running statistics
+ * @param value value of the data point
+ */
+static inline void welford_add( welford_bin& bin, const double value )
+{
+    const double delta = value - bin.mean;
+    bin.count += 1;
+    bin.mean += delta / bin.count;
+    bin.m2 += delta * ( value - bin.mean );
+}
+
+/**
+ * @brief Merge the running statistics of the bins with the parallel formula of Chan et al.
+ *
+ * @param bins the running statistics to be updated
+ * @param other the running statistics of the same bins from another part of the data
+ * @param size number of the bins
+ */
+static void welford_merge( welford_bin* bins, const welford_bin* other, const unsigned long size )
+{
+    for ( auto i = 0UL; i < size; ++i )
+    {
+        if ( other[ i ].count == 0 )
+        {
+            continue;
+        }
+        if ( bins[ i ].count == 0 )
+        {
+            bins[ i ] = other[ i ];
+            continue;
+        }
+        const double count = bins[ i ].count + other[ i ].count;
+        const double delta = other[ i ].mean - bins[ i ].mean;
+        bins[ i ].mean += delta * other[ i ].count / count;
+        bins[ i ].m2 += other[ i ].m2 + delta * delta * bins[ i ].count * other[ i ].count / count;
+        bins[ i ].count = count;
+    }
+}
+
+/**
+ * @brief User function of the MPI reduction, which merges the running statistics of the bins.
+ *
+ * @param in the running statistics of the bins from another rank
+ * @param inout the running statistics to be updated
+ * @param len number of the bins
+ */
+static void chan_merge( void* in, void* inout, int* len, MPI_Datatype* /*unused*/ )
+{
+    welford_merge( static_cast< welford_bin* >( inout ), static_cast< welford_bin* >( in ),
+                   ( unsigned long )*len );
+}
+
+/**
+ * @brief Merge the running statistics of the bins from all ranks with a single reduction, and get
+ * the standard deviation (without Bessel correction) of each bin.
+ *
+ * @param bins the running statistics of the bins in the local rank
+ * @param binNum number of the bins
+ * @return a unique_ptr pointing to the standard deviations, nan for the empty bins
+ */
+static auto welford_std( welford_bin* bins, const unsigned long binNum ) -> unique_ptr< double[] >
+{
+    // the datatype and the reduction operator are local objects, so they are created and freed in
+    // each call rather than kept until MPI_Finalize
+    MPI_Datatype binType = MPI_DATATYPE_NULL;
+    MPI_Op       mergeOp = MPI_OP_NULL;
+    MPI_Type_contiguous( 3, MPI_DOUBLE, &binType );
+    MPI_Type_commit( &binType );
+    MPI_Op_create( chan_merge, 1, &mergeOp );
+
+    MPI_Allreduce( MPI_IN_PLACE, bins, ( int )binNum, binType, mergeOp, MPI_COMM_WORLD );
+    MPI_Op_free( &mergeOp );
+    MPI_Type_free( &binType );
+
+    auto statisticResutls( make_unique< double[] >( binNum ) );
+    for ( auto i = 0UL; i < binNum; ++i )
+    {
+        statisticResutls[ i ] =
+            bins[ i ].count != 0 ? sqrt( bins[ i ].m2 / bins[ i ].count ) : nan( "" );
+    }
+    return statisticResutls;
+}
+
+/**
+ * @brief The bin of each data point in 1D bins.
+ *
+ * @param coord pointing to the coordinates
+ * @param axis the bins
+ * @return a function that gives the bin of the i-th data point, or -1 if it is out of the bins
+ */
+static auto index1d( const double* coord, const bin_axis& axis )
+{
+    return [ coord, &axis ]( const unsigned long i ) -> long {
+        return axis.contains( coord[ i ] ) ? ( long )axis.find_index( coord[ i ] ) : -1;
+    };
+}
+
+/**
+ * @brief The flat index of the 2D bin of each data point, in row-major order.
+ *
+ * @param xData pointing to the first coordinates
+ * @param xAxis bins of the first coordinate
+ * @param yData pointing to the second coordinates
+ * @param yAxis bins of the second coordinate
+ * @return a function that gives the bin of the i-th data point, or -1 if it is out of the bins
+ */
+static auto index2d( const double* xData, const bin_axis& xAxis, const double* yData,
+                     const bin_axis& yAxis )
+{
+    return [ xData, &xAxis, yData, &yAxis ]( const unsigned long i ) -> long {
+        if ( xAxis.contains( xData[ i ] ) and yAxis.contains( yData[ i ] ) )
+        {
+            return ( long )( xAxis.find_index( xData[ i ] ) * yAxis.bin_num()
+                             + yAxis.find_index( yData[ i ] ) );
+        }
+        return -1;
+    };
+}
+
+/**
+ * @brief The flat index of the 3D bin of each point, in row-major order.
+ *
+ * @param coordinates pointing to the (x, y, z) of the points
+ * @param xAxis bins of the first coordinate
+ * @param yAxis bins of the second coordinate
+ * @param zAxis bins of the third coordinate
+ * @return a function that gives the bin of the i-th point, or -1 if it is out of the bins
+ */
+static auto index3d( const double* coordinates, const bin_axis& xAxis, const bin_axis& yAxis,
+                     const bin_axis& zAxis )
+{
+    return [ coordinates, &xAxis, &yAxis, &zAxis ]( const unsigned long i ) -> long {
+        const double* pos = coordinates + 3 * i;
+        if ( xAxis.contains( pos[ 0 ] ) and yAxis.contains( pos[ 1 ] )
+             and zAxis.contains( pos[ 2 ] ) )
+        {
+            return ( long )( ( xAxis.find_index( pos[ 0 ] ) * yAxis.bin_num()
+                               + yAxis.find_index( pos[ 1 ] ) )
+                                 * zAxis.bin_num()
+                             + zAxis.find_index( pos[ 2 ] ) );
+        }
+        return -1;
+    };
+}
+
+/**
+ * @brief Evenly distributed bins in linear or logarithmic scale.
+ *
+ * @param lowerBound the lower inclusive limit of the bins
+ * @param upperBound the upper exclusive limit of the bins
+ * @param binNum number of the bins
+ * @param scale LINEAR or LOG, where the log scale requires a positive lower bound
+ */
+bin_axis::bin_axis( const double lowerBound, const double upperBound, const unsigned long binNum,
+                    const bin_scale scale )
+    : scale( scale ), lowerBound( lowerBound ), upperBound( upperBound ), binNum( binNum )
+{
+    if ( not( lowerBound < upperBound and binNum > 0 ) )
+    {
+        ERROR( "Get an illegal bin range [%g, %g) with %lu bins!", lowerBound, upperBound,
+               binNum );
+        throw invalid_argument( "Illegal bins." );
+    }
+
+    switch ( scale )
+    {
+    case bin_scale::LINEAR: {
+        factor = binNum / ( upperBound - lowerBound );
+        break;
+    }
+    case bin_scale::LOG: {
+        if ( not( lowerBound > 0 ) )
+        {
+            ERROR( "The lower bound of logarithmic bins should be positive, but get [%g]!",
+                   lowerBound );
+            throw invalid_argument( "Illegal logarithmic bins." );
+        }
+        logLowerBound = log( lowerBound );
+        factor        = binNum / ( log( upperBound ) - logLowerBound );
+        edges.resize( binNum + 1 );
+        for ( auto i = 0UL; i < binNum; ++i )
+        {
+            edges[ i ] = exp( logLowerBound + i / factor );
+        }
+        edges[ 0 ]      = lowerBound;
+        edges[ binNum ] = upperBound;
+        break;
+    }
+    default: {
+        ERROR( "Arbitrary bins should be constructed from their edges!" );
+        throw invalid_argument( "Illegal bin scale." );
+    }
+    }
+}
+
+/**
+ * @brief Bins with arbitrary edges. A uniform lookup table whose cells are not wider than half of
+ * the narrowest bin is built, such that a value is at most one bin away from the bin of its cell.
+ *
+ * @param edges the strictly increasing edges of the bins, there should be at least two of them
+ */
+bin_axis::bin_axis( const vector< double >& edges )
+    : scale( bin_scale::CUSTOM ), lowerBound( edges.empty() ? 0 : edges.front() ),
+      upperBound( edges.empty() ? 0 : edges.back() ),
+      binNum( edges.empty() ? 0 : edges.size() - 1 ), edges( edges )
+{
+    double minWidth = upperBound - lowerBound;
+    for ( auto i = 0UL; i < binNum; ++i )
+    {
+        minWidth = min( minWidth, edges[ i + 1 ] - edges[ i ] );
+    }
+    if ( not( binNum > 0 and minWidth > 0 and isfinite( lowerBound ) and isfinite( upperBound ) ) )
+    {
+        ERROR( "The bin edges should be finite and strictly increasing, with at least 2 edges!" );
+        throw invalid_argument( "Illegal bin edges." );
+    }
+
+    const double  cellNumGuess = ceil( 2 * ( upperBound - lowerBound ) / minWidth );
+    unsigned long cellNum      = cellNumGuess < maxLookupCells ? cellNumGuess : maxLookupCells;
+    cellNum                    = max( cellNum, binNum );
+    factor                     = cellNum / ( upperBound - lowerBound );
+    lookup.resize( cellNum );
+    unsigned long index = 0;
+    for ( auto i = 0UL; i < cellNum; ++i )
+    {
+        const double cellLowerEdge = lowerBound + i / factor;
+        while ( index + 1 < binNum and cellLowerEdge >= edges[ index + 1 ] )
+        {
+            ++index;
+        }
+        lookup[ i ] = index;
+    }
+}
+
+/**
+ * @brief The edges of the bins.
+ *
+ * @param index index of the edge, from 0 (the lower bound) to binNum (the upper bound)
+ * @return the edge
+ */
+auto bin_axis::edge( const unsigned long index ) const -> double
+{
+    if ( scale == bin_scale::LINEAR )
+    {
+        return index == binNum ? upperBound
+                               : lowerBound + index * ( ( upperBound - lowerBound ) / binNum );
+    }
+    return edges[ index ];
+}
+
+/**
+ * @brief The centers of the bins, which is the geometric mean of the edges for the log scale.
+ *
+ * @param index index of the bin
+ * @return the center
+ */
+auto bin_axis::center( const unsigned long index ) const -> double
+{
+    if ( scale == bin_scale::LOG )
+    {
+        return sqrt( edges[ index ] * edges[ index + 1 ] );
+    }
+    return 0.5 * ( edge( index ) + edge( index + 1 ) );
+}
+
+/**
+ * @brief Accumulator of 1D bins.
+ *
+ * @param axis the bins
+ * @param quantityNum number of quantities
+ * @param secondMoments whether accumulate the second moments of the quantities
+ */
+binned_accumulator::binned_accumulator( const bin_axis& axis, const unsigned long quantityNum,
+                                        const bool secondMoments )
+    : axes{ axis }, quantityNum( quantityNum ), secondMoments( secondMoments ),
+      binNum( axis.bin_num() ), binLength( 2 + ( secondMoments ? 2 : 1 ) * quantityNum ),
+      bins( binNum * binLength, 0 )
+{
+}
+
+/**
+ * @brief Accumulator of 2D bins, in row-major order.
+ *
+ * @param xAxis bins of the first coordinate
+ * @param yAxis bins of the second coordinate
+ * @param quantityNum number of quantities
+ * @param secondMoments whether accumulate the second moments of the quantities
+ */
+binned_accumulator::binned_accumulator( const bin_axis& xAxis, const bin_axis& yAxis,
+                                        const unsigned long quantityNum,
+                                        const bool          secondMoments )
+    : axes{ xAxis, yAxis }, quantityNum( quantityNum ), secondMoments( secondMoments ),
+      binNum( xAxis.bin_num() * yAxis.bin_num() ),
+      binLength( 2 + ( secondMoments ? 2 : 1 ) * quantityNum ), bins( binNum * binLength, 0 )
+{
+}
+
+/**
+ * @brief Accumulate the i-th data point in a bin, where the weighted means and the sums of squared
+ * deviations are updated with the weighted Welford algorithm.
+ *
+ * @param bin pointing to the first value of the bin
+ * @param i index of the data point
+ * @param weights pointing to the weights, unit weights if nullptr
+ * @param quantities pointers to the quantities
+ */
+void binned_accumulator::accumulate( double* bin, const unsigned long i, const double* weights,
+                                     const double* const* quantities )
+{
+    const double        weight = weights != nullptr ? weights[ i ] : 1;
+    const unsigned long step   = secondMoments ? 2 : 1;
+    bin[ 0 ] += 1;
+    if ( weight == 0 )  // nothing to the moments
+    {
+        return;
+    }
+    bin[ 1 ] += weight;
+    for ( auto j = 0UL; j < quantityNum; ++j )
+    {
+        const double value = quantities[ j ][ i ];
+        double&      mean  = bin[ 2 + step * j ];
+        const double delta = value - mean;
+        mean += delta * weight / bin[ 1 ];
+        if ( secondMoments )
+        {
+            bin[ 3 + step * j ] += weight * delta * ( value - mean );
+        }
+    }
+}
+
+/**
+ * @brief Merge the bins of another part of the data into the bins, with the parallel formula of
+ * Chan et al. for the weighted means and the sums of squared deviations.
+ *
+ * @param bins the bins to be updated
+ * @param other the same bins from another part of the data
+ * @param size number of the values in the bins
+ * @param binLength number of the values in each bin
+ * @param step 2 with the second moments, otherwise 1
+ */
+static void merge_moments( double* bins, const double* other, const unsigned long size,
+                           const unsigned long binLength, const unsigned long step )
+{
+    for ( auto offset = 0UL; offset < size; offset += binLength )
+    {
+        double*       bin   = bins + offset;
+        const double* part  = other + offset;
+        const double  total = bin[ 1 ] + part[ 1 ];
+        bin[ 0 ] += part[ 0 ];
+        if ( part[ 1 ] == 0 )
+        {
+            continue;
+        }
+        for ( auto j = 2UL; j < binLength; j += step )
+        {
+            const double delta = part[ j ] - bin[ j ];
+            if ( step == 2 )
+            {
+                bin[ j + 1 ] += part[ j + 1 ] + delta * delta * bin[ 1 ] * part[ 1 ] / total;
+            }
+            bin[ j ] += delta * part[ 1 ] / total;
+        }
+        bin[ 1 ] = total;
+    }
+}
+
+/**
+ * @brief User functions of the MPI reduction, which merge the bins with or without the second
+ * moments, the length of each bin is given by the size of the datatype.
+ */
+static void merge_first_moments( void* in, void* inout, int* len, MPI_Datatype* binType )
+{
+    int bytes = 0;
+    MPI_Type_size( *binType, &bytes );
+    const unsigned long binLength = bytes / sizeof( double );
+    merge_moments( static_cast< double* >( inout ), static_cast< double* >( in ),
+                   *len * binLength, binLength, 1 );
+}
+
+static void merge_second_moments( void* in, void* inout, int* len, MPI_Datatype* binType )
+{
+    int bytes = 0;
+    MPI_Type_size( *binType, &bytes );
+    const unsigned long binLength = bytes / sizeof( double );
+    merge_moments( static_cast< double* >( inout ), static_cast< double* >( in ),
+                   *len * binLength, binLength, 2 );
+}
+
+/**
+ * @brief Add data points to the 1D bins, the points out of the bins are ignored.
+ *
+ * @param dataNum number of data points
+ * @param coord pointing to the coordinates
+ * @param weights pointing to the weights, unit weights if nullptr
+ * @param quantities pointers to the quantities
+ */
+void binned_accumulator::add( const unsigned long dataNum, const double* coord,
+                              const double* weights, const double* const* quantities )
+{
+    parallel_bins::deposit(
+        dataNum, binNum, binLength, bins.data(), index1d( coord, axes[ 0 ] ),
+        [ this, weights, quantities ]( double* bin, unsigned long i ) {
+            accumulate( bin, i, weights, quantities );
+        },
+        [ this ]( double* merged, const double* other, unsigned long size ) {
+            merge_moments( merged, other, size, binLength, secondMoments ? 2 : 1 );
+        } );
+}
+
+/**
+ * @brief Add data points to the 2D bins, the points out of the bins are ignored.
+ *
+ * @param dataNum number of data points
+ * @param xData pointing to the first coordinates
+ * @param yData pointing to the second coordinates
+ * @param weights pointing to the weights, unit weights if nullptr
+ * @param quantities pointers to the quantities
+ */
+void binned_accumulator::add( const unsigned long dataNum, const double* xData,
+                              const double* yData, const double* weights,
+                              const double* const* quantities )
+{
+    parallel_bins::deposit(
+        dataNum, binNum, binLength, bins.data(), index2d( xData, axes[ 0 ], yData, axes[ 1 ] ),
+        [ this, weights, quantities ]( double* bin, unsigned long i ) {
+            accumulate( bin, i, weights, quantities );
+        },
+        [ this ]( double* merged, const double* other, unsigned long size ) {
+            merge_moments( merged, other, size, binLength, secondMoments ? 2 : 1 );
+        } );
+}
+
+/**
+ * @brief Merge the bins of all ranks in the root rank, with a single reduction in place.
+ *
+ * @param mpiRank rank of the current process
+ */
+void binned_accumulator::reduce( const int mpiRank )
+{
+    // the datatype and the reduction operator are created and freed in each call, as in welford_std
+    MPI_Datatype binType = MPI_DATATYPE_NULL;
+    MPI_Op       mergeOp = MPI_OP_NULL;
+    MPI_Type_contiguous( ( int )binLength, MPI_DOUBLE, &binType );
+    MPI_Type_commit( &binType );
+    MPI_Op_create( secondMoments ? merge_second_moments : merge_first_moments, 1, &mergeOp );
+
+    MPI_Reduce( mpiRank == 0 ? MPI_IN_PLACE : bins.data(), bins.data(), ( int )binNum, binType,
+                mergeOp, 0, MPI_COMM_WORLD );
+    MPI_Op_free( &mergeOp );
+    MPI_Type_free( &binType );
+}
+
+/**
+ * @brief Clear the bins for the next step, the buffer is kept.
+ */
+void binned_accumulator::reset()
+{
+    fill( bins.begin(), bins.end(), 0.0 );
+}
+
+auto binned_accumulator::count( const unsigned long bin ) const -> double
+{
+    return bins[ bin * binLength ];
+}
+
+auto binned_accumulator::weight( const unsigned long bin ) const -> double
+{
+    return bins[ bin * binLength + 1 ];
+}
+
+auto binned_accumulator::mean( const unsigned long bin, const unsigned long quantity ) const
+    -> double
+{
+    const double* values = bins.data() + bin * binLength;
+    return values[ 1 ] != 0 ? values[ 2 + ( secondMoments ? 2 : 1 ) * quantity ] : nan( "" );
+}
+
+auto binned_accumulator::mean_square( const unsigned long bin, const unsigned long quantity ) const
+    -> double
+{
+    const double average   = mean( bin, quantity );
+    const double deviation = dispersion( bin, quantity );
+    return average * average + deviation * deviation;
+}
+
+auto binned_accumulator::dispersion( const unsigned long bin, const unsigned long quantity ) const
+    -> double
+{
+    const double* values = bins.data() + bin * binLength;
+    return values[ 1 ] != 0 and secondMoments ? sqrt( values[ 3 + 2 * quantity ] / values[ 1 ] )
+                                              : nan( "" );
+}
 
 /**
  * @brief 2D binning statistics with chosen method, support count, sum, mean and standard deviation.
@@ -28,24 +540,40 @@ auto statistic::bin2d( const int mpiRank, const double* xData, const double xLow
                        const double yLowerBound, const double yUpperBound,
                        const unsigned long yBinNum, const statistic_method method,
                        const unsigned long dataNum, const double* data ) -> unique_ptr< double[] >
+{
+    return bin2d( mpiRank, xData, bin_axis( xLowerBound, xUpperBound, xBinNum ), yData,
+                  bin_axis( yLowerBound, yUpperBound, yBinNum ), method, dataNum, data );
+}
+
+/**
+ * @brief 2D binning statistics with chosen method and arbitrary bins.
+ *
+ * @param xData pointing to the first coordinates
+ * @param xAxis bins of the first coordinate
+ * @param yData pointing to the second coordinates
+ * @param yAxis bins of the second coordinate
+ * @param method statistic method
+ * @param dataNum number of data points to be analyzed
+ * @param data pointing to target data points
+ * @return a unique_ptr pointing to the 1D array of the 2D resutls, in row-major order
+ */
+auto statistic::bin2d( const int mpiRank, const double* xData, const bin_axis& xAxis,
+                       const double* yData, const bin_axis& yAxis, const statistic_method method,
+                       const unsigned long dataNum, const double* data ) -> unique_ptr< double[] >
 {
     switch ( method )
     {
     case statistic_method::COUNT: {
-        return bin2dcount( mpiRank, xData, xLowerBound, xUpperBound, xBinNum, yData, yLowerBound,
-                           yUpperBound, yBinNum, dataNum );
+        return bin2dcount( mpiRank, xData, xAxis, yData, yAxis, dataNum );
     }
     case statistic_method::SUM: {
-        return bin2dsum( mpiRank, xData, xLowerBound, xUpperBound, xBinNum, yData, yLowerBound,
-                         yUpperBound, yBinNum, dataNum, data );
+        return bin2dsum( mpiRank, xData, xAxis, yData, yAxis, dataNum, data );
     }
     case statistic_method::MEAN: {
-        return bin2dmean( mpiRank, xData, xLowerBound, xUpperBound, xBinNum, yData, yLowerBound,
-                          yUpperBound, yBinNum, dataNum, data );
+        return bin2dmean( mpiRank, xData, xAxis, yData, yAxis, dataNum, data );
     }
     case statistic_method::STD: {
-        return bin2dstd( xData, xLowerBound, xUpperBound, xBinNum, yData, yLowerBound, yUpperBound,
-                         yBinNum, dataNum, data );
+        return bin2dstd( xData, xAxis, yData, yAxis, dataNum, data );
     }
     default: {
         ERROR( "Get an unsupported statistic method!" );
@@ -60,25 +588,20 @@ auto statistic::bin2d( const int mpiRank, const double* xData, const double xLow
  * @brief 2D binning statistics for count.
  *
  * @param xData pointing to the first coordinates
- * @param xLowerBound the lower inclusive limit of the first coordinates to be analyzed
- * @param xUpperBound the upper exclusive limit of the first coordinates to be analyzed
- * @param xBinNum binnum of the first coordinate
+ * @param xAxis bins of the first coordinate
  * @param yData pointing to the second coordinates
- * @param yLowerBound the lower inclusive limit of the second coordinates to be analyzed
- * @param yUpperBound the upper exclusive limit of the second coordinates to be analyzed
- * @param yBinNum binnum of the second coordinate
+ * @param yAxis bins of the second coordinate
  * @param dataNum number of data points to be analyzed
  * @return a unique_ptr pointing to the 1D array of the 2D resutls, in row-major order
  */
-auto statistic::bin2dcount( const int mpiRank, const double* xData, const double xLowerBound,
-                            const double xUpperBound, const unsigned long xBinNum,
-                            const double* yData, const double yLowerBound, const double yUpperBound,
-                            const unsigned long yBinNum,
+auto statistic::bin2dcount( const int mpiRank, const double* xData, const bin_axis& xAxis,
+                            const double* yData, const bin_axis& yAxis,
                             const unsigned long dataNum ) -> unique_ptr< double[] >
 
 {
-    static unsigned long     idx = 0;
-    static unsigned long     idy = 0;
+    const unsigned long xBinNum = xAxis.bin_num();
+    const unsigned long yBinNum = yAxis.bin_num();
+
     auto                     statisticResutls( make_unique< double[] >( xBinNum * yBinNum ) );
     auto                     count( make_unique< unsigned[] >( xBinNum * yBinNum ) );
     unique_ptr< unsigned[] > countRecv = nullptr;
@@ -88,16 +611,9 @@ auto statistic::bin2dcount( const int mpiRank, const double* xData, const double
         countRecv = make_unique< unsigned[] >( xBinNum * yBinNum );
     }
 
-    for ( auto i = 0UL; i < dataNum; ++i )
-    {
-        if ( xData[ i ] >= xLowerBound and xData[ i ] < xUpperBound and yData[ i ] >= yLowerBound
-             and yData[ i ] < yUpperBound )
-        {
-            idx = find_index( xLowerBound, xUpperBound, xBinNum, xData[ i ] );
-            idy = find_index( yLowerBound, yUpperBound, yBinNum, yData[ i ] );
-            ++count[ idx * yBinNum + idy ];
-        }
-    }
+    parallel_bins::deposit( dataNum, xBinNum * yBinNum, 1, count.get(),
+                            index2d( xData, xAxis, yData, yAxis ),
+                            []( unsigned* bin, unsigned long ) { ++*bin; } );
 
     MPI_Reduce( count.get(), countRecv.get(), xBinNum * yBinNum, MPI_UNSIGNED, MPI_SUM, 0,
                 MPI_COMM_WORLD );
@@ -112,30 +628,26 @@ auto statistic::bin2dcount( const int mpiRank, const double* xData, const double
     return statisticResutls;
 }
 
+
 /**
  * @brief 2D binning statistics for summation.
  *
  * @param xData pointing to the first coordinates
- * @param xLowerBound the lower inclusive limit of the first coordinates to be analyzed
- * @param xUpperBound the upper exclusive limit of the first coordinates to be analyzed
- * @param xBinNum binnum of the first coordinate
+ * @param xAxis bins of the first coordinate
  * @param yData pointing to the second coordinates
- * @param yLowerBound the lower inclusive limit of the second coordinates to be analyzed
- * @param yUpperBound the upper exclusive limit of the second coordinates to be analyzed
- * @param yBinNum binnum of the second coordinate
+ * @param yAxis bins of the second coordinate
  * @param dataNum number of data points to be analyzed
  * @param data pointing to target data points
  * @return a unique_ptr pointing to the 1D array of the 2D resutls, in row-major order
  */
-auto statistic::bin2dsum( const int mpiRank, const double* xData, const double xLowerBound,
-                          const double xUpperBound, const unsigned long xBinNum,
-                          const double* yData, const double yLowerBound, const double yUpperBound,
-                          const unsigned long yBinNum, const unsigned long dataNum,
+auto statistic::bin2dsum( const int mpiRank, const double* xData, const bin_axis& xAxis,
+                          const double* yData, const bin_axis& yAxis, const unsigned long dataNum,
                           const double* data ) -> unique_ptr< double[] >
 
 {
-    static unsigned long   idx = 0;
-    static unsigned long   idy = 0;
+    const unsigned long xBinNum = xAxis.bin_num();
+    const unsigned long yBinNum = yAxis.bin_num();
+
     auto                   statisticResutls( make_unique< double[] >( xBinNum * yBinNum ) );
     auto                   sum( make_unique< double[] >( xBinNum * yBinNum ) );
     unique_ptr< double[] > sumRecv = nullptr;
@@ -145,16 +657,9 @@ auto statistic::bin2dsum( const int mpiRank, const double* xData, const double x
         sumRecv = make_unique< double[] >( xBinNum * yBinNum );
     }
 
-    for ( auto i = 0UL; i < dataNum; ++i )
-    {
-        if ( xData[ i ] >= xLowerBound and xData[ i ] < xUpperBound and yData[ i ] >= yLowerBound
-             and yData[ i ] < yUpperBound )
-        {
-            idx = find_index( xLowerBound, xUpperBound, xBinNum, xData[ i ] );
-            idy = find_index( yLowerBound, yUpperBound, yBinNum, yData[ i ] );
-            sum[ idx * yBinNum + idy ] += data[ i ];
-        }
-    }
+    parallel_bins::deposit( dataNum, xBinNum * yBinNum, 1, sum.get(),
+                            index2d( xData, xAxis, yData, yAxis ),
+                            [ data ]( double* bin, unsigned long i ) { *bin += data[ i ]; } );
 
     MPI_Reduce( sum.get(), sumRecv.get(), xBinNum * yBinNum, MPI_DOUBLE, MPI_SUM, 0,
                 MPI_COMM_WORLD );
@@ -173,61 +678,39 @@ auto statistic::bin2dsum( const int mpiRank, const double* xData, const double x
  * @brief 2D binning statistics for mean values.
  *
  * @param xData pointing to the first coordinates
- * @param xLowerBound the lower inclusive limit of the first coordinates to be analyzed
- * @param xUpperBound the upper exclusive limit of the first coordinates to be analyzed
- * @param xBinNum binnum of the first coordinate
+ * @param xAxis bins of the first coordinate
  * @param yData pointing to the second coordinates
- * @param yLowerBound the lower inclusive limit of the second coordinates to be analyzed
- * @param yUpperBound the upper exclusive limit of the second coordinates to be analyzed
- * @param yBinNum binnum of the second coordinate
+ * @param yAxis bins of the second coordinate
  * @param dataNum number of data points to be analyzed
  * @param data pointing to target data points
  * @return a unique_ptr pointing to the 1D array of the 2D resutls, in row-major order
  */
-auto statistic::bin2dmean( const int mpiRank, const double* xData, const double xLowerBound,
-                           const double xUpperBound, const unsigned long xBinNum,
-                           const double* yData, const double yLowerBound, const double yUpperBound,
-                           const unsigned long yBinNum, const unsigned long dataNum,
+auto statistic::bin2dmean( const int mpiRank, const double* xData, const bin_axis& xAxis,
+                           const double* yData, const bin_axis& yAxis, const unsigned long dataNum,
                            const double* data ) -> unique_ptr< double[] >
 {
-    static unsigned long idx = 0;
-    static unsigned long idy = 0;
-    auto                 statisticResutls( make_unique< double[] >( xBinNum * yBinNum ) );
-    auto                 sum( make_unique< double[] >( xBinNum * yBinNum ) );
-    auto                 count( make_unique< unsigned[] >( xBinNum * yBinNum ) );
-    auto                 sumRecv( make_unique< double[] >( xBinNum * yBinNum ) );
-    auto                 countRecv( make_unique< unsigned[] >( xBinNum * yBinNum ) );
+    const unsigned long binNum = xAxis.bin_num() * yAxis.bin_num();
 
-    if ( mpiRank == 0 )
-    {
-        sumRecv   = make_unique< double[] >( xBinNum * yBinNum );
-        countRecv = make_unique< unsigned[] >( xBinNum * yBinNum );
-    }
+    // (count, sum) of each bin, reduced together
+    auto statisticResutls( make_unique< double[] >( binNum ) );
+    auto bins( make_unique< double[] >( 2 * binNum ) );
+    auto binsRecv( make_unique< double[] >( 2 * binNum ) );
 
-    for ( auto i = 0UL; i < dataNum; ++i )
-    {
-        if ( xData[ i ] >= xLowerBound and xData[ i ] < xUpperBound and yData[ i ] >= yLowerBound
-             and yData[ i ] < yUpperBound )
-        {
-            idx = find_index( xLowerBound, xUpperBound, xBinNum, xData[ i ] );
-            idy = find_index( yLowerBound, yUpperBound, yBinNum, yData[ i ] );
-            ++count[ idx * yBinNum + idy ];
-            sum[ idx * yBinNum + idy ] += data[ i ];
-        }
-    }
+    parallel_bins::deposit( dataNum, binNum, 2, bins.get(), index2d( xData, xAxis, yData, yAxis ),
+                            [ data ]( double* bin, unsigned long i ) {
+                                bin[ 0 ] += 1;
+                                bin[ 1 ] += data[ i ];
+                            } );
 
-    MPI_Reduce( count.get(), countRecv.get(), xBinNum * yBinNum, MPI_UNSIGNED, MPI_SUM, 0,
-                MPI_COMM_WORLD );
-    MPI_Reduce( sum.get(), sumRecv.get(), xBinNum * yBinNum, MPI_DOUBLE, MPI_SUM, 0,
-                MPI_COMM_WORLD );
+    MPI_Reduce( bins.get(), binsRecv.get(), 2 * binNum, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD );
 
     if ( mpiRank == 0 )
     {
-        for ( auto i = 0U; i < xBinNum * yBinNum; ++i )
+        for ( auto i = 0U; i < binNum; ++i )
         {
-            if ( count[ i ] != 0 )
+            if ( binsRecv[ 2 * i ] != 0 )
             {
-                statisticResutls[ i ] = sumRecv[ i ] / countRecv[ i ];
+                statisticResutls[ i ] = binsRecv[ 2 * i + 1 ] / binsRecv[ 2 * i ];
             }
             else
             {
@@ -243,100 +726,28 @@ auto statistic::bin2dmean( const int mpiRank, const double* xData, const double
  * @brief 2D binning statistics for standard deviation, without Bessel correction.
  *
  * @param xData pointing to the first coordinates
- * @param xLowerBound the lower inclusive limit of the first coordinates to be analyzed
- * @param xUpperBound the upper exclusive limit of the first coordinates to be analyzed
- * @param xBinNum binnum of the first coordinate
+ * @param xAxis bins of the first coordinate
  * @param yData pointing to the second coordinates
- * @param yLowerBound the lower inclusive limit of the second coordinates to be analyzed
- * @param yUpperBound the upper exclusive limit of the second coordinates to be analyzed
- * @param yBinNum binnum of the second coordinate
+ * @param yAxis bins of the second coordinate
  * @param dataNum number of data points to be analyzed
  * @param data pointing to target data points
  * @return a unique_ptr pointing to the 1D array of the 2D resutls, in row-major order
  */
-auto statistic::bin2dstd( const double* xData, const double xLowerBound, const double xUpperBound,
-                          const unsigned long xBinNum, const double* yData,
-                          const double yLowerBound, const double yUpperBound,
-                          const unsigned long yBinNum, const unsigned long dataNum,
+auto statistic::bin2dstd( const double* xData, const bin_axis& xAxis, const double* yData,
+                          const bin_axis& yAxis, const unsigned long dataNum,
                           const double* data ) -> unique_ptr< double[] >
 
 {
-    static unsigned long idx = 0;
-    static unsigned long idy = 0;
-    auto                 statisticResutls( make_unique< double[] >( xBinNum * yBinNum ) );
-    auto                 sum( make_unique< double[] >( xBinNum * yBinNum ) );
-    auto                 count( make_unique< unsigned[] >( xBinNum * yBinNum ) );
+    const unsigned long binNum = xAxis.bin_num() * yAxis.bin_num();
 
-    for ( auto i = 0UL; i < dataNum; ++i )
-    {
-        if ( xData[ i ] >= xLowerBound and xData[ i ] < xUpperBound and yData[ i ] >= yLowerBound
-             and yData[ i ] < yUpperBound )
-        {
-            idx = find_index( xLowerBound, xUpperBound, xBinNum, xData[ i ] );
-            idy = find_index( yLowerBound, yUpperBound, yBinNum, yData[ i ] );
-            ++count[ idx * yBinNum + idy ];
-            sum[ idx * yBinNum + idy ] += data[ i ];
-        }
-    }
-
-    MPI_Allreduce( MPI_IN_PLACE, count.get(), xBinNum * yBinNum, MPI_UNSIGNED, MPI_SUM,
-                   MPI_COMM_WORLD );
-    MPI_Allreduce( MPI_IN_PLACE, sum.get(), xBinNum * yBinNum, MPI_DOUBLE, MPI_SUM,
-                   MPI_COMM_WORLD );
+    vector< welford_bin > bins( binNum, welford_bin{ 0, 0, 0 } );
+    parallel_bins::deposit( dataNum, binNum, 1, bins.data(), index2d( xData, xAxis, yData, yAxis ),
+                            [ data ]( welford_bin* bin, unsigned long i ) {
+                                welford_add( *bin, data[ i ] );
+                            },
+                            welford_merge );
 
-    for ( auto i = 0U; i < xBinNum * yBinNum; ++i )
-    {
-        if ( count[ i ] != 0 )
-        {
-            statisticResutls[ i ] = sum[ i ] / count[ i ];
-        }
-        else
-        {
-            statisticResutls[ i ] = nan( "" );
-        }
-    }
-
-    std::memset( sum.get(), 0, sizeof( double ) * xBinNum * yBinNum );  // reset the sum to 0
-    for ( auto i = 0UL; i < dataNum; ++i )
-    {
-        if ( xData[ i ] >= xLowerBound and xData[ i ] < xUpperBound and yData[ i ] >= yLowerBound
-             and yData[ i ] < yUpperBound )
-        {
-            idx = find_index( xLowerBound, xUpperBound, xBinNum, xData[ i ] );
-            idy = find_index( yLowerBound, yUpperBound, yBinNum, yData[ i ] );
-            sum[ idx * yBinNum + idy ] += ( data[ i ] - statisticResutls[ idx * yBinNum + idy ] )
-                                          * ( data[ i ] - statisticResutls[ idx * yBinNum + idy ] );
-        }
-    }
-
-    MPI_Allreduce( MPI_IN_PLACE, sum.get(), xBinNum * yBinNum, MPI_DOUBLE, MPI_SUM,
-                   MPI_COMM_WORLD );
-
-    for ( auto i = 0U; i < xBinNum * yBinNum; ++i )
-    {
-        if ( count[ i ] != 0 )
-        {
-            statisticResutls[ i ] = sqrt( sum[ i ] / count[ i ] );
-        }
-    }
-
-    return statisticResutls;
-}
-
-/**
- * @brief function that determines the bin a data point should be located, for evenly distributed
- * bins only and there is no boundary check!
- *
- * @param lowerBound the lower boundary of the data range
- * @param upperBound the upper boundary of the data range
- * @param binNum the number of bins
- * @param value the value of the data point
- * @return
- */
-auto statistic::find_index( const double lowerBound, const double upperBound,
-                            const unsigned long binNum, const double value ) -> unsigned long
-{
-    return ( value - lowerBound ) / ( upperBound - lowerBound ) * binNum;
+    return welford_std( bins.data(), binNum );
 }
 
 /**
@@ -355,20 +766,38 @@ auto statistic::bin1d( const int mpiRank, const double* coord, const double lowe
                        const double upperBound, const unsigned long binNum,
                        const statistic_method method, const unsigned long dataNum,
                        const double* data ) -> std::unique_ptr< double[] >
+{
+    return bin1d( mpiRank, coord, bin_axis( lowerBound, upperBound, binNum ), method, dataNum,
+                  data );
+}
+
+/**
+ * @brief Similar to bin2d but for 1D case, with arbitrary bins.
+ *
+ * @param coord pointing to the coordinates
+ * @param axis bins of the coordinate
+ * @param method statistic method
+ * @param dataNum number of data points to be analyzed
+ * @param data pointing to target data points
+ * @return a unique_ptr pointing to the 1D array of resutls
+ */
+auto statistic::bin1d( const int mpiRank, const double* coord, const bin_axis& axis,
+                       const statistic_method method, const unsigned long dataNum,
+                       const double* data ) -> std::unique_ptr< double[] >
 {
     switch ( method )
     {
     case statistic_method::COUNT: {
-        return bin1dcount( mpiRank, coord, lowerBound, upperBound, binNum, dataNum );
+        return bin1dcount( mpiRank, coord, axis, dataNum );
     }
     case statistic_method::SUM: {
-        return bin1dsum( mpiRank, coord, lowerBound, upperBound, binNum, dataNum, data );
+        return bin1dsum( mpiRank, coord, axis, dataNum, data );
     }
     case statistic_method::MEAN: {
-        return bin1dmean( mpiRank, coord, lowerBound, upperBound, binNum, dataNum, data );
+        return bin1dmean( mpiRank, coord, axis, dataNum, data );
     }
     case statistic_method::STD: {
-        return bin1dstd( coord, lowerBound, upperBound, binNum, dataNum, data );
+        return bin1dstd( coord, axis, dataNum, data );
     }
     default: {
         ERROR( "Get an unsupported statistic method!" );
@@ -380,191 +809,545 @@ auto statistic::bin1d( const int mpiRank, const double* coord, const double lowe
 }
 
 /**
- * @brief Similar to bin2dcount but for 1D case.
+ * @brief Add the bounding boxes of the three projections to the full images.
+ *
+ * @param boxed the values in the boxes, in sequence of the projections and in row-major order
+ * @param boxes lower and upper (exclusive) rows, then lower and upper columns of each box
+ * @param binNum number of bins of each side of the images
+ * @param images the x-y, x-z and y-z images in sequence
  */
-auto statistic::bin1dcount( const int mpiRank, const double* coord, const double lowerBound,
-                            const double upperBound, const unsigned long binNum,
-                            const unsigned long dataNum ) -> std::unique_ptr< double[] >
+static void add_boxes( const double* boxed, const long* boxes, const unsigned long binNum,
+                       double* images )
 {
-    static unsigned long idx = 0;
-    auto                 statisticResutls( make_unique< double[] >( binNum ) );
-    auto                 count( make_unique< unsigned[] >( binNum ) );
-    auto                 countRecv( make_unique< unsigned[] >( binNum ) );
-
-    if ( mpiRank == 0 )
+    for ( auto p = 0; p < 3; ++p )
     {
-        countRecv = make_unique< unsigned[] >( binNum );
+        const long* box = boxes + 4 * p;
+        for ( auto row = box[ 0 ]; row < box[ 1 ]; ++row )
+        {
+            double* image = images + p * binNum * binNum + row * binNum;
+            for ( auto col = box[ 2 ]; col < box[ 3 ]; ++col )
+            {
+                image[ col ] += *boxed++;
+            }
+        }
     }
+}
 
-    for ( auto i = 0UL; i < dataNum; ++i )
+/**
+ * @brief The cells of a value and their weights of the deposition kernel, along a linear axis.
+ *
+ * @param axis the linear bins
+ * @param value the coordinate
+ * @param kernel the deposition kernel
+ * @param cells at most 3 cells, some of which may be out of the axis
+ * @param weights weights of the cells
+ * @return number of the cells
+ */
+static auto kernel_cells( const bin_axis& axis, const double value, const image_kernel kernel,
+                          long* cells, double* weights ) -> int
+{
+    if ( kernel == image_kernel::NGP )
     {
-        if ( coord[ i ] >= lowerBound and coord[ i ] < upperBound )
+        if ( not axis.contains( value ) )
         {
-            idx = find_index( lowerBound, upperBound, binNum, coord[ i ] );
-            ++count[ idx ];
+            return 0;
         }
+        cells[ 0 ]   = ( long )axis.find_index( value );
+        weights[ 0 ] = 1;
+        return 1;
     }
 
-    MPI_Reduce( count.get(), countRecv.get(), binNum, MPI_UNSIGNED, MPI_SUM, 0, MPI_COMM_WORLD );
+    // position in unit of the bin width, where the center of the i-th cell is at i + 0.5
+    const auto   binNum = ( double )axis.bin_num();
+    const double pos    = ( value - axis.lower_bound() )
+                       / ( axis.upper_bound() - axis.lower_bound() ) * binNum;
+    if ( not( pos > -2 and pos < binNum + 2 ) )  // no cell in the axis, also filter the nan
+    {
+        return 0;
+    }
 
-    if ( mpiRank == 0 )  // effectively update the results in the root process
+    if ( kernel == image_kernel::CIC )
     {
-        for ( auto i = 0U; i < binNum; ++i )
-        {
-            statisticResutls[ i ] = ( double )countRecv[ i ];
-        }
+        const double left = floor( pos - 0.5 );
+        const double frac = pos - 0.5 - left;
+        cells[ 0 ]        = ( long )left;
+        cells[ 1 ]        = cells[ 0 ] + 1;
+        weights[ 0 ]      = 1 - frac;
+        weights[ 1 ]      = frac;
+        return 2;
     }
-    return statisticResutls;
+
+    // TSC: the nearest cell and its two neighbors
+    const double nearest = floor( pos );
+    const double dist    = pos - nearest - 0.5;
+    for ( auto i = 0; i < 3; ++i )
+    {
+        cells[ i ] = ( long )nearest + i - 1;
+    }
+    weights[ 0 ] = 0.5 * ( 0.5 - dist ) * ( 0.5 - dist );
+    weights[ 1 ] = 0.75 - dist * dist;
+    weights[ 2 ] = 0.5 * ( 0.5 + dist ) * ( 0.5 + dist );
+    return 3;
 }
 
 /**
- * @brief Similar to bin2dsum but for 1D case.
+ * @brief The weighted x-y, x-z and y-z projections of 3D points, where all directions share the
+ * same linear bins. The cells of each point are located once for all the three images, and the
+ * images are reduced to the root process together. Besides the nearest grid point, the points can
+ * be deposited by the cloud-in-cell (CIC) or the triangular-shaped-cloud (TSC) kernel, which spread
+ * a point over 2x2 or 3x3 cells and give much smoother images. The weights deposited out of the
+ * images are dropped.
+ *
+ * Each process only deposits into the bounding boxes of its own points, which are usually small
+ * for large images. If the boxes of all processes together are not larger than the images, the
+ * root process gathers the boxes and assembles the images; otherwise the boxes are expanded and
+ * reduced densely. The reduced images are always complete in the root process, since the log file
+ * is only written there (by the serial HDF5), so a reduce-scatter of stripes followed by their
+ * gathering would only cost more memory and one more collective than a single MPI_Reduce.
+ *
+ * @param coordinates pointing to the (x, y, z) of the points
+ * @param axis bins of each coordinate
+ * @param dataNum number of points
+ * @param weights weights of the points, nullptr for the unit weights (counts)
+ * @param kernel the deposition kernel
+ * @return a unique_ptr pointing to the x-y, x-z and y-z images in sequence, each of them in
+ * row-major order, only effective in the root process
  */
-auto statistic::bin1dsum( const int mpiRank, const double* coord, const double lowerBound,
-                          const double upperBound, const unsigned long binNum,
-                          const unsigned long dataNum,
-                          const double*       data ) -> std::unique_ptr< double[] >
+auto statistic::projections( const int mpiRank, const double* coordinates, const bin_axis& axis,
+                             const unsigned long dataNum, const double* weights,
+                             const image_kernel kernel )
+    -> unique_ptr< double[] >
 {
-    static unsigned long idx = 0;
-    auto                 statisticResutls( make_unique< double[] >( binNum ) );
-    auto                 sum( make_unique< double[] >( binNum ) );
-    auto                 sumRecv( make_unique< double[] >( binNum ) );
+    const long          binNum          = ( long )axis.bin_num();
+    const unsigned long imageSize       = binNum * binNum;
+    const int           pairs[ 3 ][ 2 ] = { { 0, 1 }, { 0, 2 }, { 1, 2 } };
 
-    if ( mpiRank == 0 )
+    // extreme coordinates of the local points in each direction, only counting the ones within
+    // two cells (the widest kernel) of the axis
+    struct extreme
+    {
+        double lower = numeric_limits< double >::infinity();
+        double upper = -numeric_limits< double >::infinity();
+    };
+    const double width      = ( axis.upper_bound() - axis.lower_bound() ) / ( double )binNum;
+    const double reach[ 2 ] = { axis.lower_bound() - 2 * width, axis.upper_bound() + 2 * width };
+    extreme      extremes[ 3 ];
+    parallel_bins::deposit(
+        dataNum, 1, 3, extremes, []( unsigned long ) -> long { return 0; },
+        [ coordinates, &reach ]( extreme* ext, unsigned long i ) {
+            for ( auto k = 0; k < 3; ++k )
+            {
+                const double value = coordinates[ 3 * i + k ];
+                if ( value > reach[ 0 ] and value < reach[ 1 ] )  // also filter the nan
+                {
+                    ext[ k ].lower = min( ext[ k ].lower, value );
+                    ext[ k ].upper = max( ext[ k ].upper, value );
+                }
+            }
+        },
+        []( extreme* ext, const extreme* other, unsigned long size ) {
+            for ( auto i = 0UL; i < size; ++i )
+            {
+                ext[ i ].lower = min( ext[ i ].lower, other[ i ].lower );
+                ext[ i ].upper = max( ext[ i ].upper, other[ i ].upper );
+            }
+        } );
+
+    // index extents [lower, upper) of the local cells in each direction: the cells of a point never
+    // decrease with its coordinate, so they are bounded by the cells of the extreme coordinates,
+    // and the extents of no point are empty as [binNum, 0)
+    long extents[ 6 ];
+    for ( auto k = 0; k < 3; ++k )
     {
-        sumRecv = make_unique< double[] >( binNum );
+        long   cells[ 3 ];
+        double cellWeights[ 3 ];
+        int    num = kernel_cells( axis, extremes[ k ].lower, kernel, cells, cellWeights );
+        extents[ 2 * k ] =
+            num > 0 ? clamp( cells[ 0 ], 0L, binNum )
+                    : ( extremes[ k ].lower < axis.lower_bound() ? 0 : binNum );
+        num = kernel_cells( axis, extremes[ k ].upper, kernel, cells, cellWeights );
+        extents[ 2 * k + 1 ] =
+            num > 0 ? clamp( cells[ num - 1 ] + 1, 0L, binNum )
+                    : ( extremes[ k ].upper < axis.lower_bound() ? 0 : binNum );
     }
 
-    for ( auto i = 0UL; i < dataNum; ++i )
+    // bounding boxes of the projections
+    long          boxes[ 12 ];
+    unsigned long offsets[ 4 ] = { 0, 0, 0, 0 };
+    for ( auto p = 0; p < 3; ++p )
     {
-        if ( coord[ i ] >= lowerBound and coord[ i ] < upperBound )
+        for ( auto k = 0; k < 2; ++k )
         {
-            idx = find_index( lowerBound, upperBound, binNum, coord[ i ] );
-            sum[ idx ] += data[ i ];
+            const long lower           = extents[ 2 * pairs[ p ][ k ] ];
+            const long upper           = extents[ 2 * pairs[ p ][ k ] + 1 ];
+            boxes[ 4 * p + 2 * k ]     = lower;
+            boxes[ 4 * p + 2 * k + 1 ] = max( lower, upper );
         }
+        offsets[ p + 1 ] = offsets[ p ] + ( boxes[ 4 * p + 1 ] - boxes[ 4 * p ] )
+                                              * ( boxes[ 4 * p + 3 ] - boxes[ 4 * p + 2 ] );
     }
 
-    MPI_Reduce( sum.get(), sumRecv.get(), binNum, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD );
+    vector< double > boxed( offsets[ 3 ] );
+    parallel_bins::sum(
+        dataNum, offsets[ 3 ], boxed.data(),
+        [ & ]( double* values, unsigned long i, unsigned long lower, unsigned long upper ) {
+            long   cells[ 3 ][ 3 ];
+            double cellWeights[ 3 ][ 3 ];
+            int    num[ 3 ];
+            for ( auto k = 0; k < 3; ++k )
+            {
+                num[ k ] = kernel_cells( axis, coordinates[ 3 * i + k ], kernel, cells[ k ],
+                                         cellWeights[ k ] );
+            }
+            const double weight = weights == nullptr ? 1 : weights[ i ];
+            for ( auto p = 0; p < 3; ++p )
+            {
+                const int   row = pairs[ p ][ 0 ];
+                const int   col = pairs[ p ][ 1 ];
+                const long* box = boxes + 4 * p;
+                for ( auto a = 0; a < num[ row ]; ++a )
+                {
+                    if ( cells[ row ][ a ] < box[ 0 ] or cells[ row ][ a ] >= box[ 1 ] )
+                    {
+                        continue;
+                    }
+                    for ( auto b = 0; b < num[ col ]; ++b )
+                    {
+                        // only the pixels in the given range, owned by the current thread
+                        const unsigned long pixel =
+                            offsets[ p ]
+                            + ( cells[ row ][ a ] - box[ 0 ] ) * ( box[ 3 ] - box[ 2 ] )
+                            + cells[ col ][ b ] - box[ 2 ];
+                        if ( cells[ col ][ b ] >= box[ 2 ] and cells[ col ][ b ] < box[ 3 ]
+                             and pixel >= lower and pixel < upper )
+                        {
+                            values[ pixel ] +=
+                                weight * cellWeights[ row ][ a ] * cellWeights[ col ][ b ];
+                        }
+                    }
+                }
+            }
+        } );
 
-    if ( mpiRank == 0 )  // effectively update the results in the root process
+    auto          statisticResutls( make_unique< double[] >( 3 * imageSize ) );
+    unsigned long boxedNum = offsets[ 3 ];
+    MPI_Allreduce( MPI_IN_PLACE, &boxedNum, 1, MPI_UNSIGNED_LONG, MPI_SUM, MPI_COMM_WORLD );
+
+    int size = 0;
+    MPI_Comm_size( MPI_COMM_WORLD, &size );
+    if ( ( double )boxedNum <= sparseRatio * ( double )( 3 * imageSize ) )
     {
-        for ( auto i = 0U; i < binNum; ++i )
+        // sparse: gather the boxes of all processes to the root process
+        const int      localNum = ( int )offsets[ 3 ];
+        vector< long > allBoxes( mpiRank == 0 ? 12 * size : 0 );
+        vector< int >  recvNums( mpiRank == 0 ? size : 0 );
+        vector< int >  displs( mpiRank == 0 ? size : 0 );
+        MPI_Gather( boxes, 12, MPI_LONG, allBoxes.data(), 12, MPI_LONG, 0, MPI_COMM_WORLD );
+        MPI_Gather( &localNum, 1, MPI_INT, recvNums.data(), 1, MPI_INT, 0, MPI_COMM_WORLD );
+        for ( auto r = 1; r < ( int )recvNums.size(); ++r )
+        {
+            displs[ r ] = displs[ r - 1 ] + recvNums[ r - 1 ];
+        }
+        vector< double > boxedRecv( mpiRank == 0 ? boxedNum : 0 );
+        MPI_Gatherv( boxed.data(), localNum, MPI_DOUBLE, boxedRecv.data(), recvNums.data(),
+                     displs.data(), MPI_DOUBLE, 0, MPI_COMM_WORLD );
+
+        if ( mpiRank == 0 )  // effectively update the results in the root process
         {
-            statisticResutls[ i ] = ( double )sumRecv[ i ];
+            for ( auto r = 0; r < size; ++r )
+            {
+                add_boxes( boxedRecv.data() + displs[ r ], allBoxes.data() + 12 * r, binNum,
+                           statisticResutls.get() );
+            }
         }
+        return statisticResutls;
     }
+
+    // dense: expand the boxes to the full images and reduce them
+    vector< double > images( 3 * imageSize );
+    add_boxes( boxed.data(), boxes, binNum, images.data() );
+    MPI_Reduce( images.data(), statisticResutls.get(), 3 * imageSize, MPI_DOUBLE, MPI_SUM, 0,
+                MPI_COMM_WORLD );
     return statisticResutls;
 }
 
 /**
- * @brief Similar to bin2dmean but for 1D case.
+ * @brief 3D binning statistics of the (weighted) data, the bins are reduced to the root process
+ * in a single reduction. With weights, COUNT gives the sum of the weights (e.g. the mass in each
+ * voxel), SUM gives the weighted sum of the data, and MEAN gives the weighted mean of the data.
+ *
+ * The grids are not reduced by slabs: as the images in projections, they are only written by the
+ * root process, which needs the complete grids anyway.
+ *
+ * @param coordinates pointing to the (x, y, z) of the points
+ * @param xAxis bins of the first coordinate
+ * @param yAxis bins of the second coordinate
+ * @param zAxis bins of the third coordinate
+ * @param method statistic method, COUNT, SUM or MEAN
+ * @param dataNum number of points
+ * @param data the data to be binned, not used for COUNT
+ * @param weights weights of the points, nullptr for the unit weights
+ * @return a unique_ptr pointing to the results in row-major order, only effective in the root
+ * process
  */
-auto statistic::bin1dmean( const int mpiRank, const double* coord, const double lowerBound,
-                           const double upperBound, const unsigned long binNum,
-                           const unsigned long dataNum,
-                           const double*       data ) -> std::unique_ptr< double[] >
+auto statistic::bin3d( const int mpiRank, const double* coordinates, const bin_axis& xAxis,
+                       const bin_axis& yAxis, const bin_axis& zAxis, const statistic_method method,
+                       const unsigned long dataNum, const double* data, const double* weights )
+    -> unique_ptr< double[] >
 {
-    static unsigned long idx = 0;
-    auto                 statisticResutls( make_unique< double[] >( binNum ) );
-    auto                 sum( make_unique< double[] >( binNum ) );
-    auto                 count( make_unique< unsigned[] >( binNum ) );
-    auto                 sumRecv( make_unique< double[] >( binNum ) );
-    auto                 countRecv( make_unique< unsigned[] >( binNum ) );
-
-    if ( mpiRank == 0 )
+    if ( method == statistic_method::STD )
     {
-        sumRecv   = make_unique< double[] >( binNum );
-        countRecv = make_unique< unsigned[] >( binNum );
+        ERROR( "Get an unsupported statistic method for 3D binning!" );
+        return nullptr;
     }
 
-    for ( auto i = 0UL; i < dataNum; ++i )
-    {
-        if ( coord[ i ] >= lowerBound and coord[ i ] < upperBound )
-        {
-            idx = find_index( lowerBound, upperBound, binNum, coord[ i ] );
-            ++count[ idx ];
-            sum[ idx ] += data[ i ];
-        }
-    }
+    const unsigned long binNum    = xAxis.bin_num() * yAxis.bin_num() * zAxis.bin_num();
+    const unsigned long binLength = method == statistic_method::MEAN ? 2 : 1;
 
-    MPI_Reduce( count.get(), countRecv.get(), binNum, MPI_UNSIGNED, MPI_SUM, 0, MPI_COMM_WORLD );
-    MPI_Reduce( sum.get(), sumRecv.get(), binNum, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD );
-
-    if ( mpiRank == 0 )  // effectively update the results in the root process
-    {
-        for ( auto i = 0U; i < binNum; ++i )
-        {
-            if ( count[ i ] != 0 )
+    vector< double > bins( binNum * binLength );
+    parallel_bins::deposit(
+        dataNum, binNum, binLength, bins.data(), index3d( coordinates, xAxis, yAxis, zAxis ),
+        [ method, data, weights ]( double* bin, const unsigned long i ) {
+            const double weight = weights == nullptr ? 1 : weights[ i ];
+            if ( method == statistic_method::SUM )
             {
-                statisticResutls[ i ] = sumRecv[ i ] / countRecv[ i ];
+                bin[ 0 ] += weight * data[ i ];
+                return;
             }
-            else
+            bin[ 0 ] += weight;
+            if ( method == statistic_method::MEAN )
             {
-                statisticResutls[ i ] = nan( "" );
+                bin[ 1 ] += weight * data[ i ];
             }
-        }
+        } );
+
+    auto statisticResutls( make_unique< double[] >( binNum ) );
+    if ( method != statistic_method::MEAN )
+    {
+        MPI_Reduce( bins.data(), statisticResutls.get(), ( int )binNum, MPI_DOUBLE, MPI_SUM, 0,
+                    MPI_COMM_WORLD );
+        return statisticResutls;
+    }
+
+    // the means are restored from the reduced (weight, weighted sum) pairs
+    vector< double > reduced( mpiRank == 0 ? binNum * binLength : 0 );
+    MPI_Reduce( bins.data(), reduced.data(), ( int )( binNum * binLength ), MPI_DOUBLE, MPI_SUM, 0,
+                MPI_COMM_WORLD );
+    for ( auto i = 0UL; mpiRank == 0 and i < binNum; ++i )
+    {
+        const double weight = reduced[ 2 * i ];
+        statisticResutls[ i ] = weight != 0 ? reduced[ 2 * i + 1 ] / weight : nan( "" );
     }
     return statisticResutls;
 }
 
 /**
- * @brief Similar to bin2dstd but for 1D case.
+ * @brief The weighted sums of several quantities in 3D bins, all quantities are accumulated in a
+ * single pass of the data, and all bins are reduced to the root process in a single reduction. For
+ * each bin, the results are (\sum w, \sum w q_0, \sum w q_1, ...), so the length of each bin is
+ * 1 + quantityNum.
+ *
+ * @param coordinates pointing to the (x, y, z) of the points
+ * @param xAxis bins of the first coordinate
+ * @param yAxis bins of the second coordinate
+ * @param zAxis bins of the third coordinate
+ * @param dataNum number of points
+ * @param weights weights of the points, nullptr for the unit weights
+ * @param quantityNum number of the quantities
+ * @param quantities pointing to the quantities of the points, quantityNum values for each point
+ * @return a unique_ptr pointing to the 1D array of resutls in row-major order of the bins, only
+ * effective in the root process
  */
-auto statistic::bin1dstd( const double* coord, const double lowerBound, const double upperBound,
-                          const unsigned long binNum, const unsigned long dataNum,
-                          const double* data ) -> std::unique_ptr< double[] >
+auto statistic::sums3d( const int mpiRank, const double* coordinates, const bin_axis& xAxis,
+                        const bin_axis& yAxis, const bin_axis& zAxis, const unsigned long dataNum,
+                        const double* weights, const unsigned long quantityNum,
+                        const double* quantities ) -> unique_ptr< double[] >
 {
-    static unsigned long idx = 0;
-    auto                 statisticResutls( make_unique< double[] >( binNum ) );
-    auto                 sum( make_unique< double[] >( binNum ) );
-    auto                 count( make_unique< unsigned[] >( binNum ) );
+    const unsigned long binNum    = xAxis.bin_num() * yAxis.bin_num() * zAxis.bin_num();
+    const unsigned long binLength = 1 + quantityNum;
 
+    vector< double > bins( binNum * binLength );
+    parallel_bins::deposit( dataNum, binNum, binLength, bins.data(),
+                            index3d( coordinates, xAxis, yAxis, zAxis ),
+                            [ weights, quantityNum, quantities ]( double*             bin,
+                                                                  const unsigned long i ) {
+                                const double weight = weights == nullptr ? 1 : weights[ i ];
+                                bin[ 0 ] += weight;
+                                for ( auto k = 0UL; k < quantityNum; ++k )
+                                {
+                                    bin[ 1 + k ] += weight * quantities[ quantityNum * i + k ];
+                                }
+                            } );
 
-    for ( auto i = 0UL; i < dataNum; ++i )
+    auto statisticResutls( make_unique< double[] >( mpiRank == 0 ? binNum * binLength : 0 ) );
+    MPI_Reduce( bins.data(), statisticResutls.get(), ( int )( binNum * binLength ), MPI_DOUBLE,
+                MPI_SUM, 0, MPI_COMM_WORLD );
+    return statisticResutls;
+}
+
+/**
+ * @brief The weighted moments of several quantities in 1D bins, all quantities are accumulated in a
+ * single pass of the data, and all bins are reduced to the root process in a single reduction. For
+ * each bin, the results are (count, \sum w, \sum w q_0, \sum w q_0^2, \sum w q_1, ...), so the
+ * length of each bin is 2 + 2 * quantityNum.
+ *
+ * @param coord pointing to the coordinates
+ * @param axis bins of the coordinate
+ * @param dataNum number of data points to be analyzed
+ * @param weights pointing to the weights of data points
+ * @param quantityNum number of the quantities
+ * @param quantities pointing to the arrays of each quantity
+ * @return a unique_ptr pointing to the 1D array of resutls, only effective in the root process
+ */
+auto statistic::moments1d( const int mpiRank, const double* coord, const bin_axis& axis,
+                           const unsigned long dataNum, const double* weights,
+                           const unsigned long  quantityNum,
+                           const double* const* quantities ) -> std::unique_ptr< double[] >
+{
+    binned_accumulator accumulator( axis, quantityNum );
+    accumulator.add( dataNum, coord, weights, quantities );
+    accumulator.reduce( mpiRank );
+
+    // the raw moments from the accumulated means and sums of squared deviations
+    const unsigned long binLength = accumulator.bin_length();
+    auto                moments( make_unique< double[] >( accumulator.bin_num() * binLength ) );
+    copy( accumulator.data(), accumulator.data() + accumulator.bin_num() * binLength,
+          moments.get() );
+    for ( auto i = 0UL; i < accumulator.bin_num(); ++i )
     {
-        if ( coord[ i ] >= lowerBound and coord[ i ] < upperBound )
+        double* bin = moments.get() + i * binLength;
+        for ( auto j = 2UL; j < binLength; j += 2 )
         {
-            idx = find_index( lowerBound, upperBound, binNum, coord[ i ] );
-            ++count[ idx ];
-            sum[ idx ] += data[ i ];
+            const double mean = bin[ j ];
+            bin[ j ]          = bin[ 1 ] * mean;
+            bin[ j + 1 ] += bin[ 1 ] * mean * mean;
         }
     }
+    return moments;
+}
 
-    MPI_Allreduce( MPI_IN_PLACE, count.get(), binNum, MPI_UNSIGNED, MPI_SUM, MPI_COMM_WORLD );
-    MPI_Allreduce( MPI_IN_PLACE, sum.get(), binNum, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD );
+/**
+ * @brief Similar to moments1d but with evenly distributed bins.
+ */
+auto statistic::moments1d( const int mpiRank, const double* coord, const double lowerBound,
+                           const double upperBound, const unsigned long binNum,
+                           const unsigned long dataNum, const double* weights,
+                           const unsigned long  quantityNum,
+                           const double* const* quantities ) -> std::unique_ptr< double[] >
+{
+    return moments1d( mpiRank, coord, bin_axis( lowerBound, upperBound, binNum ), dataNum, weights,
+                      quantityNum, quantities );
+}
 
-    for ( auto i = 0U; i < binNum; ++i )
+/**
+ * @brief Similar to bin2dcount but for 1D case.
+ */
+auto statistic::bin1dcount( const int mpiRank, const double* coord, const bin_axis& axis,
+                            const unsigned long dataNum ) -> std::unique_ptr< double[] >
+{
+    const unsigned long binNum = axis.bin_num();
+
+    auto statisticResutls( make_unique< double[] >( binNum ) );
+    auto count( make_unique< unsigned[] >( binNum ) );
+    auto countRecv( make_unique< unsigned[] >( binNum ) );
+
+    parallel_bins::deposit( dataNum, binNum, 1, count.get(), index1d( coord, axis ),
+                            []( unsigned* bin, unsigned long ) { ++*bin; } );
+
+    MPI_Reduce( count.get(), countRecv.get(), binNum, MPI_UNSIGNED, MPI_SUM, 0, MPI_COMM_WORLD );
+
+    if ( mpiRank == 0 )  // effectively update the results in the root process
     {
-        if ( count[ i ] != 0 )
-        {
-            statisticResutls[ i ] = sum[ i ] / count[ i ];
-        }
-        else
+        for ( auto i = 0U; i < binNum; ++i )
         {
-            statisticResutls[ i ] = nan( "" );
+            statisticResutls[ i ] = ( double )countRecv[ i ];
         }
     }
+    return statisticResutls;
+}
 
-    std::memset( sum.get(), 0, sizeof( double ) * binNum );  // reset the sum to 0
-    for ( auto i = 0UL; i < dataNum; ++i )
+/**
+ * @brief Similar to bin2dsum but for 1D case.
+ */
+auto statistic::bin1dsum( const int mpiRank, const double* coord, const bin_axis& axis,
+                          const unsigned long dataNum,
+                          const double*       data ) -> std::unique_ptr< double[] >
+{
+    const unsigned long binNum = axis.bin_num();
+
+    auto statisticResutls( make_unique< double[] >( binNum ) );
+    auto sum( make_unique< double[] >( binNum ) );
+    auto sumRecv( make_unique< double[] >( binNum ) );
+
+    parallel_bins::deposit( dataNum, binNum, 1, sum.get(), index1d( coord, axis ),
+                            [ data ]( double* bin, unsigned long i ) { *bin += data[ i ]; } );
+
+    MPI_Reduce( sum.get(), sumRecv.get(), binNum, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD );
+
+    if ( mpiRank == 0 )  // effectively update the results in the root process
     {
-        if ( coord[ i ] >= lowerBound and coord[ i ] < upperBound )
+        for ( auto i = 0U; i < binNum; ++i )
         {
-            idx = find_index( lowerBound, upperBound, binNum, coord[ i ] );
-            sum[ idx ] +=
-                ( data[ i ] - statisticResutls[ idx ] ) * ( data[ i ] - statisticResutls[ idx ] );
+            statisticResutls[ i ] = sumRecv[ i ];
         }
     }
+    return statisticResutls;
+}
+
+/**
+ * @brief Similar to bin2dmean but for 1D case.
+ */
+auto statistic::bin1dmean( const int mpiRank, const double* coord, const bin_axis& axis,
+                           const unsigned long dataNum,
+                           const double*       data ) -> std::unique_ptr< double[] >
+{
+    const unsigned long binNum = axis.bin_num();
 
-    MPI_Allreduce( MPI_IN_PLACE, sum.get(), binNum, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD );
+    // (count, sum) of each bin, reduced together
+    auto statisticResutls( make_unique< double[] >( binNum ) );
+    auto bins( make_unique< double[] >( 2 * binNum ) );
+    auto binsRecv( make_unique< double[] >( 2 * binNum ) );
 
-    for ( auto i = 0U; i < binNum; ++i )
+    parallel_bins::deposit( dataNum, binNum, 2, bins.get(), index1d( coord, axis ),
+                            [ data ]( double* bin, unsigned long i ) {
+                                bin[ 0 ] += 1;
+                                bin[ 1 ] += data[ i ];
+                            } );
+
+    MPI_Reduce( bins.get(), binsRecv.get(), 2 * binNum, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD );
+
+    if ( mpiRank == 0 )  // effectively update the results in the root process
     {
-        if ( count[ i ] != 0 )
+        for ( auto i = 0U; i < binNum; ++i )
         {
-            statisticResutls[ i ] = sqrt( sum[ i ] / count[ i ] );
+            if ( binsRecv[ 2 * i ] != 0 )
+            {
+                statisticResutls[ i ] = binsRecv[ 2 * i + 1 ] / binsRecv[ 2 * i ];
+            }
+            else
+            {
+                statisticResutls[ i ] = nan( "" );
+            }
         }
     }
-
     return statisticResutls;
 }
+
+/**
+ * @brief Similar to bin2dstd but for 1D case.
+ */
+auto statistic::bin1dstd( const double* coord, const bin_axis& axis, const unsigned long dataNum,
+                          const double* data ) -> std::unique_ptr< double[] >
+{
+    const unsigned long binNum = axis.bin_num();
+
+    vector< welford_bin > bins( binNum, welford_bin{ 0, 0, 0 } );
+    parallel_bins::deposit( dataNum, binNum, 1, bins.data(), index1d( coord, axis ),
+                            [ data ]( welford_bin* bin, unsigned long i ) {
+                                welford_add( *bin, data[ i ] );
+                            },
+                            welford_merge );
+
+    return welford_std( bins.data(), binNum );
+}
+
@@ -12,6 +12,7 @@
 #include <cmath>
 #include <cstring>
 #include <mpi.h>
+#include <numbers>
 using namespace std;
 using namespace otf;
 #define THRESHOLD 1e-6  // the equal threshold of floating numbers
@@ -99,6 +100,117 @@ int main( int argc, char* argv[] )
         returnCode += 1;
     }
 
+    // unwrap a bar rotating with a constant pattern speed, from the wrapped bar angles
+    double       times[ 20 ]  = { 0 };
+    double       phases[ 20 ] = { 0 };
+    const double omegaTarget  = 1.3;
+    for ( int i = 0; i < 20; ++i )
+    {
+        times[ i ]         = 0.4 * i;
+        const double angle = omegaTarget * times[ i ];
+        const double wrap  = atan2( sin( 2 * angle ), cos( 2 * angle ) ) / 2;
+        phases[ i ]        = i == 0 ? wrap : bar_info::unwrap_bar_angle( phases[ i - 1 ], wrap );
+        if ( not floatEq( phases[ i ], omegaTarget * times[ i ] ) )
+        {
+            MPI_ERROR( rank, "Unwrapped bar angle: Target is [%lf] but get [%lf].",
+                       angle, phases[ i ] );
+            returnCode += 1;
+        }
+    }
+
+    double getOmega = bar_info::pattern_speed( 20, times, phases );
+    if ( not floatEq( getOmega, omegaTarget ) )
+    {
+        MPI_ERROR( rank, "Pattern speed: Target is [%lf] but get [%lf].", omegaTarget, getOmega );
+        returnCode += 1;
+    }
+    if ( not isnan( bar_info::pattern_speed( 1, times, phases ) ) )
+    {
+        MPI_ERROR( rank, "Pattern speed: should be nan with a single data point." );
+        returnCode += 1;
+    }
+
+    // Tremaine-Weinberg integrals of a solid body rotation around the center of mass, moving with
+    // a systemic velocity, where each slit gives the exact pattern speed
+    double       coordinates[ 30 ] = { 0 };
+    double       velocities[ 30 ]  = { 0 };
+    double       massCenter[ 4 ]   = { 0, 0, 0, 0 };  // \sum m x, \sum m y, \sum m z, \sum m
+    const double systemic[ 3 ]     = { 3.0, -2.0, 1.5 };
+    const double inclination       = 60;
+    const double twAngles[ 2 ]     = { 30, 120 };
+    for ( int i = 0; i < 10; ++i )
+    {
+        const double radius      = 0.2 + 0.1 * ( i + 10 * rank );
+        coordinates[ 3 * i + 0 ] = radius * cos( phiRecv[ i ] );
+        coordinates[ 3 * i + 1 ] = radius * sin( phiRecv[ i ] ) * 0.5;
+        coordinates[ 3 * i + 2 ] = 0.01 * zedRecv[ i ];
+        for ( int k = 0; k < 3; ++k )
+        {
+            massCenter[ k ] += massRecv[ i ] * coordinates[ 3 * i + k ];
+        }
+        massCenter[ 3 ] += massRecv[ i ];
+    }
+    MPI_Allreduce( MPI_IN_PLACE, massCenter, 4, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD );
+    for ( int i = 0; i < 10; ++i )
+    {
+        for ( int k = 0; k < 3; ++k )
+        {
+            coordinates[ 3 * i + k ] -= massCenter[ k ] / massCenter[ 3 ];
+        }
+        velocities[ 3 * i + 0 ] = -omegaTarget * coordinates[ 3 * i + 1 ] + systemic[ 0 ];
+        velocities[ 3 * i + 1 ] = omegaTarget * coordinates[ 3 * i + 0 ] + systemic[ 1 ];
+        velocities[ 3 * i + 2 ] = systemic[ 2 ];
+    }
+    auto integrals = bar_info::tw_integrals( 10, massRecv, coordinates, velocities, inclination,
+                                             2, twAngles, 4, 1.0, 3.0 );
+    for ( int i = 0; i < 2 * 4; ++i )
+    {
+        const double* slit = integrals.get() + i * bar_info::twQuantityNum;
+        if ( abs( slit[ 0 ] ) <= THRESHOLD )
+        {
+            continue;
+        }
+        const double getTW = slit[ 1 ] / slit[ 0 ] / sin( inclination * numbers::pi / 180 );
+        if ( not floatEq( getTW, omegaTarget ) )
+        {
+            MPI_ERROR( rank, "TW pattern speed of slit [%d]: Target is [%lf] but get [%lf].", i,
+                       omegaTarget, getTW );
+            returnCode += 1;
+        }
+    }
+
+    // bar length of a triangle A2 profile, where the phase twists beyond R = 4
+    double       profileRs[ 10 ] = { 0 };
+    double       profileRe[ 10 ] = { 0 };
+    double       profileIm[ 10 ] = { 0 };
+    const double lengthTarget    = 6;  // A2 drops from 0.32 at R = 4.5 to 0.16 at R = 6.5
+    for ( int i = 0; i < 10; ++i )
+    {
+        profileRs[ i ]         = i + 0.5;
+        const double amplitude = i <= 3 ? 0.1 * ( i + 1 ) : 0.4 - 0.08 * ( i - 3 );
+        const double phase     = 0.3 + ( i <= 4 ? 0 : 0.1 * ( i - 4 ) );
+        profileRe[ i ]         = amplitude * cos( 2 * phase );
+        profileIm[ i ]         = amplitude * sin( 2 * phase );
+    }
+    profileRe[ 5 ] = profileIm[ 5 ] = nan( "" );  // an empty bin, skipped in the interpolation
+    double getLengthA2 = bar_info::bar_length_a2( 10, profileRs, profileRe, profileIm, 0.5 );
+    if ( not floatEq( getLengthA2, lengthTarget ) )
+    {
+        MPI_ERROR( rank, "Bar length from A2: Target is [%lf] but get [%lf].", lengthTarget,
+                   getLengthA2 );
+        returnCode += 1;
+    }
+    // the phase deviation is 0 at R = 4.5 and 0.2 at R = 6.5, so it reaches 0.15 at R = 6
+    const double dphi           = 0.15 * 180 / numbers::pi;
+    double       getLengthPhase = bar_info::bar_length_phase( 10, profileRs, profileRe, profileIm,
+                                                              dphi );
+    if ( not floatEq( getLengthPhase, lengthTarget ) )
+    {
+        MPI_ERROR( rank, "Bar length from phase: Target is [%lf] but get [%lf].", lengthTarget,
+                   getLengthPhase );
+        returnCode += 1;
+    }
+
     MPI_Finalize();
     return returnCode;
 }
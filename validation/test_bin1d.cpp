@@ -7,10 +7,12 @@
 #define THRESHOLD 1e-6  // the equal threshold of floating numbers
 #include "../include/myprompt.hpp"
 #include "../include/statistic.hpp"
+#include <algorithm>
 #include <cmath>
 #include <iostream>
 #include <memory>
 #include <mpi.h>
+#include <vector>
 using namespace std;
 
 int main( int argc, char* argv[] )
@@ -134,6 +136,99 @@ int main( int argc, char* argv[] )
                                   values );
     auto std  = statistic::bin1d( rank, xsRecv, xmin, xmax, binNum, statistic_method::STD, dataNum,
                                   values );
+    // the standard deviation should be stable against a large offset of the data
+    double shiftedValues[ 100 ];
+    for ( auto i = 0; i < 100; ++i )
+    {
+        shiftedValues[ i ] = valuesRecv[ i ] + 1e9;
+    }
+    auto shiftedStd = statistic::bin1d( rank, xsRecv, xmin, xmax, binNum, statistic_method::STD,
+                                        dataNum, shiftedValues );
+    // the unit weighted moments should be consistent with the results above
+    double        weights[ 100 ];
+    const double* quantities[ 1 ] = { values };
+    for ( auto& weight : weights )
+    {
+        weight = 1;
+    }
+    auto moments = statistic::moments1d( rank, xsRecv, xmin, xmax, binNum, dataNum, weights, 1,
+                                         quantities );
+    if ( rank == 0 )  // check the results in the root process
+    {
+        for ( auto i = 0UL; i < binNum; ++i )
+        {
+            const double* bin     = moments.get() + i * 4;
+            const double  getMean = bin[ 2 ] / bin[ 1 ];
+            const double  getStd  = sqrt( bin[ 3 ] / bin[ 1 ] - getMean * getMean );
+            if ( abs( bin[ 0 ] - targetCount[ i ] ) >= THRESHOLD
+                 or abs( bin[ 1 ] - targetCount[ i ] ) >= THRESHOLD
+                 or abs( bin[ 2 ] - targetSum[ i ] ) >= THRESHOLD
+                 or abs( getMean - targetMean[ i ] ) >= THRESHOLD
+                 or abs( getStd - targetStd[ i ] ) >= THRESHOLD )
+            {
+                cout << "Moments of bin " << i << ": count=" << bin[ 0 ] << ", mean=" << getMean
+                     << ", std=" << getStd << endl;
+                MPI_Finalize();
+                return -1;
+            }
+        }
+    }
+
+    // the same bins given by their edges should lead to the same results
+    vector< double > edges( binNum + 1 );
+    for ( auto i = 0UL; i <= binNum; ++i )
+    {
+        edges[ i ] = xmin + i * ( ( xmax - xmin ) / binNum );
+    }
+    auto edgeCount =
+        statistic::bin1d( rank, xsRecv, bin_axis( edges ), statistic_method::COUNT, dataNum );
+    if ( rank == 0 )  // check the results in the root process
+    {
+        for ( auto i = 0UL; i < binNum; ++i )
+        {
+            if ( abs( edgeCount[ i ] - targetCount[ i ] ) >= THRESHOLD )
+            {
+                cout << "Count of bin " << i << " with given edges: " << edgeCount[ i ] << endl;
+                MPI_Finalize();
+                return -1;
+            }
+        }
+    }
+
+    // the O(1) lookup of log and arbitrary bins should agree with a binary search of the edges
+    vector< double > irregular = { 0.01, 0.011, 0.5, 0.5001, 2, 3.3, 3.31, 7, 10.7 };
+    vector< double > logEdges;
+    bin_axis         logAxis( 0.01, 10.7, binNum, bin_scale::LOG );
+    for ( auto i = 0UL; i <= binNum; ++i )
+    {
+        logEdges.push_back( logAxis.edge( i ) );
+    }
+    for ( auto* axisEdges : { &irregular, &logEdges } )
+    {
+        const bin_axis   axis = axisEdges == &logEdges ? logAxis : bin_axis( *axisEdges );
+        vector< double > tests( *axisEdges );  // values exactly on the edges
+        for ( auto i = 0; i < 10000; ++i )
+        {
+            tests.push_back( 0.01 * pow( 1070, i / 10000.0 ) );
+        }
+        for ( auto& value : tests )
+        {
+            if ( not axis.contains( value ) )
+            {
+                continue;
+            }
+            const auto target =
+                upper_bound( axisEdges->begin(), axisEdges->end(), value ) - axisEdges->begin() - 1;
+            if ( ( long )axis.find_index( value ) != target )
+            {
+                cout << "Value " << value << ": target bin is " << target << " but get "
+                     << axis.find_index( value ) << endl;
+                MPI_Finalize();
+                return -1;
+            }
+        }
+    }
+
     if ( rank == 0 )  // check the results in the root process
     {
         cout << "results of count:" << endl;
@@ -187,6 +282,17 @@ int main( int argc, char* argv[] )
             }
         }
 
+        for ( auto i = 0UL; i < binNum; ++i )
+        {
+            if ( abs( shiftedStd[ i ] - targetStd[ i ] ) >= THRESHOLD )
+            {
+                cout << "Target value=" << targetStd[ i ] << endl;
+                cout << "Get value with an offset=" << shiftedStd[ i ] << endl;
+                MPI_Finalize();
+                return -1;
+            }
+        }
+
         cout << "results of std:" << endl;
         for ( auto i = 0UL; i < binNum; ++i )
         {
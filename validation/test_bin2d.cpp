@@ -6,19 +6,25 @@
 #define DEBUG 1
 #define THRESHOLD 1e-6  // the equal threshold of floating numbers
 #include "../include/myprompt.hpp"
+#include "../include/parallel.hpp"
 #include "../include/statistic.hpp"
+#include <algorithm>
 #include <cmath>
 #include <iostream>
 #include <memory>
 #include <mpi.h>
+#include <random>
+#include <vector>
 using namespace std;
 
 int main( int argc, char* argv[] )
 {
     // NOTE: test in rank 4 mpi process program
     int rank = -1;
+    int size = 0;
     MPI_Init( &argc, &argv );
     MPI_Comm_rank( MPI_COMM_WORLD, &rank );
+    MPI_Comm_size( MPI_COMM_WORLD, &size );
 
     double        xmin = -0.1, xmax = 10.7, ymin = -5.5, ymax = 5.9;
     unsigned long xBinNum = 7, yBinNum = 5, dataNum = 100;
@@ -168,6 +174,67 @@ int main( int argc, char* argv[] )
                                    statistic_method::MEAN, dataNum, values );
     auto std   = statistic::bin2d( rank, xsRecv, xmin, xmax, xBinNum, ysRecv, ymin, ymax, yBinNum,
                                    statistic_method::STD, dataNum, values );
+    // the reusable accumulator: the data are added in two chunks, and repeated after a reset
+    const bin_axis     xAxis( xmin, xmax, xBinNum );
+    const bin_axis     yAxis( ymin, ymax, yBinNum );
+    binned_accumulator accumulator( xAxis, yAxis, 1 );
+    const double*      firstChunk[ 1 ]  = { values };
+    const double*      secondChunk[ 1 ] = { values + 50 };
+    for ( auto repeat = 0; repeat < 2; ++repeat )
+    {
+        accumulator.reset();
+        accumulator.add( 50, xsRecv, ysRecv, nullptr, firstChunk );
+        accumulator.add( dataNum - 50, xsRecv + 50, ysRecv + 50, nullptr, secondChunk );
+        accumulator.reduce( rank );
+    }
+    if ( rank == 0 )  // check the results in the root process
+    {
+        for ( auto i = 0UL; i < xBinNum * yBinNum; ++i )
+        {
+            if ( abs( accumulator.count( i ) - targetCount[ i ] ) >= THRESHOLD
+                 or abs( accumulator.mean( i, 0 ) - targetMean[ i ] ) >= THRESHOLD
+                 or abs( accumulator.dispersion( i, 0 ) - targetStd[ i ] ) >= THRESHOLD )
+            {
+                cout << "Accumulator of bin " << i << ": count=" << accumulator.count( i )
+                     << ", mean=" << accumulator.mean( i, 0 )
+                     << ", std=" << accumulator.dispersion( i, 0 ) << endl;
+                MPI_Finalize();
+                return -1;
+            }
+        }
+    }
+
+    // the dispersion of a quantity with a large offset, where E[q^2] - E[q]^2 would cancel out: the
+    // values are offset -1 or +1 alternately, in two chunks deposited by several threads
+    const unsigned long offsetNum = 20000;
+    const bin_axis      unitAxis( 0, 1, 1 );
+    vector< double >    offsetCoords( offsetNum, 0.5 );
+    vector< double >    offsetValues( offsetNum );
+    vector< double >    offsetWeights( offsetNum, 2.0 );
+    for ( auto i = 0UL; i < offsetNum; ++i )
+    {
+        offsetValues[ i ] = 1e9 + ( i % 2 == 0 ? -1 : 1 );
+    }
+    const double*      offsetChunks[ 2 ] = { offsetValues.data(), offsetValues.data() + 5000 };
+    binned_accumulator offsetAccumulator( unitAxis, 1 );
+    otf::parallel_bins::minChunk = 1000;
+    offsetAccumulator.add( 5000, offsetCoords.data(), offsetWeights.data(), offsetChunks );
+    offsetAccumulator.add( offsetNum - 5000, offsetCoords.data(), offsetWeights.data(),
+                           offsetChunks + 1 );
+    offsetAccumulator.reduce( rank );
+    if ( rank == 0
+         and ( offsetAccumulator.count( 0 ) != 4 * offsetNum
+               or abs( offsetAccumulator.weight( 0 ) - 8.0 * offsetNum ) >= THRESHOLD
+               or abs( offsetAccumulator.mean( 0, 0 ) - 1e9 ) >= THRESHOLD
+               or abs( offsetAccumulator.dispersion( 0, 0 ) - 1 ) >= THRESHOLD ) )
+    {
+        cout << "Accumulator with a large offset: count=" << offsetAccumulator.count( 0 )
+             << ", mean=" << offsetAccumulator.mean( 0, 0 )
+             << ", std=" << offsetAccumulator.dispersion( 0, 0 ) << endl;
+        MPI_Finalize();
+        return -1;
+    }
+
     if ( rank == 0 )  // check the results in the root process
     {
         cout << "results of count:" << endl;
@@ -242,6 +309,291 @@ int main( int argc, char* argv[] )
             }
         }
     }
+
+    // the thread-parallel binning: serial, private bins of each thread, and blocked ownership
+#ifdef _OPENMP
+    omp_set_num_threads( 4 );
+#endif
+    const unsigned long                 largeNum = 50000;
+    mt19937                             gen( 2024 + rank );
+    uniform_real_distribution< double > uniform( -6, 11 );
+    vector< double >                    largeXs( largeNum );
+    vector< double >                    largeYs( largeNum );
+    vector< double >                    largeValues( largeNum );
+    for ( auto i = 0UL; i < largeNum; ++i )
+    {
+        largeXs[ i ]     = uniform( gen );
+        largeYs[ i ]     = uniform( gen );
+        largeValues[ i ] = uniform( gen );
+    }
+    unique_ptr< double[] > results[ 4 ][ 3 ];
+    const statistic_method methods[ 3 ] = { statistic_method::COUNT, statistic_method::SUM,
+                                            statistic_method::STD };
+    for ( auto run = 0; run < 4; ++run )
+    {
+        // serial, private bins, private bins again, and blocked ownership
+        otf::parallel_bins::minChunk     = run == 0 ? largeNum + 1 : 1000;
+        otf::parallel_bins::privateBytes = run == 3 ? 0 : 1UL << 26;
+        for ( auto m = 0; m < 3; ++m )
+        {
+            results[ run ][ m ] = statistic::bin2d( rank, largeXs.data(), xmin, xmax, xBinNum,
+                                                    largeYs.data(), ymin, ymax, yBinNum,
+                                                    methods[ m ], largeNum, largeValues.data() );
+        }
+    }
+    if ( rank == 0 )  // check the results in the root process
+    {
+        for ( auto i = 0UL; i < xBinNum * yBinNum; ++i )
+        {
+            for ( auto m = 0; m < 3; ++m )
+            {
+                const double serial = results[ 0 ][ m ][ i ];
+                // same results with a fixed number of threads, and the blocked ownership deposits
+                // the data in the serial order
+                if ( results[ 1 ][ m ][ i ] != results[ 2 ][ m ][ i ]
+                     or results[ 3 ][ m ][ i ] != serial
+                     or abs( results[ 1 ][ m ][ i ] - serial ) >= THRESHOLD )
+                {
+                    cout << "Threaded binning of method " << m << " in bin " << i << ": serial "
+                         << serial << ", private " << results[ 1 ][ m ][ i ] << ", "
+                         << results[ 2 ][ m ][ i ] << ", blocked " << results[ 3 ][ m ][ i ]
+                         << endl;
+                    MPI_Finalize();
+                    return -1;
+                }
+            }
+        }
+    }
+
+    // a smaller team than requested: inside an enclosing parallel region without nesting, the
+    // team has a single thread, which must still deposit all the data points
+    const bin_axis lineAxis( -6, 11, 17 );
+    const auto     indexOf = [ & ]( unsigned long i ) -> long {
+        const double x = largeXs[ i ];
+        return lineAxis.contains( x ) ? ( long )lineAxis.find_index( x ) : -1;
+    };
+    const auto countOf = []( double* bin, unsigned long ) { *bin += 1; };
+    vector< double > serialCounts( lineAxis.bin_num() ), teamCounts[ 2 ];
+    otf::parallel_bins::minChunk = largeNum + 1;
+    otf::parallel_bins::deposit( largeNum, lineAxis.bin_num(), 1, serialCounts.data(), indexOf,
+                                 countOf );
+    otf::parallel_bins::minChunk = 1000;
+    for ( auto run = 0; run < 2; ++run )
+    {
+        otf::parallel_bins::privateBytes = run == 1 ? 0 : 1UL << 26;
+        teamCounts[ run ].assign( lineAxis.bin_num(), 0 );
+#pragma omp parallel num_threads( 2 )
+        {
+#pragma omp master
+            otf::parallel_bins::deposit( largeNum, lineAxis.bin_num(), 1, teamCounts[ run ].data(),
+                                         indexOf, countOf );
+        }
+    }
+    otf::parallel_bins::privateBytes = 1UL << 26;
+    if ( teamCounts[ 0 ] != serialCounts or teamCounts[ 1 ] != serialCounts )
+    {
+        cout << "The binning in a nested parallel region loses data points." << endl;
+        MPI_Finalize();
+        return -1;
+    }
+
+    // the blocked ownership of a single large bin (the sums), which is split over the threads by
+    // the element range rather than left to one thread
+    vector< double > lineSums( lineAxis.bin_num() );
+    vector< int >    owners( lineAxis.bin_num(), 0 );
+    otf::parallel_bins::privateBytes = 0;
+    otf::parallel_bins::sum(
+        largeNum, lineAxis.bin_num(), lineSums.data(),
+        [ & ]( double* sums, unsigned long i, unsigned long lower, unsigned long upper ) {
+            const long bin = indexOf( i );
+            if ( bin >= ( long )lower and bin < ( long )upper )
+            {
+                sums[ bin ] += 1;
+#ifdef _OPENMP
+                owners[ bin ] = omp_get_thread_num();
+#endif
+            }
+        } );
+    otf::parallel_bins::privateBytes = 1UL << 26;
+    sort( owners.begin(), owners.end() );
+#ifdef _OPENMP
+    const bool shared = unique( owners.begin(), owners.end() ) - owners.begin() > 1;
+#else
+    const bool shared = true;
+#endif
+    if ( lineSums != serialCounts or not shared )
+    {
+        cout << "The blocked sums are wrong or deposited by a single thread." << endl;
+        MPI_Finalize();
+        return -1;
+    }
+
+    // the fused projections of 3D points, compared with the separate 2D binning: the random points
+    // fill the images, and the shrunk points only cover a small patch of each process
+    const bin_axis      cube( -6, 6, 9 );
+    const unsigned long imageSize       = cube.bin_num() * cube.bin_num();
+    const int           pairs[ 3 ][ 2 ] = { { 0, 1 }, { 0, 2 }, { 1, 2 } };
+    for ( auto shrink : { 1.0, 0.1 } )
+    {
+        vector< double > coords[ 3 ] = { largeXs, largeYs, largeValues };
+        vector< double > points( 3 * largeNum );
+        for ( auto i = 0UL; i < largeNum; ++i )
+        {
+            for ( auto k = 0; k < 3; ++k )
+            {
+                coords[ k ][ i ] *= shrink;
+                if ( k == 0 and shrink < 1 )
+                {
+                    coords[ k ][ i ] += rank - 2;
+                }
+                points[ 3 * i + k ] = coords[ k ][ i ];
+            }
+        }
+        vector< double > masses( largeNum );
+        for ( auto i = 0UL; i < largeNum; ++i )
+        {
+            masses[ i ] = 1 + abs( largeYs[ i ] );
+        }
+        unique_ptr< double[] > images[ 6 ];
+        for ( auto run = 0; run < 5; ++run )
+        {
+            // serial, private bins, the sparse and the dense reduction being forced, then the
+            // blocked ownership of the images
+            otf::parallel_bins::minChunk     = run == 0 ? largeNum + 1 : 1000;
+            otf::parallel_bins::privateBytes = run == 4 ? 0 : 1UL << 26;
+            statistic::sparseRatio           = run == 2 ? 1e9 : ( run == 3 ? -1 : 1 );
+            images[ run ] = statistic::projections( rank, points.data(), cube, largeNum );
+        }
+        otf::parallel_bins::privateBytes = 1UL << 26;
+        statistic::sparseRatio           = 1;
+        images[ 5 ] = statistic::projections( rank, points.data(), cube, largeNum, masses.data() );
+        for ( auto p = 0; p < 3; ++p )
+        {
+            auto target = statistic::bin2d( rank, coords[ pairs[ p ][ 0 ] ].data(), cube,
+                                            coords[ pairs[ p ][ 1 ] ].data(), cube,
+                                            statistic_method::COUNT, largeNum );
+            auto targetMass = statistic::bin2d( rank, coords[ pairs[ p ][ 0 ] ].data(), cube,
+                                                coords[ pairs[ p ][ 1 ] ].data(), cube,
+                                                statistic_method::SUM, largeNum, masses.data() );
+            for ( auto i = 0UL; rank == 0 and i < imageSize; ++i )
+            {
+                for ( auto run = 0; run < 6; ++run )
+                {
+                    const double value = run < 5 ? target[ i ] : targetMass[ i ];
+                    if ( abs( images[ run ][ p * imageSize + i ] - value )
+                         >= THRESHOLD * ( 1 + value ) )
+                    {
+                        cout << "Projection " << p << " of shrink " << shrink << " in bin " << i
+                             << ": target " << value << ", run " << run << " get "
+                             << images[ run ][ p * imageSize + i ] << endl;
+                        MPI_Finalize();
+                        return -1;
+                    }
+                }
+            }
+        }
+
+        // the smooth kernels conserve the mass of the points far from the boundaries
+        for ( auto kernel : { image_kernel::CIC, image_kernel::TSC } )
+        {
+            auto smooth = statistic::projections( rank, points.data(), cube, largeNum, nullptr,
+                                                  kernel );
+            for ( auto p = 0; rank == 0 and shrink < 1 and p < 3; ++p )
+            {
+                double total = 0;
+                for ( auto i = 0UL; i < imageSize; ++i )
+                {
+                    total += smooth[ p * imageSize + i ];
+                }
+                if ( abs( total - ( double )( largeNum * size ) ) >= THRESHOLD * total )
+                {
+                    cout << "Projection " << p << " of kernel " << ( int )kernel
+                         << ": total mass " << total << endl;
+                    MPI_Finalize();
+                    return -1;
+                }
+            }
+        }
+
+        // the 3D grid of the masses, whose sum along z is the x-y image if all z are in the grid,
+        // and the mean of a constant
+        vector< double > clamped( points );
+        vector< double > constant( largeNum, 2.5 );
+        for ( auto i = 0UL; i < largeNum; ++i )
+        {
+            clamped[ 3 * i + 2 ] = min( max( clamped[ 3 * i + 2 ], -5.9 ), 5.9 );
+        }
+        auto grid = statistic::bin3d( rank, clamped.data(), cube, cube, cube,
+                                      statistic_method::COUNT, largeNum, nullptr, masses.data() );
+        auto mean = statistic::bin3d( rank, clamped.data(), cube, cube, cube,
+                                      statistic_method::MEAN, largeNum, constant.data(),
+                                      masses.data() );
+        // the fused sums of the masses and the mass-weighted coordinates, checked by the z ones
+        vector< double > zData( largeNum );
+        for ( auto i = 0UL; i < largeNum; ++i )
+        {
+            zData[ i ] = clamped[ 3 * i + 2 ];
+        }
+        auto zSum = statistic::bin3d( rank, clamped.data(), cube, cube, cube,
+                                      statistic_method::SUM, largeNum, zData.data(),
+                                      masses.data() );
+        auto sums = statistic::sums3d( rank, clamped.data(), cube, cube, cube, largeNum,
+                                       masses.data(), 3, clamped.data() );
+        for ( auto i = 0UL; rank == 0 and i < imageSize; ++i )
+        {
+            double column = 0;
+            for ( auto k = 0UL; k < cube.bin_num(); ++k )
+            {
+                const unsigned long voxelIndex = i * cube.bin_num() + k;
+                if ( abs( sums[ 4 * voxelIndex ] - grid[ voxelIndex ] ) >= THRESHOLD
+                     or abs( sums[ 4 * voxelIndex + 3 ] - zSum[ voxelIndex ] )
+                            >= THRESHOLD * ( 1 + abs( zSum[ voxelIndex ] ) ) )
+                {
+                    cout << "3D sums of shrink " << shrink << " in voxel " << voxelIndex << ": "
+                         << sums[ 4 * voxelIndex ] << ", " << sums[ 4 * voxelIndex + 3 ] << endl;
+                    MPI_Finalize();
+                    return -1;
+                }
+                const double voxel = mean[ i * cube.bin_num() + k ];
+                column += grid[ i * cube.bin_num() + k ];
+                if ( grid[ i * cube.bin_num() + k ] > 0 ? abs( voxel - 2.5 ) >= THRESHOLD
+                                                        : not isnan( voxel ) )
+                {
+                    cout << "3D mean of shrink " << shrink << " in voxel "
+                         << i * cube.bin_num() + k << ": " << voxel << endl;
+                    MPI_Finalize();
+                    return -1;
+                }
+            }
+            if ( abs( column - images[ 5 ][ i ] ) >= THRESHOLD * ( 1 + column ) )
+            {
+                cout << "3D grid of shrink " << shrink << " in column " << i << ": " << column
+                     << ", image " << images[ 5 ][ i ] << endl;
+                MPI_Finalize();
+                return -1;
+            }
+        }
+    }
+
+    // a single point at the center of a cell: CIC deposits it into the cell, while TSC deposits
+    // 3/4 in each direction into the cell and 1/8 into each neighbor
+    const double center[ 3 ] = { cube.center( 4 ), cube.center( 2 ), cube.center( 6 ) };
+    auto         cic         = statistic::projections( rank, center, cube, rank == 0 ? 1 : 0,
+                                                       nullptr, image_kernel::CIC );
+    auto         tsc         = statistic::projections( rank, center, cube, rank == 0 ? 1 : 0,
+                                                       nullptr, image_kernel::TSC );
+    if ( rank == 0
+         and ( abs( cic[ 4 * cube.bin_num() + 2 ] - 1 ) >= THRESHOLD
+               or abs( tsc[ 4 * cube.bin_num() + 2 ] - 0.5625 ) >= THRESHOLD
+               or abs( tsc[ 3 * cube.bin_num() + 2 ] - 0.09375 ) >= THRESHOLD
+               or abs( tsc[ 3 * cube.bin_num() + 1 ] - 0.015625 ) >= THRESHOLD ) )
+    {
+        cout << "Kernels of a single point: CIC " << cic[ 4 * cube.bin_num() + 2 ] << ", TSC "
+             << tsc[ 4 * cube.bin_num() + 2 ] << " " << tsc[ 3 * cube.bin_num() + 2 ] << " "
+             << tsc[ 3 * cube.bin_num() + 1 ] << endl;
+        MPI_Finalize();
+        return -1;
+    }
     MPI_Finalize();
     return 0;
 }
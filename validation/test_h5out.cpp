@@ -6,6 +6,7 @@
 #define DEBUG 1
 #include "../include/h5out.hpp"
 #include "H5Tpublic.h"
+#include <csignal>
 #include <hdf5.h>
 
 int main()
@@ -54,5 +55,58 @@ int main()
             return returnCode;
     }
 
+    // buffered scalar logs: written every 4 blocks
+    h5_out bufferedOrganizer( "./test_log/", "buffered.hdf5", 4, 0 );
+    bufferedOrganizer.create_dataset_in_group( "Time", "component1", { 1 }, H5T_NATIVE_DOUBLE,
+                                               true );
+    for ( int i = 0; i < 10; ++i )
+    {
+        double time       = 0.1 * i;
+        auto   returnCode = bufferedOrganizer.flush_single_block( "component1", "Time", &time );
+        if ( returnCode != 0 )
+            return returnCode;
+    }
+    auto& handle =
+        bufferedOrganizer.datasetPtrs[ bufferedOrganizer.groups[ "component1" ] ][ "Time" ];
+    if ( handle->curIndex != 8 or handle->bufferedNum != 2 )
+        return 1;
+    bufferedOrganizer.flush_all();
+    if ( handle->curIndex != 10 or handle->bufferedNum != 0 )
+        return 1;
+
+    // read back the written blocks
+    hid_t   fileSpace = H5Dget_space( handle->dataset );
+    hsize_t dims[ 2 ] = { 0, 0 };
+    H5Sget_simple_extent_dims( fileSpace, dims, nullptr );
+    H5Sclose( fileSpace );
+    if ( dims[ 0 ] != 10 or dims[ 1 ] != 1 )
+        return 1;
+    double readTimes[ 10 ];
+    H5Dread( handle->dataset, H5T_NATIVE_DOUBLE, H5S_ALL, H5S_ALL, H5P_DEFAULT, readTimes );
+    for ( int i = 0; i < 10; ++i )
+    {
+        if ( readTimes[ i ] != 0.1 * i )
+            return 1;
+    }
+
+    // the opt-in signal handlers are installed only while there are buffered blocks
+    auto sigterm_handled = []() {
+        struct sigaction current;
+        sigaction( SIGTERM, nullptr, &current );
+        return current.sa_handler != SIG_DFL;
+    };
+    h5_out signalOrganizer( "./test_log/", "signal.hdf5", 4, 0, true );
+    signalOrganizer.create_dataset_in_group( "Time", "component1", { 1 }, H5T_NATIVE_DOUBLE,
+                                             true );
+    if ( sigterm_handled() )
+        return 1;
+    double time = 0;
+    signalOrganizer.flush_single_block( "component1", "Time", &time );
+    if ( not sigterm_handled() )
+        return 1;
+    signalOrganizer.flush_all();
+    if ( sigterm_handled() )
+        return 1;
+
     return 0;
 }
@@ -0,0 +1,97 @@
+/**
+ * @file test_idset.cpp
+ * @brief Compare the membership test of the id set (both the bitmap and the hash table) with
+ * std::set.
+ */
+
+#define DEBUG 1
+#include "../include/idset.hpp"
+#include "../include/myprompt.hpp"
+#include <climits>
+#include <random>
+#include <set>
+#include <vector>
+using namespace std;
+using namespace otf;
+
+// check the id set against std::set for the ids and the queries, return whether it passes
+static auto check( const vector< int >& ids, const vector< int >& queries, const bool dense )
+    -> bool
+{
+    const id_set     idSet( ids );
+    const set< int > target( ids.begin(), ids.end() );
+    if ( idSet.is_dense() != dense )
+    {
+        ERROR( "The id set should%s use the bitmap.", dense ? "" : " not" );
+        return false;
+    }
+    if ( idSet.size() != target.size() )
+    {
+        ERROR( "The size: target is [%lu] but get [%lu].", target.size(), idSet.size() );
+        return false;
+    }
+    for ( const auto query : queries )
+    {
+        if ( idSet.contains( query ) != target.contains( query ) )
+        {
+            ERROR( "The membership of id [%d]: target is [%d] but get [%d].", query,
+                   ( int )target.contains( query ), ( int )idSet.contains( query ) );
+            return false;
+        }
+    }
+    return true;
+}
+
+int main()
+{
+    mt19937                         gen( 2024 );
+    uniform_int_distribution< int > compact( 1, 100000 );
+    uniform_int_distribution< int > sparse( INT_MIN, INT_MAX );
+
+    // compact ids with some repeated values, and sparse ids including the extreme values
+    vector< int > compactIds( 20000 ), sparseIds( 20000 );
+    for ( auto& id : compactIds )
+    {
+        id = compact( gen );
+    }
+    for ( auto& id : sparseIds )
+    {
+        id = sparse( gen );
+    }
+    sparseIds[ 0 ] = INT_MIN;
+    sparseIds[ 1 ] = INT_MAX;
+    sparseIds[ 2 ] = 0;
+    sparseIds[ 3 ] = sparseIds[ 4 ];
+
+    // query the ids themselves, their neighbors and random values
+    vector< int > queries = { INT_MIN, INT_MIN + 1, -1, 0, 1, INT_MAX - 1, INT_MAX };
+    for ( const auto* ids : { &compactIds, &sparseIds } )
+    {
+        for ( const auto id : *ids )
+        {
+            queries.push_back( id );
+            queries.push_back( id == INT_MAX ? id : id + 1 );
+        }
+    }
+    for ( auto i = 0; i < 20000; ++i )
+    {
+        queries.push_back( compact( gen ) );
+        queries.push_back( sparse( gen ) );
+    }
+
+    if ( not( check( compactIds, queries, true ) and check( sparseIds, queries, false )
+              and check( {}, queries, true ) and check( { INT_MIN }, queries, true ) ) )
+    {
+        return -1;
+    }
+
+    // force the hash table for the compact ids, and for the sets with a single element
+    id_set::maxBitsPerId = 0;
+    if ( not( check( compactIds, queries, false ) and check( { INT_MIN }, queries, false )
+              and check( { 7 }, queries, false ) ) )
+    {
+        return -1;
+    }
+
+    return 0;
+}
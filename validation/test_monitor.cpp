@@ -136,6 +136,66 @@ int main( int argc, char* argv[] )
         mockTime += mockDeltaT;
     }
 
+    // the alignment of points along the diagonal of x-y plane, reduced from all ranks: the x-axis
+    // of the rotated frame is the diagonal
+    double line[ 3 * 5 ];
+    double unitMasses[ 5 ] = { 1, 1, 1, 1, 1 };
+    for ( auto i = 0; i < 5; ++i )
+    {
+        const double t    = ( double )( 5 * rank + i ) - 9.5;
+        line[ 3 * i + 0 ] = t / numbers::sqrt2;
+        line[ 3 * i + 1 ] = t / numbers::sqrt2;
+        line[ 3 * i + 2 ] = 0.01 * pow( -1, i );
+    }
+    double rotation[ 9 ];
+    monitor::alignment_rotation( 5, unitMasses, line, 100, rotation );
+    assert( abs( abs( rotation[ 0 ] + rotation[ 1 ] ) / numbers::sqrt2 - 1 ) < 1e-10 );
+
+    // the face-on kinematic maps of a known velocity field in 4x4 pixels of width 5: two particles
+    // of each rank in the pixel (3, 3), and one in the pixel (0, 1), with v_R = 5 everywhere
+    auto&                      comp             = otfServer.para.comps.at( "component1" );
+    monitor::compDataContainer mapData;
+    monitor::compResContainer  mapRes;
+    const double               mapPos[ 3 ][ 3 ] = { { 7, 7, 0 }, { 8, 6, 0 }, { -7, -2, 0 } };
+    const double               mapMasses[ 3 ]   = { 1, 3, 2 };
+    const double               mapVPhis[ 3 ]    = { 100, 104, 50.0 + rank };
+    const double               mapVZs[ 3 ]      = { 2, -2, 0 };
+    mapData.partNum     = 3;
+    mapData.masses      = make_unique< double[] >( 3 );
+    mapData.coordinates = make_unique< double[] >( 9 );
+    mapData.velocities  = make_unique< double[] >( 9 );
+    for ( auto i = 0; i < 3; ++i )
+    {
+        const double phi                = atan2( mapPos[ i ][ 1 ], mapPos[ i ][ 0 ] );
+        mapData.masses[ i ]             = mapMasses[ i ];
+        mapData.velocities[ 3 * i + 0 ] = 5 * cos( phi ) - mapVPhis[ i ] * sin( phi );
+        mapData.velocities[ 3 * i + 1 ] = 5 * sin( phi ) + mapVPhis[ i ] * cos( phi );
+        mapData.velocities[ 3 * i + 2 ] = mapVZs[ i ];
+        for ( auto k = 0; k < 3; ++k )
+        {
+            mapData.coordinates[ 3 * i + k ] = mapPos[ i ][ k ];
+        }
+    }
+    otfServer.kinematic_maps( mapData, comp, mapRes );
+    if ( rank == 0 )
+    {
+        // (count, surface density, mean and dispersion of v_R, v_phi, v_z) of the two pixels
+        const double targets[ 2 ][ 8 ] = {
+            { 8, 16.0 / 25, 5, 0, 103, sqrt( 3.0 ), -1, sqrt( 3.0 ) },
+            { 4, 8.0 / 25, 5, 0, 51.5, sqrt( 1.25 ), 0, 0 } };
+        const unsigned long pixels[ 2 ] = { 15, 1 };
+        for ( auto p = 0; p < 2; ++p )
+        {
+            for ( auto q = 0; q < 8; ++q )
+            {
+                assert( abs( mapRes.kinematics[ 8 * pixels[ p ] + q ] - targets[ p ][ q ] )
+                        < 1e-10 * ( 1 + abs( targets[ p ][ q ] ) ) );
+            }
+        }
+        // the other pixels are empty
+        assert( mapRes.kinematics[ 8 * 0 + 0 ] == 0 and isnan( mapRes.kinematics[ 8 * 0 + 4 ] ) );
+    }
+
     MPI_Finalize();
     return 0;
 }
@@ -5,13 +5,115 @@
 
 #define DEBUG 1
 #include "../include/monitor.hpp"
+#include "../include/myprompt.hpp"
+#include <algorithm>
 #include <cassert>
 #include <cmath>
+#include <cstdint>
+#include <hdf5.h>
 #include <memory>
 #include <mpi.h>
+#include <vector>
 using namespace std;
 using namespace otf;
 
+/**
+ * @brief Read back the orbits logged in the consolidated dataset, and compare them with the mock
+ * kick-drift motion of the particles, recentered on the anchor particles. The quantized orbits are
+ * decoded by the cumulative sum of the delta encoded values.
+ *
+ * @return whether the orbits are correct
+ */
+static auto check_orbits( const char* filename, const double* posG, const double* velG,
+                          const int maxStep, const int period, const double deltaT,
+                          const double kick, const double tolerance ) -> bool
+{
+    const hid_t file  = H5Fopen( filename, H5F_ACC_RDONLY, H5P_DEFAULT );
+    const hid_t ids   = H5Dopen2( file, "/Orbit/ParticleIDs", H5P_DEFAULT );
+    const hid_t times = H5Dopen2( file, "/Orbit/Time", H5P_DEFAULT );
+    const hid_t orbs  = H5Dopen2( file, "/Orbit/Orbits", H5P_DEFAULT );
+    hsize_t     idDims[ 2 ], timeDims[ 2 ], dims[ 3 ];
+    H5Sget_simple_extent_dims( H5Dget_space( ids ), idDims, nullptr );
+    H5Sget_simple_extent_dims( H5Dget_space( times ), timeDims, nullptr );
+    H5Sget_simple_extent_dims( H5Dget_space( orbs ), dims, nullptr );
+    const int stepNum = ( maxStep + period - 1 ) / period;
+    if ( not( idDims[ 0 ] == 1 and idDims[ 1 ] > 0 and timeDims[ 0 ] == ( hsize_t )stepNum
+              and dims[ 0 ] == ( hsize_t )stepNum and dims[ 1 ] == idDims[ 1 ]
+              and dims[ 2 ] == 6 ) )
+    {
+        ERROR( "Get an unexpected shape of the orbit dataset: (%llu, %llu, %llu).",
+               ( unsigned long long )dims[ 0 ], ( unsigned long long )dims[ 1 ],
+               ( unsigned long long )dims[ 2 ] );
+        return false;
+    }
+
+    const auto       particleNum = idDims[ 1 ];
+    vector< int >    particleIDs( particleNum );
+    vector< double > logTimes( stepNum );
+    vector< double > orbits( dims[ 0 ] * dims[ 1 ] * dims[ 2 ] );
+    H5Dread( ids, H5T_NATIVE_INT, H5S_ALL, H5S_ALL, H5P_DEFAULT, particleIDs.data() );
+    H5Dread( times, H5T_NATIVE_DOUBLE, H5S_ALL, H5S_ALL, H5P_DEFAULT, logTimes.data() );
+    if ( H5Lexists( file, "/Orbit/QuantizeScales", H5P_DEFAULT ) > 0 )
+    {
+        const hid_t       scaleSet = H5Dopen2( file, "/Orbit/QuantizeScales", H5P_DEFAULT );
+        double            scales[ 6 ];
+        vector< int32_t > deltas( orbits.size() );
+        H5Dread( scaleSet, H5T_NATIVE_DOUBLE, H5S_ALL, H5S_ALL, H5P_DEFAULT, scales );
+        H5Dread( orbs, H5T_NATIVE_INT32, H5S_ALL, H5S_ALL, H5P_DEFAULT, deltas.data() );
+        H5Dclose( scaleSet );
+        for ( auto column = 0UL; column < particleNum * 6; ++column )
+        {
+            long sum = 0;
+            for ( auto i = 0; i < stepNum; ++i )
+            {
+                const auto index = i * particleNum * 6 + column;
+                sum += deltas[ index ] == INT32_MIN ? 0 : deltas[ index ];
+                orbits[ index ] = deltas[ index ] == INT32_MIN ? nan( "" )
+                                                               : sum * scales[ column % 6 ];
+            }
+        }
+    }
+    else
+    {
+        H5Dread( orbs, H5T_NATIVE_DOUBLE, H5S_ALL, H5S_ALL, H5P_DEFAULT, orbits.data() );
+    }
+    H5Dclose( ids );
+    H5Dclose( times );
+    H5Dclose( orbs );
+    H5Fclose( file );
+
+    for ( auto i = 0; i < stepNum; ++i )
+    {
+        const int step = i * period;
+        if ( fabs( logTimes[ i ] - step * deltaT ) > 1e-10 )
+        {
+            ERROR( "The time of step [%d] is wrong.", step );
+            return false;
+        }
+        for ( auto j = 0UL; j < particleNum; ++j )
+        {
+            const int     index = particleIDs[ j ] - 1;
+            const double* point = orbits.data() + ( i * particleNum + j ) * 6;
+            bool          equal = true;
+            for ( int k = 0; k < 3; ++k )
+            {
+                // recentered on the most bound particle (the last one), so the drift cancels
+                const double pos = posG[ index * 3 + k ] - posG[ 39 * 3 + k ];
+                const double vel = velG[ index * 3 + k ] + step * kick;
+                equal = equal and fabs( point[ k ] - pos ) < tolerance
+                        and fabs( point[ 3 + k ] - vel ) < tolerance;
+            }
+            if ( not equal or ( j > 0 and particleIDs[ j ] <= particleIDs[ j - 1 ] ) )
+            {
+                ERROR( "The orbit of particle [%d] at step [%d] is wrong.", particleIDs[ j ],
+                       step );
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
 int main( int argc, char* argv[] )
 {
     // NOTE: test in rank 4 mpi process program: 10 coordinate in each rank
@@ -107,29 +209,53 @@ int main( int argc, char* argv[] )
     MPI_Scatterv( mockVelG, localNums3, offset3s.get(), MPI_DOUBLE, mockVel.get(),
                   localNums[ rank ] * 3, MPI_DOUBLE, 0, MPI_COMM_WORLD );
 
-    double mockTime   = 0;     // mock the time of the simulation
-    double mockDeltaT = 0.13;  // mock the time step of the simulation
-    double mockDrift  = 1.2;   // mock the drift
-    double mockKick   = -1.7;  // mock the kick
-    int    maxStep    = 23;    // mock the number of synchronized steps
+    const double mockDeltaT = 0.13;  // mock the time step of the simulation
+    const double mockDrift  = 1.2;   // mock the drift
+    const double mockKick   = -1.7;  // mock the kick
+    const int    maxStep    = 23;    // mock the number of synchronized steps
 
-    monitor otfServer( "../validation/orbit_log_test.toml" );
-    for ( auto i = 0; i < maxStep; ++i )
+    // log the orbits in the double and the quantized storage, with the same kick-drift motion
+    const char* configs[ 2 ] = { "../validation/orbit_log_test.toml",
+                                 "../validation/orbit_log_quantized_test.toml" };
+    const char* logs[ 2 ]    = { "./otfLogs/galotfa.hdf5", "./otfLogs/galotfa_quantized.hdf5" };
+    // the quantized values are in units of 200 / (2^19 - 1), rounded to the nearest one
+    const double tolerances[ 2 ] = { 1e-10, 0.5 * 200 / ( ( 1 << 19 ) - 1 ) + 1e-9 };
+    int          passed          = 1;
+    for ( auto c = 0; c < 2 and passed; ++c )
     {
-        otfServer.main_analysis_api( mockTime, localNums[ rank ], mockIDs.get(), mockTypes.get(),
-                                     mockMass.get(), mockPot.get(), mockPos.get(), mockVel.get() );
-
-        // mock the kick-drift pair
-        for ( auto j = 0; j < localNums[ rank ]; ++j )
-            for ( auto k = 0; k < 3; ++k )
+        unique_ptr< double[] > pos( new double[ localNums[ rank ] * 3 ] );
+        unique_ptr< double[] > vel( new double[ localNums[ rank ] * 3 ] );
+        copy( mockPos.get(), mockPos.get() + localNums[ rank ] * 3, pos.get() );
+        copy( mockVel.get(), mockVel.get() + localNums[ rank ] * 3, vel.get() );
+        double mockTime = 0;  // mock the time of the simulation
+        {
+            monitor otfServer( configs[ c ] );
+            for ( auto i = 0; i < maxStep; ++i )
             {
-                mockPos[ j * 3 + k ] += mockDrift;
-                mockVel[ j * 3 + k ] += mockKick;
+                otfServer.main_analysis_api( mockTime, localNums[ rank ], mockIDs.get(),
+                                             mockTypes.get(), mockMass.get(), mockPot.get(),
+                                             pos.get(), vel.get() );
+
+                // mock the kick-drift pair
+                for ( auto j = 0; j < localNums[ rank ]; ++j )
+                    for ( auto k = 0; k < 3; ++k )
+                    {
+                        pos[ j * 3 + k ] += mockDrift;
+                        vel[ j * 3 + k ] += mockKick;
+                    }
+                // mock the time increment
+                mockTime += mockDeltaT;
             }
-        // mock the time increment
-        mockTime += mockDeltaT;
-    }
+        }  // the log file is closed here
 
+        // check the consolidated orbit dataset in the root rank
+        if ( rank == 0 )
+        {
+            passed = check_orbits( logs[ c ], mockPosG, mockVelG, maxStep, 3, mockDeltaT,
+                                   mockKick, tolerances[ c ] );
+        }
+        MPI_Bcast( &passed, 1, MPI_INT, 0, MPI_COMM_WORLD );
+    }
     MPI_Finalize();
-    return 0;
+    return passed ? 0 : -1;
 }
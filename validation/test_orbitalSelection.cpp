@@ -6,10 +6,16 @@
 #define DEBUG 1
 #include "../include/myprompt.hpp"
 #include "../include/selector.hpp"
+#include <algorithm>
 #include <cassert>
+#include <climits>
 #include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <hdf5.h>
 #include <memory>
 #include <mpi.h>
+#include <vector>
 using namespace std;
 using namespace otf;
 
@@ -101,13 +107,59 @@ int main( int argc, char* argv[] )
                               mockPos + 3 * 10 * rank, mockVel + 3 * 10 * rank );
     if ( para.orbit->method == otf::orbit::id_selection_method::RANDOM )
     {
-        assert( getData->count == 9 );
+        // the sampling is decided by the ids only
+        auto localSampled = 0U;
+        for ( auto i = 10 * rank; i < 10 * rank + 10; ++i )
+        {
+            localSampled += orbit_selector::id_sampled( mockIDs[ i ], para.orbit->seed,
+                                                        para.orbit->fraction )
+                                ? 1
+                                : 0;
+        }
+        assert( getData->count == localSampled );
         for ( auto i = 0U; i < getData->count; ++i )
         {
             assert( hasMass( getData->mass[ i ] ) );
             assert( hasPos( getData->coordinate.data() + 3 * i ) );
             assert( hasVel( getData->velocity.data() + 3 * i ) );
         }
+
+        // the same particles are selected in another decomposition, without any collective
+        // communication to build the targets
+        const int      shifted = ( rank + 1 ) % size;
+        orbit_selector otherSelector( para );
+        auto           otherData = otherSelector.select(
+            10, mockIDs + 10 * shifted, mockTypes + 10 * shifted, mockMass + 10 * shifted,
+            mockPos + 3 * 10 * shifted, mockVel + 3 * 10 * shifted );
+        long sums[ 2 ] = { 0, 0 };  // sum of the selected ids in the two decompositions
+        for ( auto i = 0U; i < getData->count; ++i )
+        {
+            sums[ 0 ] += getData->id[ i ];
+        }
+        for ( auto i = 0U; i < otherData->count; ++i )
+        {
+            sums[ 1 ] += otherData->id[ i ];
+        }
+        MPI_Allreduce( MPI_IN_PLACE, sums, 2, MPI_LONG, MPI_SUM, MPI_COMM_WORLD );
+        assert( sums[ 0 ] == sums[ 1 ] and sums[ 0 ] > 0 );
+
+        // the sampled fraction of many ids, and the samples of a smaller fraction are a subset
+        // of the larger one, while another seed gives an independent sample
+        long selected = 0, subset = 0, crossed = 0;
+        for ( int id = -500000; id < 500000; ++id )
+        {
+            const bool large = orbit_selector::id_sampled( id, 7, 0.3 );
+            const bool small = orbit_selector::id_sampled( id, 7, 0.1 );
+            const bool other = orbit_selector::id_sampled( id, 8, 0.3 );
+            selected += large ? 1 : 0;
+            subset += small and not large ? 1 : 0;
+            crossed += large and other ? 1 : 0;
+        }
+        // 5 sigma of the binomial distribution
+        assert( fabs( selected - 3e5 ) < 5 * sqrt( 1e6 * 0.3 * 0.7 ) );
+        assert( subset == 0 );
+        assert( fabs( crossed - 9e4 ) < 5 * sqrt( 1e6 * 0.09 * 0.91 ) );
+        assert( orbit_selector::id_sampled( 12345, 0, 1.0 ) );
     }
     else
     {
@@ -175,6 +227,130 @@ int main( int argc, char* argv[] )
         }
     }
 
+    // the particles found in the last call are verified at their last indexes: the same data
+    // skips the full scan, while the reordered particles are scanned again
+    auto sameData = [ &getData ]( const unique_ptr< dataContainer >& other ) {
+        if ( other->count != getData->count )
+        {
+            return false;
+        }
+        for ( auto i = 0U; i < other->count; ++i )
+        {
+            auto j = 0U;
+            while ( j < getData->count and getData->id[ j ] != other->id[ i ] )
+            {
+                ++j;
+            }
+            if ( j == getData->count or other->mass[ i ] != getData->mass[ j ]
+                 or other->coordinate[ 3 * i ] != getData->coordinate[ 3 * j ]
+                 or other->velocity[ 3 * i + 2 ] != getData->velocity[ 3 * j + 2 ] )
+            {
+                return false;
+            }
+        }
+        return true;
+    };
+    const int* ids    = mockIDs + 10 * rank;
+    const int* types  = mockTypes + 10 * rank;
+    double*    masses = mockMass + 10 * rank;
+    double*    pos    = mockPos + 3 * 10 * rank;
+    double*    vel    = mockVel + 3 * 10 * rank;
+    assert( orbitSelector.fullScanNum == 1 );
+    assert( sameData( orbitSelector.select( 10, ids, types, masses, pos, vel ) ) );
+    assert( orbitSelector.fullScanNum == 1 );
+    assert( sameData( orbitSelector.select( 10, ids, types, masses, pos, vel, true ) ) );
+    assert( orbitSelector.fullScanNum == 2 );
+
+    // reverse the local particles in the last rank only
+    int    reversedIDs[ 10 ];
+    double reversedMass[ 10 ], reversedPos[ 30 ], reversedVel[ 30 ];
+    for ( auto i = 0; i < 10; ++i )
+    {
+        const int j       = rank == size - 1 ? 9 - i : i;
+        reversedIDs[ i ]  = ids[ j ];
+        reversedMass[ i ] = masses[ j ];
+        for ( auto k = 0; k < 3; ++k )
+        {
+            reversedPos[ 3 * i + k ] = pos[ 3 * j + k ];
+            reversedVel[ 3 * i + k ] = vel[ 3 * j + k ];
+        }
+    }
+    assert( sameData( orbitSelector.select( 10, reversedIDs, types, reversedMass, reversedPos,
+                                            reversedVel ) ) );
+    assert( orbitSelector.fullScanNum == 3 );
+
+    // the particles of the first rank change their type with the same ids, so they are scanned
+    // again and no longer sampled
+    int retypes[ 10 ];
+    for ( auto i = 0; i < 10; ++i )
+    {
+        retypes[ i ] = rank == 0 ? 3 : types[ i ];
+    }
+    auto retyped = orbitSelector.select( 10, reversedIDs, retypes, reversedMass, reversedPos,
+                                         reversedVel );
+    assert( orbitSelector.fullScanNum == 4 );
+    assert( rank != 0 or retyped->count == 0 );
+
+    // the id list files of all formats, with repeated and unsorted ids, written in the root rank
+    const vector< int64_t > rawIDs = { 7, -3, 100000, 7, INT_MAX, INT_MIN, 42, -3 };
+    vector< int >           expectIDs( rawIDs.begin(), rawIDs.end() );
+    sort( expectIDs.begin(), expectIDs.end() );
+    expectIDs.erase( unique( expectIDs.begin(), expectIDs.end() ), expectIDs.end() );
+    if ( rank == 0 )
+    {
+        ofstream text( "./idlist_test.txt" );
+        for ( const auto id : rawIDs )
+        {
+            text << id << "\n";
+        }
+        const vector< int32_t > rawIDs32( rawIDs.begin(), rawIDs.end() );
+        ofstream( "./idlist_test.i32", ios::binary )
+            .write( ( const char* )rawIDs32.data(), rawIDs32.size() * sizeof( int32_t ) );
+        ofstream( "./idlist_test.i64", ios::binary )
+            .write( ( const char* )rawIDs.data(), rawIDs.size() * sizeof( int64_t ) );
+        const int64_t outOfRange[] = { 1, ( int64_t )INT_MAX + 1 };
+        ofstream( "./idlist_test_overflow.i64", ios::binary )
+            .write( ( const char* )outOfRange, sizeof( outOfRange ) );
+        // a 2d dataset of 32-bit integers, the ids are in any shape and any integer type
+        const hid_t file =
+            H5Fcreate( "./idlist_test.hdf5", H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT );
+        const hsize_t dims[ 2 ] = { 2, rawIDs.size() / 2 };
+        const hid_t   space     = H5Screate_simple( 2, dims, nullptr );
+        const hid_t   data      = H5Dcreate2( file, "IDs", H5T_STD_I32LE, space, H5P_DEFAULT,
+                                              H5P_DEFAULT, H5P_DEFAULT );
+        H5Dwrite( data, H5T_NATIVE_INT32, H5S_ALL, H5S_ALL, H5P_DEFAULT, rawIDs32.data() );
+        H5Dclose( data );
+        H5Sclose( space );
+        H5Fclose( file );
+    }
+    MPI_Barrier( MPI_COMM_WORLD );
+
+    // all ranks get the same unique ids in ascending order, or fail together
+    auto readIDs = [ &para ]( const char* filename, const orbit::id_file_format format ) {
+        para.orbit->idfile    = filename;
+        para.orbit->idformat  = format;
+        para.orbit->iddataset = "IDs";
+        return orbit_selector::id_read( *para.orbit );
+    };
+    auto readFails = [ &readIDs ]( const char* filename, const orbit::id_file_format format ) {
+        try
+        {
+            readIDs( filename, format );
+        }
+        catch ( ... )
+        {
+            return true;
+        }
+        return false;
+    };
+    assert( readIDs( "./idlist_test.txt", orbit::id_file_format::TEXT ) == expectIDs );
+    assert( readIDs( "./idlist_test.i32", orbit::id_file_format::INT32 ) == expectIDs );
+    assert( readIDs( "./idlist_test.i64", orbit::id_file_format::INT64 ) == expectIDs );
+    assert( readIDs( "./idlist_test.hdf5", orbit::id_file_format::HDF5 ) == expectIDs );
+    assert( readFails( "./idlist_test_overflow.i64", orbit::id_file_format::INT64 ) );
+    assert( readFails( "./idlist_test.i64", orbit::id_file_format::HDF5 ) );
+    assert( readFails( "./idlist_test_not_exist.i32", orbit::id_file_format::INT32 ) );
+
     MPI_Finalize();
     return 0;
 }
@@ -51,7 +51,37 @@ int main()
         ERROR( "Get into an unexpected branch!" );
     }
     INFO( "Random selection fraction: %g.", para.orbit->fraction );
+    INFO( "Random selection seed: %lu.", ( unsigned long )para.orbit->seed );
     INFO( "ID list filename : %s", para.orbit->idfile.c_str() );
+    switch ( para.orbit->idformat )
+    {
+    case otf::orbit::id_file_format::TEXT:
+        INFO( "ID list format: text." );
+        break;
+    case otf::orbit::id_file_format::INT32:
+        INFO( "ID list format: binary int32." );
+        break;
+    case otf::orbit::id_file_format::INT64:
+        INFO( "ID list format: binary int64." );
+        break;
+    case otf::orbit::id_file_format::HDF5:
+        INFO( "ID list format: dataset [%s] in an HDF5 file.", para.orbit->iddataset.c_str() );
+        break;
+    }
+    switch ( para.orbit->storage.mode )
+    {
+    case otf::orbit_storage_para::storage_mode::DOUBLE:
+        INFO( "Orbit storage: double." );
+        break;
+    case otf::orbit_storage_para::storage_mode::FLOAT:
+        INFO( "Orbit storage: float." );
+        break;
+    case otf::orbit_storage_para::storage_mode::QUANTIZED:
+        INFO( "Orbit storage: %u-bit quantized in box %g and velocity box %g, delta encoding: %s.",
+              para.orbit->storage.bits, para.orbit->storage.posBox, para.orbit->storage.velBox,
+              para.orbit->storage.delta ? "true" : "false" );
+        break;
+    }
 
     if ( para.orbit->recenter.enable )
     {
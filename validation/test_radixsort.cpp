@@ -0,0 +1,73 @@
+/**
+ * @file test_radixsort.cpp
+ * @brief Compare the radix argsort with std::stable_sort.
+ */
+
+#define DEBUG 1
+#include "../include/myprompt.hpp"
+#include "../include/radixsort.hpp"
+#include <algorithm>
+#include <numeric>
+#include <random>
+#include <vector>
+using namespace std;
+using namespace otf;
+
+int main()
+{
+    mt19937                             gen( 2024 );
+    uniform_real_distribution< double > radius( 0, 30 );
+    uniform_real_distribution< double > signed_value( -1e3, 1e3 );
+
+    // radii-like keys, with some repeated values to check the stability
+    vector< double > keys( 1000 );
+    for ( auto& key : keys )
+    {
+        key = radius( gen );
+    }
+    for ( auto i = 0U; i < 100; ++i )
+    {
+        keys[ i * 7 ] = 0.5;
+    }
+    keys[ 3 ] = 0;
+
+    // keys with both signs
+    vector< double > signedKeys( 1000 );
+    for ( auto& key : signedKeys )
+    {
+        key = signed_value( gen );
+    }
+    signedKeys[ 5 ] = -0.0;
+    signedKeys[ 6 ] = 0.0;
+
+    for ( auto* data : { &keys, &signedKeys } )
+    {
+        const auto         num = ( unsigned )data->size();
+        vector< unsigned > target( num );
+        iota( target.begin(), target.end(), 0U );
+        stable_sort( target.begin(), target.end(),
+                     [ data ]( unsigned a, unsigned b ) {
+                         return ( *data )[ a ] < ( *data )[ b ];
+                     } );
+
+        auto order = radix_sort::argsort( data->data(), num );
+        for ( auto i = 0U; i < num; ++i )
+        {
+            // -0.0 and 0.0 are equal for std::stable_sort, but ordered for the radix sort
+            if ( ( *data )[ order[ i ] ] != ( *data )[ target[ i ] ] )
+            {
+                ERROR( "The %u-th key: target is [%lf] but get [%lf].", i,
+                       ( *data )[ target[ i ] ], ( *data )[ order[ i ] ] );
+                return -1;
+            }
+            if ( ( *data )[ order[ i ] ] != 0 and order[ i ] != target[ i ] )
+            {
+                ERROR( "The %u-th index: target is [%u] but get [%u].", i, target[ i ],
+                       order[ i ] );
+                return -1;
+            }
+        }
+    }
+
+    return 0;
+}
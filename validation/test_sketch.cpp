@@ -0,0 +1,157 @@
+/**
+ * @file test_sketch.cpp
+ * @brief Compare the quantiles of the sketches merged over the ranks with the exact quantiles of
+ * the gathered data.
+ */
+
+#define DEBUG 1
+#include "../include/myprompt.hpp"
+#include "../include/sketch.hpp"
+#include "../include/statistic.hpp"
+#include <algorithm>
+#include <cmath>
+#include <mpi.h>
+#include <random>
+#include <utility>
+#include <vector>
+using namespace std;
+
+// the fraction of the weight below the value in the sorted (value, weight) pairs
+static auto rank_of( const vector< pair< double, double > >& sorted, const double value ) -> double
+{
+    double below = 0, total = 0;
+    for ( const auto& [ v, w ] : sorted )
+    {
+        below += v < value ? w : ( v == value ? w / 2 : 0 );
+        total += w;
+    }
+    return below / total;
+}
+
+// check the sketch of a bin against the exact data, return whether it passes
+static auto check( quantile_sketch& sketch, const unsigned long bin,
+                   vector< pair< double, double > >& exact ) -> bool
+{
+    sort( exact.begin(), exact.end() );
+    double total = 0;
+    for ( const auto& pair : exact )
+    {
+        total += pair.second;
+    }
+    if ( fabs( sketch.weight( bin ) - total ) > 1e-9 * total )
+    {
+        ERROR( "Bin %lu: the total weight should be [%lf] but get [%lf].", bin, total,
+               sketch.weight( bin ) );
+        return false;
+    }
+    if ( sketch.quantile( bin, 0 ) != exact.front().first
+         or sketch.quantile( bin, 1 ) != exact.back().first )
+    {
+        ERROR( "Bin %lu: the extreme values are [%lf, %lf] but get [%lf, %lf].", bin,
+               exact.front().first, exact.back().first, sketch.quantile( bin, 0 ),
+               sketch.quantile( bin, 1 ) );
+        return false;
+    }
+    // the error in the quantile space is much smaller near the tails
+    for ( const double q : { 1e-3, 0.01, 0.05, 0.1, 0.25, 0.5, 0.75, 0.9, 0.95, 0.99, 0.999 } )
+    {
+        const double error     = fabs( rank_of( exact, sketch.quantile( bin, q ) ) - q );
+        const double tolerance = 0.01 * sqrt( q * ( 1 - q ) ) + 5e-4;
+        if ( error > tolerance )
+        {
+            ERROR( "Bin %lu: the error of the %g quantile is [%g], larger than [%g].", bin, q,
+                   error, tolerance );
+            return false;
+        }
+    }
+    return true;
+}
+
+int main( int argc, char* argv[] )
+{
+    // NOTE: test in rank 4 mpi process program
+    int rank = -1, size = 0;
+    MPI_Init( &argc, &argv );
+    MPI_Comm_rank( MPI_COMM_WORLD, &rank );
+    MPI_Comm_size( MPI_COMM_WORLD, &size );
+
+    // each rank holds a different part of the data: exponential disk-like radii with masses, and
+    // gaussian velocities whose dispersion depends on the radius
+    mt19937                                 gen( 2024 + rank );
+    exponential_distribution< double >      radius( 1.0 / ( 1 + rank ) );
+    normal_distribution< double >           velocity( 0, 1 );
+    uniform_real_distribution< double >     mass( 0.5, 1.5 );
+    const unsigned long                     dataNum = 20000;
+    vector< double >                        radii( dataNum ), velocities( dataNum ),
+        masses( dataNum );
+    for ( auto i = 0UL; i < dataNum; ++i )
+    {
+        radii[ i ]      = radius( gen );
+        velocities[ i ] = velocity( gen ) * ( 1 + radii[ i ] );
+        masses[ i ]     = mass( gen );
+    }
+
+    // weighted radii in a single bin, and unweighted velocities in radial bins
+    const bin_axis  axis( 0, 10, 4 );
+    quantile_sketch radii_sketch( 1, 100 ), velocity_sketch( axis.bin_num(), 100 );
+    for ( auto i = 0UL; i < dataNum; ++i )
+    {
+        radii_sketch.add( 0, radii[ i ], masses[ i ] );
+    }
+    velocity_sketch.add( dataNum, radii.data(), axis, velocities.data(), nullptr );
+    radii_sketch.reduce( rank );
+    velocity_sketch.reduce( rank );
+
+    // the exact data in the root rank
+    vector< double > allRadii( dataNum * size ), allVelocities( dataNum * size ),
+        allMasses( dataNum * size );
+    MPI_Gather( radii.data(), ( int )dataNum, MPI_DOUBLE, allRadii.data(), ( int )dataNum,
+                MPI_DOUBLE, 0, MPI_COMM_WORLD );
+    MPI_Gather( velocities.data(), ( int )dataNum, MPI_DOUBLE, allVelocities.data(),
+                ( int )dataNum, MPI_DOUBLE, 0, MPI_COMM_WORLD );
+    MPI_Gather( masses.data(), ( int )dataNum, MPI_DOUBLE, allMasses.data(), ( int )dataNum,
+                MPI_DOUBLE, 0, MPI_COMM_WORLD );
+
+    int passed = 1;
+    if ( rank == 0 )
+    {
+        vector< pair< double, double > >            exactRadii;
+        vector< vector< pair< double, double > > > exactVelocities( axis.bin_num() );
+        for ( auto i = 0UL; i < dataNum * size; ++i )
+        {
+            exactRadii.emplace_back( allRadii[ i ], allMasses[ i ] );
+            if ( axis.contains( allRadii[ i ] ) )
+            {
+                exactVelocities[ axis.find_index( allRadii[ i ] ) ].emplace_back(
+                    allVelocities[ i ], 1 );
+            }
+        }
+        passed = check( radii_sketch, 0, exactRadii );
+        for ( auto bin = 0UL; bin < axis.bin_num() and passed; ++bin )
+        {
+            passed = check( velocity_sketch, bin, exactVelocities[ bin ] );
+        }
+        // the digest is bounded by the compression
+        if ( passed and radii_sketch.records[ 0 ] > radii_sketch.capacity )
+        {
+            ERROR( "The digest has [%lf] centroids, more than the capacity [%lu].",
+                   radii_sketch.records[ 0 ], radii_sketch.capacity );
+            passed = 0;
+        }
+    }
+
+    // an empty bin
+    quantile_sketch empty( 2, 50 );
+    empty.add( 1, 3.0 );
+    empty.reduce( rank );
+    if ( rank == 0 and passed
+         and not( isnan( empty.quantile( 0, 0.5 ) ) and empty.quantile( 1, 0.5 ) == 3.0 ) )
+    {
+        ERROR( "The empty bin or the single value is not handled correctly." );
+        passed = 0;
+    }
+
+    MPI_Bcast( &passed, 1, MPI_INT, 0, MPI_COMM_WORLD );
+    MPI_Finalize();
+    return passed ? 0 : -1;
+}